@@ -0,0 +1,411 @@
+#include "ChunkStorage.h"
+#include "DocumentLayout.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <unordered_set>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * @file ChunkStorage.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the deduplicating document storage.
+ */
+
+namespace
+{
+	// the leading non-ASCII byte keeps text files from being mistaken for manifests
+	char const g_magic[8] = { '\x89', 'C', 'T', 'E', 'C', 'H', 'K', '\n' };
+
+	// magic, version, size and the chunk count
+	std::size_t const g_fixed_size = sizeof(g_magic) + 4 + 2 * 8;
+	std::size_t const g_chunk_size = 4 + sizeof(Hash::hash_t);
+
+	std::string describe_errno(std::string const &action, std::string const &name)
+	{
+		std::ostringstream strm;
+
+		strm << "while " << action << " chunk <" << name << ">: " << std::strerror(errno);
+
+		return strm.str();
+	}
+
+	// chunk writes and garbage collections of all stores of the process
+	std::mutex g_store_mutex;
+
+	void make_directory(std::string const &directory)
+	{
+		if (::mkdir(directory.c_str(), 0755) && errno != EEXIST)
+		{
+			throw document_errors::DocumentError(describe_errno("creating", directory));
+		}
+	}
+}
+
+using namespace document_errors;
+
+std::uint32_t const ChunkStorage::version;
+
+ChunkStorage::ChunkStorage(int fd, std::string const &name, Document::OpenMode mode)
+	: IndexedStorage(fd, name, mode),
+	  store_(store_of(name)),
+	  manifest_(false)
+{
+}
+
+bool ChunkStorage::is_manifest(int fd)
+{
+	char magic[sizeof(g_magic)];
+
+	return ::pread(fd, magic, sizeof(magic), 0) == static_cast<ssize_t>(sizeof(magic))
+		&& std::equal(magic, magic + sizeof(magic), g_magic);
+}
+
+std::string ChunkStorage::store_of(std::string const &name)
+{
+	return DocumentLayout::root_of(name) + ".chunks/";
+}
+
+Rope ChunkStorage::load()
+{
+	Rope const file = read_contents(fd_, mode_);
+	std::vector<ChunkTree::Chunk> chunks;
+
+	if (!decode(file, name_, chunks))
+	{
+		return file;
+	}
+
+	std::size_t size = 0;
+
+	for (auto const &chunk: chunks)
+	{
+		size += chunk.length;
+	}
+
+	std::vector<char> bytes(size);
+	std::size_t offset = 0;
+
+	for (auto const &chunk: chunks)
+	{
+		std::string const path = path_of(chunk.hash);
+		int const fd = ::open(path.c_str(), O_RDONLY);
+
+		if (fd < 0)
+		{
+			throw DocumentError(describe_errno("loading", path));
+		}
+
+		ssize_t const read_result = ::pread(fd, bytes.data() + offset, chunk.length, 0);
+
+		::close(fd);
+
+		if (read_result < 0 || static_cast<std::size_t>(read_result) != chunk.length)
+		{
+			throw DocumentError("while loading chunk <" + path + ">: chunk is truncated");
+		}
+
+		offset += chunk.length;
+	}
+
+	Rope const contents(Rope::make_buffer(std::move(bytes)));
+
+	// the manifest has no line index, counting the newlines once spares the document that
+	keep_loaded(ChunkTree(chunks), LineIndex(contents));
+	manifest_ = true;
+
+	return contents;
+}
+
+std::function<void()> ChunkStorage::prepare_save(Rope &contents)
+{
+	Rope const snapshot = contents;
+	ChunkTree const chunks = chunks_;
+
+	return [this, snapshot, chunks]()
+	{
+		// without a matching chunk tree passed in, the snapshot is cut again
+		std::vector<ChunkTree::Chunk> const list = chunks.size() == snapshot.size()
+			? chunks.chunks()
+			: ChunkTree(snapshot).chunks();
+		std::size_t offset = 0;
+		std::lock_guard<std::mutex> lock(g_store_mutex);
+		bool const replacing = manifest_;
+
+		for (auto const &chunk: list)
+		{
+			write_chunk(chunk, snapshot, offset);
+			offset += chunk.length;
+		}
+
+		std::string const temporary_name = name_ + ".tmp";
+
+		replace(write_temporary(Rope(), temporary_name, encode(list)), temporary_name);
+		manifest_ = true;
+
+		// the previous manifest may have been the last one referring to some chunks
+		if (replacing)
+		{
+			collect_garbage();
+		}
+	};
+}
+
+void ChunkStorage::save(Rope &contents)
+{
+	DocumentStorage::save(contents);
+}
+
+int ChunkStorage::contents_file(std::size_t &offset)
+{
+	return manifest_ ? -1 : FileStorage::contents_file(offset);
+}
+
+void ChunkStorage::remove()
+{
+	std::lock_guard<std::mutex> lock(g_store_mutex);
+
+	FileStorage::remove();
+
+	if (manifest_)
+	{
+		collect_garbage();
+	}
+}
+
+std::string ChunkStorage::path_of(Hash::hash_t const &hash) const
+{
+	std::string const name = Hash::hash_to_string(hash);
+
+	return store_ + name.substr(0, 2) + '/' + name;
+}
+
+void ChunkStorage::write_chunk(ChunkTree::Chunk const &chunk, Rope const &contents,
+                               std::size_t offset) const
+{
+	std::string const path = path_of(chunk.hash);
+
+	// chunks are named after their contents, an existing one is the same
+	if (::access(path.c_str(), F_OK) == 0)
+	{
+		return;
+	}
+
+	make_directory(store_);
+	make_directory(path.substr(0, path.find_last_of('/')));
+
+	// pool threads may store the same chunk at once, each one writes a file of its own
+	std::string temporary_name = path + ".XXXXXX";
+	int const fd = ::mkstemp(&temporary_name[0]);
+
+	if (fd < 0)
+	{
+		throw DocumentError(describe_errno("creating", path));
+	}
+
+	try
+	{
+		// mkstemp creates the file private, chunks are as readable as documents
+		if (::fchmod(fd, 0644))
+		{
+			throw DocumentError(describe_errno("creating", path));
+		}
+
+		contents.for_each_span(offset, chunk.length,
+			[fd](char const *bytes, std::size_t size)
+			{
+				write_all(fd, bytes, size);
+			});
+
+		// the manifest referring to the chunk must not survive a crash without it
+		if (::fsync(fd))
+		{
+			throw DocumentError(describe_errno("saving", path));
+		}
+
+		if (::rename(temporary_name.c_str(), path.c_str()))
+		{
+			int const error = errno;
+
+			// the chunk stored meanwhile by someone else is the same
+			if (::access(path.c_str(), F_OK) != 0)
+			{
+				errno = error;
+				throw DocumentError(describe_errno("saving", path));
+			}
+
+			::unlink(temporary_name.c_str());
+		}
+	}
+	catch (...)
+	{
+		::close(fd);
+		::unlink(temporary_name.c_str());
+		throw;
+	}
+
+	::close(fd);
+}
+
+std::vector<char> ChunkStorage::encode(std::vector<ChunkTree::Chunk> const &chunks)
+{
+	std::vector<char> bytes(g_magic, g_magic + sizeof(g_magic));
+	std::size_t size = 0;
+
+	for (auto const &chunk: chunks)
+	{
+		size += chunk.length;
+	}
+
+	bytes.reserve(g_fixed_size + chunks.size() * g_chunk_size);
+	append(bytes, version, 4);
+	append(bytes, size, 8);
+	append(bytes, chunks.size(), 8);
+
+	for (auto const &chunk: chunks)
+	{
+		append(bytes, chunk.length, 4);
+		bytes.insert(bytes.end(), chunk.hash.begin(), chunk.hash.end());
+	}
+
+	return bytes;
+}
+
+bool ChunkStorage::decode(Rope const &file, std::string const &name,
+                          std::vector<ChunkTree::Chunk> &chunks)
+{
+	if (file.size() < g_fixed_size)
+	{
+		return false;
+	}
+
+	std::vector<char> bytes = file.read(0, g_fixed_size);
+
+	if (!std::equal(g_magic, g_magic + sizeof(g_magic), bytes.begin()))
+	{
+		return false;
+	}
+
+	std::size_t position = sizeof(g_magic);
+
+	if (extract(bytes, position, 4) != version)
+	{
+		throw DocumentError(describe_damage(name, "unknown manifest version"));
+	}
+
+	std::uint64_t const size = extract(bytes, position, 8);
+	std::uint64_t const count = extract(bytes, position, 8);
+
+	if (count != (file.size() - g_fixed_size) / g_chunk_size
+		|| (file.size() - g_fixed_size) % g_chunk_size)
+	{
+		throw DocumentError(describe_damage(name, "manifest doesn't match the file"));
+	}
+
+	std::size_t total = 0;
+
+	bytes = file.read(g_fixed_size, count * g_chunk_size);
+	position = 0;
+
+	for (std::uint64_t i = 0; i < count; i++)
+	{
+		ChunkTree::Chunk chunk;
+
+		chunk.length = extract(bytes, position, 4);
+		std::copy(bytes.begin() + position, bytes.begin() + position + chunk.hash.size(),
+		          chunk.hash.begin());
+		position += chunk.hash.size();
+		total += chunk.length;
+		chunks.push_back(chunk);
+	}
+
+	if (total != size)
+	{
+		throw DocumentError(describe_damage(name, "manifest chunks don't cover the contents"));
+	}
+
+	return true;
+}
+
+void ChunkStorage::collect_garbage() const
+{
+	std::string const root = DocumentLayout::root_of(name_);
+	std::unordered_set<std::string> referenced;
+
+	try
+	{
+		// documents in a flat directory lie next to the store, the others in shards
+		std::vector<std::string> paths;
+
+		for (auto const &name: DocumentLayout::read_directory(root, false))
+		{
+			paths.push_back(root + name);
+		}
+
+		for (auto const &name: DocumentLayout::list(root))
+		{
+			paths.push_back(DocumentLayout::path_of(root, name));
+		}
+
+		for (auto const &path: paths)
+		{
+			int const fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			std::vector<ChunkTree::Chunk> chunks;
+
+			// removed meanwhile
+			if (fd < 0)
+			{
+				continue;
+			}
+
+			try
+			{
+				if (is_manifest(fd))
+				{
+					decode(read_contents(fd, Document::OpenMode::read), path, chunks);
+				}
+			}
+			catch (...)
+			{
+				::close(fd);
+				throw;
+			}
+
+			::close(fd);
+
+			for (auto const &chunk: chunks)
+			{
+				referenced.insert(Hash::hash_to_string(chunk.hash));
+			}
+		}
+
+		for (auto const &shard: DocumentLayout::read_directory(store_, true))
+		{
+			std::string const directory = store_ + shard + '/';
+
+			// also catches temporary files of writes a crash interrupted
+			for (auto const &name: DocumentLayout::read_directory(directory, false))
+			{
+				if (!referenced.count(name))
+				{
+					::unlink((directory + name).c_str());
+				}
+			}
+
+			// fails unless the shard became empty
+			::rmdir(directory.c_str());
+		}
+	}
+	catch (DocumentError const &)
+	{
+		// the garbage stays until a later collection succeeds
+	}
+}
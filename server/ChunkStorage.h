@@ -0,0 +1,151 @@
+#ifndef CHUNKSTORAGE_H_INCLUDED
+#define CHUNKSTORAGE_H_INCLUDED
+
+#include "IndexedStorage.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @file ChunkStorage.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * The deduplicating storage: the contents are cut into the content-defined
+ * chunks of the ChunkTree and every chunk is kept once in a chunk store,
+ * as a file named after its SHA-1. The document file is a manifest listing
+ * the chunks in order, so documents sharing most of their contents share
+ * most of their chunks, and saving a document only writes the chunks the
+ * store doesn't have yet plus the manifest.
+ *
+ * The chunk store is the directory ".chunks" in the document directory,
+ * the chunk with the hash "ab12..." lives in ".chunks/ab/ab12...". All
+ * numbers of the manifest are stored big endian:
+ *
+ *   magic       8 bytes  "\x89" "CTECHK\n"
+ *   version     4 bytes  1
+ *   size        8 bytes  the number of bytes of the contents
+ *   chunks      8 bytes  the number of chunks
+ *   chunks times
+ *               4 bytes  the length of the chunk
+ *              20 bytes  the SHA-1 hash of the chunk
+ *
+ * The contents are read onto the heap whatever the open mode. A save
+ * replacing a manifest and the removal of a manifest collect the garbage of
+ * the store: the manifests of all documents in the document directory are
+ * read, and the chunks none of them refers to are deleted. Writing chunks
+ * and collecting exclude each other within the process, so a collection
+ * never sees chunks whose manifest isn't written yet. A plain document file
+ * opened with this storage becomes a manifest with its next save.
+ */
+
+class ChunkStorage
+	: public IndexedStorage
+{
+public:
+	/**
+	 * The format version written by this storage.
+	 */
+	static std::uint32_t const version = 1;
+
+	/**
+	 * Construct the storage for an opened document file, which may still
+	 * be a plain file.
+	 *
+	 * @param fd The readable descriptor of the document file, the storage
+	 *           takes ownership.
+	 * @param name The path of the document file.
+	 * @param mode How a plain document file is brought into memory.
+	 */
+	ChunkStorage(int fd, std::string const &name, Document::OpenMode mode);
+
+	/**
+	 * Check if a file is a manifest by looking at its magic.
+	 *
+	 * @param fd A readable descriptor of the file.
+	 */
+	static bool is_manifest(int fd);
+
+	/**
+	 * Obtain the chunk store of a document.
+	 *
+	 * @param name The path of the document file.
+	 * @return The directory of the chunk store, ending with a slash.
+	 */
+	static std::string store_of(std::string const &name);
+
+	/**
+	 * @throws DocumentError If the file is a manifest with a damaged header,
+	 *                       an unknown version or chunks missing in the store.
+	 */
+	Rope load();
+
+	/**
+	 * The job writes the chunks missing in the store, then writes the
+	 * manifest to a temporary file which replaces the document.
+	 */
+	std::function<void()> prepare_save(Rope &contents);
+
+	/**
+	 * Save without bringing the contents into memory again.
+	 */
+	void save(Rope &contents);
+
+	/**
+	 * A manifest doesn't hold the contents.
+	 */
+	int contents_file(std::size_t &offset);
+
+	/**
+	 * Remove the document file and the chunks only it referred to.
+	 */
+	void remove();
+
+private:
+	/**
+	 * Obtain the path of a chunk in the store.
+	 */
+	std::string path_of(Hash::hash_t const &hash) const;
+
+	/**
+	 * Write a chunk to the store unless it is already there.
+	 *
+	 * @param chunk The chunk.
+	 * @param contents The contents holding the chunk.
+	 * @param offset The offset of the chunk in the contents.
+	 * @throws DocumentError If writing fails.
+	 */
+	void write_chunk(ChunkTree::Chunk const &chunk, Rope const &contents,
+	                 std::size_t offset) const;
+
+	/**
+	 * Encode the manifest of contents cut into chunks.
+	 */
+	static std::vector<char> encode(std::vector<ChunkTree::Chunk> const &chunks);
+
+	/**
+	 * Decode and check a manifest.
+	 *
+	 * @param file All bytes of the file.
+	 * @param name The path of the file.
+	 * @param chunks Receives the chunks.
+	 * @return False if the file isn't a manifest.
+	 * @throws DocumentError If the manifest is damaged or has an unknown version.
+	 */
+	static bool decode(Rope const &file, std::string const &name,
+	                   std::vector<ChunkTree::Chunk> &chunks);
+
+	/**
+	 * Delete the chunks of the store no manifest in the document directory
+	 * refers to. Nothing is deleted if a manifest can't be read, it might
+	 * refer to any chunk. Called with the store locked.
+	 */
+	void collect_garbage() const;
+
+	std::string const store_;
+	// the document file is a manifest
+	bool manifest_;
+};
+
+#endif
@@ -0,0 +1,226 @@
+#include "ChunkTree.h"
+
+#include "Chunker.h"
+
+#include <algorithm>
+
+/**
+ * @file ChunkTree.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the chunk hash tree.
+ */
+
+namespace
+{
+	// the contents are read in windows of this size while cutting
+	std::size_t const g_cut_window_size = 64 * 1024;
+}
+
+ChunkTree::Summary ChunkTree::ChunkTraits::measure(Chunk const &chunk)
+{
+	Summary summary;
+
+	summary.length = chunk.length;
+	summary.count = 1;
+	summary.hash = chunk.hash;
+
+	return summary;
+}
+
+ChunkTree::Summary ChunkTree::ChunkTraits::combine(Summary const &left, Summary const &right)
+{
+	if (!left.count)
+	{
+		return right;
+	}
+
+	if (!right.count)
+	{
+		return left;
+	}
+
+	char bytes[2 * sizeof(Hash::hash_t)];
+
+	std::copy(left.hash.begin(), left.hash.end(), bytes);
+	std::copy(right.hash.begin(), right.hash.end(), bytes + sizeof(Hash::hash_t));
+
+	Summary summary;
+
+	summary.length = left.length + right.length;
+	summary.count = left.count + right.count;
+	summary.hash = Hash::hash_bytes(bytes, sizeof(bytes));
+
+	return summary;
+}
+
+std::uint64_t ChunkTree::ChunkTraits::priority(Chunk const &chunk)
+{
+	std::uint64_t priority = 0;
+
+	for (std::size_t i = 0; i < 8; i++)
+	{
+		priority = (priority << 8) | static_cast<unsigned char>(chunk.hash[i]);
+	}
+
+	return priority;
+}
+
+std::pair<ChunkTree::Chunk, ChunkTree::Chunk> ChunkTree::ChunkTraits::split(Chunk const &,
+                                                                            std::size_t)
+{
+	// the tree is only ever split at chunk boundaries
+	throw std::logic_error("chunks can't be split");
+}
+
+ChunkTree::ChunkTree()
+{
+}
+
+ChunkTree::ChunkTree(Rope const &contents)
+{
+	std::vector<Chunk> chunks;
+
+	cut(contents, 0, [](std::size_t) { return false; }, chunks);
+	root_ = build(chunks);
+}
+
+ChunkTree::ChunkTree(std::vector<Chunk> const &chunks)
+	: root_(build(chunks))
+{
+}
+
+Hash::hash_t ChunkTree::root() const
+{
+	if (!root_)
+	{
+		return Hash::Builder().finish();
+	}
+
+	return root_->summary.hash;
+}
+
+void ChunkTree::update(Rope const &contents, std::size_t offset, std::size_t erased,
+                       std::size_t inserted)
+{
+	std::size_t const old_size = size();
+
+	if (!old_size)
+	{
+		*this = ChunkTree(contents);
+		return;
+	}
+
+	/* start with the chunk holding the byte in front of the edit, it could
+	 * have been the last one which ended with the contents
+	 */
+	std::size_t local = 0;
+	std::size_t const anchor = offset ? offset - 1 : 0;
+
+	tree::find(root_, anchor, local);
+
+	std::size_t const begin = anchor - local;
+	tree::node_ptr const &old_root = root_;
+
+	/* once a chunk ends behind the edit where an old one ended, all following
+	 * chunks are the same as before
+	 */
+	auto const resynchronized = [&](std::size_t end)
+	{
+		if (end < offset + inserted)
+		{
+			return false;
+		}
+
+		std::size_t const old_end = end - inserted + erased;
+		std::size_t old_local = 0;
+
+		return old_end == old_size || (old_end < old_size &&
+			tree::find(old_root, old_end, old_local) && old_local == 0);
+	};
+
+	std::vector<Chunk> chunks;
+	std::size_t const end = cut(contents, begin, resynchronized, chunks);
+	std::size_t const old_end = end == contents.size() ? old_size : end - inserted + erased;
+
+	auto const head = tree::split(root_, begin);
+	auto const tail = tree::split(head.second, old_end - begin);
+
+	root_ = tree::merge(tree::merge(head.first, build(chunks)), tail.second);
+}
+
+std::vector<ChunkTree::Chunk> ChunkTree::chunks() const
+{
+	std::vector<Chunk> chunks;
+	auto collect = [&chunks](Chunk const &chunk, std::size_t, std::size_t)
+	{
+		chunks.push_back(chunk);
+	};
+
+	chunks.reserve(count());
+	tree::for_each(root_, 0, size(), collect);
+
+	return chunks;
+}
+
+std::size_t ChunkTree::cut(Rope const &contents, std::size_t begin,
+                           std::function<bool(std::size_t)> const &stop,
+                           std::vector<Chunk> &chunks)
+{
+	std::size_t const size = contents.size();
+	std::size_t position = begin;
+	std::size_t chunk_begin = begin;
+	bool stopped = false;
+	Chunker chunker;
+	Hash::Builder builder;
+
+	while (!stopped && position < size)
+	{
+		std::size_t const window = std::min(size - position, g_cut_window_size);
+
+		contents.for_each_span(position, window,
+			[&](char const *bytes, std::size_t length)
+			{
+				while (length && !stopped)
+				{
+					std::size_t const consumed = chunker.feed(bytes, length);
+
+					builder.update(bytes, consumed);
+					bytes += consumed;
+					length -= consumed;
+					position += consumed;
+
+					if (chunker.at_boundary())
+					{
+						Chunk const chunk = { position - chunk_begin, builder.finish() };
+
+						chunks.push_back(chunk);
+						chunk_begin = position;
+						stopped = stop(position);
+					}
+				}
+			});
+	}
+
+	// the last chunk ends with the contents
+	if (position > chunk_begin)
+	{
+		Chunk const chunk = { position - chunk_begin, builder.finish() };
+
+		chunks.push_back(chunk);
+	}
+
+	return position;
+}
+
+ChunkTree::tree::node_ptr ChunkTree::build(std::vector<Chunk> const &chunks)
+{
+	tree::node_ptr root;
+
+	for (auto const &chunk: chunks)
+	{
+		root = tree::merge(root, tree::make(chunk));
+	}
+
+	return root;
+}
@@ -0,0 +1,158 @@
+#ifndef CHUNKTREE_H_INCLUDED
+#define CHUNKTREE_H_INCLUDED
+
+#include "Hash.h"
+#include "PersistentTreap.h"
+#include "Rope.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/**
+ * @file ChunkTree.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * A Merkle tree over the content-defined chunks of a document.
+ *
+ * The contents are cut into chunks by the Chunker and every chunk is hashed
+ * with SHA-1. The chunks are kept in a treap whose priorities are the first
+ * eight bytes of the chunk hashes (big endian), so its shape only depends on
+ * the contents. Every node hashes its subtree as
+ *
+ *   node = H(H(left || chunk) || right)
+ *
+ * where a missing child is left out together with its hash step, so a leaf
+ * is just the hash of its chunk and a document consisting of one chunk
+ * hashes like the plain SHA-1 of its contents. The root is the hash of the
+ * whole document, an empty document hashes like an empty byte sequence.
+ *
+ * After an edit only the chunks around the edit are cut and hashed again,
+ * which costs O(log n) tree operations.
+ */
+
+class ChunkTree
+{
+public:
+	struct Chunk
+	{
+		std::size_t length;
+		Hash::hash_t hash;
+	};
+
+	/**
+	 * Construct the tree of an empty document.
+	 */
+	ChunkTree();
+
+	/**
+	 * Cut and hash all the contents.
+	 *
+	 * @param contents The contents of the document.
+	 */
+	explicit ChunkTree(Rope const &contents);
+
+	/**
+	 * Restore a tree from its chunks, as returned by chunks(). The shape
+	 * and the hashes come out as if the contents were cut again.
+	 *
+	 * @param chunks The chunks in order.
+	 */
+	explicit ChunkTree(std::vector<Chunk> const &chunks);
+
+	/**
+	 * Obtain the hash of the whole contents.
+	 */
+	Hash::hash_t root() const;
+
+	/**
+	 * Obtain the number of bytes covered by the chunks.
+	 */
+	std::size_t size() const
+	{
+		return tree::length(root_);
+	}
+
+	/**
+	 * Obtain the number of chunks.
+	 */
+	std::size_t count() const
+	{
+		return tree::summary(root_).count;
+	}
+
+	/**
+	 * Bring the tree up to date after the contents were edited.
+	 *
+	 * @param contents The contents after the edit.
+	 * @param offset The offset of the edit.
+	 * @param erased The number of bytes erased at the offset.
+	 * @param inserted The number of bytes inserted at the offset.
+	 */
+	void update(Rope const &contents, std::size_t offset, std::size_t erased,
+	            std::size_t inserted);
+
+	/**
+	 * Obtain all chunks in order.
+	 */
+	std::vector<Chunk> chunks() const;
+
+private:
+	struct Summary
+	{
+		Summary()
+			: length(0),
+			  count(0)
+		{
+		}
+
+		std::size_t length;
+		std::size_t count;
+		Hash::hash_t hash;
+	};
+
+	struct ChunkTraits
+	{
+		typedef Chunk value_type;
+		typedef Summary summary_type;
+
+		static Summary measure(Chunk const &chunk);
+		static Summary combine(Summary const &left, Summary const &right);
+
+		static std::size_t length(Summary const &summary)
+		{
+			return summary.length;
+		}
+
+		static std::uint64_t priority(Chunk const &chunk);
+		static std::pair<Chunk, Chunk> split(Chunk const &chunk, std::size_t offset);
+	};
+
+	typedef PersistentTreap<ChunkTraits> tree;
+
+	/**
+	 * Cut and hash the contents starting at an offset.
+	 *
+	 * @param contents The contents to cut.
+	 * @param begin The offset of the first chunk.
+	 * @param stop Called with the end of each chunk, stops cutting if it
+	 *             returns true.
+	 * @param chunks Receives the chunks.
+	 * @return The end of the last chunk.
+	 */
+	static std::size_t cut(Rope const &contents, std::size_t begin,
+	                       std::function<bool(std::size_t)> const &stop,
+	                       std::vector<Chunk> &chunks);
+
+	/**
+	 * Create a tree from chunks in order.
+	 */
+	static tree::node_ptr build(std::vector<Chunk> const &chunks);
+
+	tree::node_ptr root_;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#include "Chunker.h"
+
+/**
+ * @file Chunker.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the content-defined chunking.
+ */
+
+namespace
+{
+	// the 13 high bits, leads to an average chunk size of 8 KiB above min_size
+	std::uint64_t const g_boundary_mask = 0xfff8000000000000ULL;
+
+	struct GearTable
+	{
+		GearTable()
+		{
+			std::uint64_t state = 0;
+
+			for (auto &entry: entries)
+			{
+				// splitmix64
+				state += 0x9e3779b97f4a7c15ULL;
+
+				std::uint64_t value = state;
+
+				value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+				value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+				entry = value ^ (value >> 31);
+			}
+		}
+
+		std::uint64_t entries[256];
+	};
+
+	GearTable const g_gear_table;
+}
+
+std::size_t const Chunker::min_size;
+std::size_t const Chunker::max_size;
+
+Chunker::Chunker()
+	: hash_(0),
+	  length_(0)
+{
+}
+
+std::size_t Chunker::feed(char const *bytes, std::size_t size)
+{
+	for (std::size_t i = 0; i < size; i++)
+	{
+		hash_ = (hash_ << 1) + g_gear_table.entries[static_cast<unsigned char>(bytes[i])];
+		length_++;
+
+		if (length_ >= max_size || (length_ >= min_size && !(hash_ & g_boundary_mask)))
+		{
+			hash_ = 0;
+			length_ = 0;
+
+			return i + 1;
+		}
+	}
+
+	return size;
+}
@@ -0,0 +1,65 @@
+#ifndef CHUNKER_H_INCLUDED
+#define CHUNKER_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @file Chunker.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Content-defined chunking of byte streams.
+ *
+ * A gear hash rolls over the bytes of the current chunk and a chunk ends
+ * after a byte once the 13 high bits of the hash are zero, but never
+ * before min_size and at the latest after max_size bytes. The last chunk of
+ * a stream ends with the stream. The hash restarts with every chunk, so a
+ * chunk boundary only depends on the bytes of its own chunk and an edit
+ * only moves the boundaries close to it.
+ *
+ * The gear table consists of the first 256 outputs of splitmix64 seeded
+ * with 0, clients which want to produce the same chunks have to use the
+ * same table and sizes.
+ */
+
+class Chunker
+{
+public:
+	static std::size_t const min_size = 2 * 1024;
+	static std::size_t const max_size = 64 * 1024;
+
+	Chunker();
+
+	/**
+	 * Feed bytes of the stream until the current chunk ends.
+	 *
+	 * @param bytes The next bytes of the stream.
+	 * @param size The number of bytes.
+	 * @return The number of bytes consumed. If it's less than size or
+	 *         at_boundary() returns true, the current chunk ended with the
+	 *         last consumed byte and the next chunk starts.
+	 */
+	std::size_t feed(char const *bytes, std::size_t size);
+
+	/**
+	 * Check if the last feed() ended a chunk.
+	 */
+	bool at_boundary() const
+	{
+		return length_ == 0;
+	}
+
+	/**
+	 * Obtain the number of bytes fed into the current chunk.
+	 */
+	std::size_t pending() const
+	{
+		return length_;
+	}
+
+private:
+	std::uint64_t hash_;
+	std::size_t length_;
+};
+
+#endif
@@ -9,13 +9,15 @@
 #include "Client.h"
 #include "errno.h"
 #include "exceptions.h"
+#include "MessageView.h"
 
 Client::Client(int listener):
-	active_document(0), cursor(0), socket(accept(listener, 0, 0)), user_id(0)
+	active_document(0), socket(accept4(listener, 0, 0, SOCK_NONBLOCK)),
+	user_id(0), decoded(0), awaited(0), resync_due(false), hung_up(false)
 {
 	// check if a client was accepted
 	if (this->socket == -1)
-	{ throw Exception::ErrnoError("failed to accept a new client", errno, "accept"); }
+	{ throw Exception::ErrnoError("failed to accept a new client", errno, "accept4"); }
 }
 
 Client::~Client(void)
@@ -24,5 +26,148 @@ Client::~Client(void)
 	close(this->socket);
 }
 
-void Client::send(const std::vector<char> &bytes) const
-{}
+const size_t
+	Client::HIGH_WATERMARK,
+	Client::LOW_WATERMARK,
+	Client::DISCONNECT_LIMIT,
+	Client::MAX_QUEUED_CONTENTS;
+
+bool Client::receive(MessageList &dest, MessageList::iterator &tail)
+{
+	const bool open = this->received.fill(this->socket);
+
+	// decode every complete message, not just the first one
+	while (this->received.size() > this->decoded
+		&& this->received.size() - this->decoded >= this->awaited)
+	{
+		// a view that couldn't be decoded mustn't stay in the list, it has no source
+		MessageList::iterator message = dest.emplace_after(tail);
+		size_t used;
+		try
+		{
+			used = message->parse(shared_from_this(), this->received.data() + this->decoded,
+				this->received.size() - this->decoded, this->awaited);
+		}
+		catch (...)
+		{
+			dest.erase_after(tail);
+			throw;
+		}
+		if (!used)
+		{
+			dest.erase_after(tail);
+			break;
+		}
+
+		this->decoded += used;
+		this->awaited = 0;
+		tail = message;
+	}
+
+	return open;
+}
+
+void Client::release_messages(void)
+{
+	this->received.consume(this->decoded);
+	this->decoded = 0;
+}
+
+void Client::rewind(const MessageView &message)
+{
+	this->decoded = message.raw.data - this->received.data();
+	this->awaited = 0;
+}
+
+void Client::send(const std::vector<char> &bytes)
+{ this->send(bytes.data(), bytes.size()); }
+
+void Client::send(const char *bytes, uint64_t size)
+{
+	if (this->hung_up)
+	{ return; }
+
+	try
+	{ this->pending.write(this->socket, bytes, size, false); }
+	catch (const Exception::ErrnoError &)
+	{
+		this->hang_up();
+		return;
+	}
+
+	this->limit();
+}
+
+void Client::send_edit(const std::vector<char> &bytes)
+{
+	// the resync brings the window up to date, the edits meanwhile don't matter
+	if (this->hung_up || this->resync_due)
+	{ return; }
+
+	try
+	{ this->pending.write(this->socket, bytes.data(), bytes.size(), true); }
+	catch (const Exception::ErrnoError &)
+	{
+		this->hang_up();
+		return;
+	}
+
+	if (this->pending.size() >= HIGH_WATERMARK)
+	{
+		this->pending.drop_edits();
+		this->resync_due = true;
+	}
+
+	this->limit();
+}
+
+void Client::send_contents(const Document &document, uint64_t position, uint64_t length)
+{
+	if (this->hung_up)
+	{ return; }
+
+	try
+	{ this->pending.write(this->socket, document, position, length); }
+	catch (const Exception::ErrnoError &)
+	{
+		this->hang_up();
+		return;
+	}
+
+	this->limit();
+}
+
+bool Client::flush(void)
+{
+	if (this->hung_up)
+	{ return false; }
+
+	try
+	{ this->pending.flush(this->socket); }
+	catch (const Exception::ErrnoError &)
+	{
+		this->hang_up();
+		return false;
+	}
+
+	if (!this->resync_due || this->pending.size() > LOW_WATERMARK)
+	{ return false; }
+
+	this->resync_due = false;
+	return true;
+}
+
+void Client::limit(void)
+{
+	if (this->pending.size() > DISCONNECT_LIMIT
+		|| this->pending.contents() > MAX_QUEUED_CONTENTS)
+	{ this->hang_up(); }
+}
+
+void Client::hang_up(void)
+{
+	// the socket stays open until the Client is gone, it reports the shutdown like a hangup
+	shutdown(this->socket, SHUT_RDWR);
+	this->pending.clear();
+	this->hung_up = true;
+}
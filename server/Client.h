@@ -7,20 +7,41 @@
 #ifndef _CLIENT_H_
 #define _CLIENT_H_
 
+#include <cstddef> // size_t
 #include <cstdint> // uint32_t
+#include <memory>
 #include <vector>
 
-class Client
+#include "ClientCollection.h"
+#include "ReceiveBuffer.h"
+#include "SendQueue.h"
+#include "Viewport.h"
+
+class Client:
+	public std::enable_shared_from_this<Client>
 {
 	public:
+		// the cursor is kept by the active document, see Document::get_cursors
 		uint32_t	active_document;
-		uint64_t	cursor;
 		const int	socket;
 		uint32_t	user_id;
+		// window of the active document the client receives edits for, the whole document
+		// unless it subscribed to a viewport
+		Viewport	viewport;
+
+		/// queued frame bytes from which a client's edits are dropped for a resync, see send_edit
+		static const size_t HIGH_WATERMARK = 1024 * 1024;
+		/// queued frame bytes up to which a client due for a resync gets it, see flush
+		static const size_t LOW_WATERMARK = 256 * 1024;
+		/// queued frame bytes beyond which a client is disconnected
+		static const size_t DISCONNECT_LIMIT = 16 * 1024 * 1024;
+		/// queued ranges of contents beyond which a client is disconnected
+		static const size_t MAX_QUEUED_CONTENTS = 64;
 
 		/*
 			Uses the specified listening socket to accept a new incoming client connection.
-			Therefore it uses the low-level function accept (sys/socket.h).
+			Therefore it uses the low-level function accept4 (sys/socket.h), the socket of the
+			client doesn't block.
 				listener - listening socket
 			=#	Exception::ErrnoException - if accept fails
 		*/
@@ -30,11 +51,87 @@ class Client
 		*/
 		~Client(void);
 
-		template<typename T>
-		void receive(T *destination, uint64_t size) const;
-		void send(const std::vector<char> &bytes) const;
-};
+		/*
+			Receives everything the socket has available without blocking and decodes all
+			complete messages from it in place. The bytes of an incomplete message are kept until
+			the rest of it has arrived, and aren't decoded again before. The messages of the
+			previous call have to be released first.
+				dest
+				tail - decoded messages are inserted behind, points to the last one afterwards
+			=>	false if the peer closed the connection
+			=#	ReceiveBuffer::fill
+			=#	MessageView::parse
+		*/
+		bool receive(MessageList &dest, MessageList::iterator &tail);
+		/*
+			Drops the bytes of the messages decoded by receive from the receive buffer, which
+			invalidates their spans.
+		*/
+		void release_messages(void);
+		/*
+			Makes receive decode the given message and the ones behind it once more, e.g. after
+			the Client was handed to another thread before they were handled.
+				message - a message decoded by the last call of receive
+		*/
+		void rewind(const MessageView &message);
+		/*
+			Sends the given bytes without blocking, they are queued as far as the socket doesn't
+			take them right away and follow once it's writable again, see flush. A client whose
+			socket failed or whose queue grew beyond DISCONNECT_LIMIT is hung up on instead, its
+			socket then reports the hangup like a peer that closed the connection.
+				bytes
+		*/
+		void send(const std::vector<char> &bytes);
+		/*
+			Like send(const std::vector<char> &).
+				bytes - pointer to the first byte
+				size - number of bytes to send
+		*/
+		void send(const char *bytes, uint64_t size);
+		/*
+			Like send(const std::vector<char> &) for an edit frame, which is coalesced with the
+			edit frames waiting in front of it where possible. Once HIGH_WATERMARK bytes are
+			queued, the client lags too far behind to catch up edit by edit: its queued edits are
+			dropped, further ones are ignored and it is due for a resync instead, see flush.
+				bytes
+		*/
+		void send_edit(const std::vector<char> &bytes);
+		/*
+			Like send(const std::vector<char> &) for a range of the contents of a document, which
+			is never copied, see SendQueue::write(int, const Document &, uint64_t, uint64_t).
+				document
+				position - offset of the range in the document
+				length - number of bytes to send
+		*/
+		void send_contents(const Document &document, uint64_t position, uint64_t length);
+		/*
+			Sends the queued bytes as far as the socket takes them without blocking, once it
+			became writable.
+			=>	true if the client is due for a resync and is back below LOW_WATERMARK, the
+				caller sends it its window of the active document anew
+		*/
+		bool flush(void);
 
-#include "Client.tcc"
+	private:
+		ReceiveBuffer	received;
+		// number of bytes at the front of the buffer decoded into messages that aren't released
+		size_t			decoded;
+		// number of bytes the incomplete message behind the decoded ones needs at least
+		size_t			awaited;
+		SendQueue		pending;
+		// edits are dropped until the client got its window anew, see send_edit
+		bool			resync_due;
+		// the client was hung up on, nothing is sent anymore
+		bool			hung_up;
+
+		/*
+			Hangs up on the client if its queue grew beyond the limits.
+		*/
+		void limit(void);
+		/*
+			Shuts the connection down and drops the queue, the socket reports the hangup.
+		*/
+		void hang_up(void);
+};
 
 #endif
@@ -4,10 +4,10 @@
 	created: Thursday, 24th May 2012
 **/
 
-#include <sys/select.h>
 #include "exceptions.h"
 #include "Client.h"
 #include "ClientCollection.h"
+#include "MessageView.h"
 
 Client &ClientCollection::accept_client(int listener)
 {
@@ -17,46 +17,97 @@ Client &ClientCollection::accept_client(int listener)
 	return *client;
 }
 
+void ClientCollection::add_client(ClientSptr client)
+{ this->clients[client->socket] = client; }
+
+ClientSptr ClientCollection::remove_client(int socket)
+{
+	std::unordered_map<int, ClientSptr>::iterator client = this->clients.find(socket);
+	if (client == this->clients.end())
+	{ return ClientSptr(); }
+
+	ClientSptr removed = client->second;
+	this->clients.erase(client);
+
+	return removed;
+}
+
+bool ClientCollection::contains(const Client &client) const
+{
+	std::unordered_map<int, ClientSptr>::const_iterator found = this->clients.find(client.socket);
+	return found != this->clients.end() && found->second.get() == &client;
+}
+
 void ClientCollection::broadcast(const std::vector<char> &bytestream) const
 {
 	for (const std::pair<int, ClientSptr> &client: clients)
 	{
-		// TODO: add try-catch
+		// never blocks, a lagging client only queues
 		client.second->send(bytestream);
 	}
 }
 
-int ClientCollection::fill_fd_set(fd_set *set) const
+void ClientCollection::broadcast(const std::vector<char> &bytestream, uint32_t document,
+	const Client *except) const
 {
-	int end = 0;
-	
-	for (const std::pair<int, ClientSptr> &client: this->clients)
+	for (const std::pair<const int, ClientSptr> &client: clients)
 	{
-		FD_SET(client.first, set);
-		end = std::max(end, client.first);
+		if (client.second->active_document == document && client.second.get() != except)
+		{ client.second->send(bytestream); }
 	}
-	
-	return end;
 }
 
-MessageList &ClientCollection::get_messages_by_fd_set(fd_set *set, int fd_max, MessageList &list)
+void ClientCollection::broadcast_edit(const std::vector<char> &edit,
+	const std::vector<char> &shift, uint32_t document, uint64_t offset, uint64_t erased,
+	uint64_t inserted, const Client *except) const
 {
-	MessageList::iterator message = list.begin();
-
-	// iterate through all fds in the set and handle the set ones
-	for (int fd = 0; fd < fd_max; ++fd)
+	for (const std::pair<const int, ClientSptr> &client: clients)
 	{
-		// ignore unset
-		if (!FD_ISSET(fd, set))
+		if (client.second->active_document != document)
 		{ continue; }
 
-		// read message from set
-		message->receive_from(clients[fd]);
+		const Viewport::Effect effect = client.second->viewport.apply(offset, erased, inserted);
+		if (client.second.get() == except)
+		{ continue; }
 
-		// break if the list is full
-		if (++message == list.end())
-		{ break; }
+		if (effect == Viewport::Effect::overlap)
+		{ client.second->send_edit(edit); }
+		else if (effect == Viewport::Effect::shift)
+		{ client.second->send_edit(shift); }
 	}
+}
+
+void ClientCollection::receive_messages(int fd, bool hung_up, MessageList &list,
+	MessageList::iterator &tail, std::vector<ClientSptr> &disconnected)
+{
+	std::unordered_map<int, ClientSptr>::iterator client = this->clients.find(fd);
+	if (client == this->clients.end())
+	{ return; }
+
+	// read all complete messages, a broken connection only costs its own client
+	bool open;
+	try
+	{ open = client->second->receive(list, tail) && !hung_up; }
+	catch (const Exception::ErrnoError &)
+	{ open = false; }
+	catch (const Exception::InvalidMessageType &)
+	{ open = false; }
+	catch (const Exception::InvalidMessageLength &)
+	{ open = false; }
+
+	if (!open)
+	{
+		disconnected.push_back(client->second);
+		this->clients.erase(client);
+	}
+}
+
+void ClientCollection::flush(int fd, std::vector<ClientSptr> &lagging)
+{
+	std::unordered_map<int, ClientSptr>::iterator client = this->clients.find(fd);
+	if (client == this->clients.end())
+	{ return; }
 
-	return list;
+	if (client->second->flush())
+	{ lagging.push_back(client->second); }
 }
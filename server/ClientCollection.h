@@ -9,14 +9,14 @@
 
 #include <forward_list>
 #include <memory>
-#include <sys/select.h>
 #include <unordered_map>
+#include <vector>
 
 class Client;
-class Message;
+class MessageView;
 
 typedef std::shared_ptr<Client> ClientSptr;
-typedef std::forward_list<Message> MessageList;
+typedef std::forward_list<MessageView> MessageList;
 
 class ClientCollection
 {
@@ -29,27 +29,78 @@ class ClientCollection
 		**/
 		Client &accept_client(int listener);
 		/**
-			Sends the given bytestream to all clients of this ClientCollection.
+			Adds a Client accepted by another ClientCollection.
+				client
+		**/
+		void add_client(ClientSptr client);
+		/**
+			Removes a Client without closing its socket, e.g. to hand it to another
+			ClientCollection.
+				socket
+			=>	the Client, null if there is none with the given socket
+		**/
+		ClientSptr remove_client(int socket);
+		/**
+			Checks whether the given Client belongs to this ClientCollection.
+				client
+		**/
+		bool contains(const Client &client) const;
+		/**
+			Sends the given bytestream to all clients of this ClientCollection. Sending never
+			blocks, a client that doesn't keep up queues what it can't take, so it delays nobody
+			but itself, see Client::send.
 				bytestream
-			=#	Client::send(std::vector<char>)
 		**/
 		void broadcast(const std::vector<char> &bytestream) const;
 		/**
-			Adds all clients' sockets to the given fd_set using the makro FD_SET.
-				set
-			=>	client socket with the highest integral value of all added sockets
+			Sends the given bytestream to all clients of this ClientCollection that have the given
+			document active.
+				 bytestream
+				 document - id of the document
+				*except - client to leave out
+		**/
+		void broadcast(const std::vector<char> &bytestream, uint32_t document,
+			const Client *except = 0) const;
+		/**
+			Lets the viewports of all clients that have the given document active follow an edit
+			and sends them what the edit means to their window: the edit itself if it overlaps
+			the window, the shift if it moves the window, nothing otherwise. Clients lagging
+			behind get them coalesced or are resynced instead, see Client::send_edit.
+				 edit - bytestream of the edit
+				 shift - bytestream announcing the shift
+				 document - id of the document
+				 offset, erased, inserted - the edit, see Viewport::apply
+				*except - client to leave out, its viewport follows nonetheless
 		**/
-		int fill_fd_set(fd_set *set) const;
+		void broadcast_edit(const std::vector<char> &edit, const std::vector<char> &shift,
+			uint32_t document, uint64_t offset, uint64_t erased, uint64_t inserted,
+			const Client *except = 0) const;
 		/**
-			Collects the oldest unread message in the queue from each socket that's set as readable
-			in the fd_set. Each of those has to be one of a currently connected Client. Stores all
-			received messages in the given MessageList.
-				set
-				fd_max -> <sys/select.h> select(nfds)
+			Receives everything the client with the given socket has sent without blocking and
+			inserts all complete messages into the given MessageList. As sockets are watched
+			edge-triggered, the socket is drained completely.
+			The messages point into the receive buffer of their source, which has to release them
+			once they are handled, see Client::release_messages.
+			Sockets that aren't one of a currently connected Client are ignored.
+			Clients whose peer closed the connection, whose socket failed or who sent a malformed
+			message are removed from this ClientCollection and stored in `disconnected`, the
+			messages they sent before are kept. Their sockets are closed as soon as the last
+			reference is gone.
+				fd
+				hung_up - whether the peer hung up, so nothing follows what is received now
 				dest
-			=>	`dest`
+				tail - see Client::receive
+				disconnected
+		**/
+		void receive_messages(int fd, bool hung_up, MessageList &dest,
+			MessageList::iterator &tail, std::vector<ClientSptr> &disconnected);
+		/**
+			Sends what is queued for the client with the given socket, once the socket became
+			writable. Sockets that aren't one of a currently connected Client are ignored.
+				fd
+				lagging - receives the client if it's due for a resync, see Client::flush
 		**/
-		MessageList &get_messages_by_fd_set(fd_set *set, int fd_max, MessageList &dest);
+		void flush(int fd, std::vector<ClientSptr> &lagging);
 		
 	private:
 		/// maps socket => Client
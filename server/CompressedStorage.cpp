@@ -0,0 +1,444 @@
+#include "CompressedStorage.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#include <unistd.h>
+#include <zlib.h>
+
+/**
+ * @file CompressedStorage.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the compressed document storage.
+ */
+
+namespace
+{
+	// the leading non-ASCII byte keeps text files from being mistaken for compressed ones
+	char const g_magic[8] = { '\x89', 'C', 'T', 'E', 'Z', 'I', 'P', '\n' };
+
+	// magic, version, size and the three counts
+	std::size_t const g_fixed_size = sizeof(g_magic) + 4 + 4 * 8;
+	std::size_t const g_run_size = 4 + 4;
+	std::size_t const g_chunk_size = 4 + sizeof(Hash::hash_t);
+	std::size_t const g_block_size = 4 + 4;
+
+	/**
+	 * A block of the compressed file, inflated the first time its bytes
+	 * are asked for. Versions share the contents across threads, so the
+	 * inflation happens once under a flag.
+	 */
+	class CompressedBuffer
+		: public Rope::Buffer
+	{
+	public:
+		CompressedBuffer(Rope::buffer_ptr const &file, std::size_t offset,
+		                 std::size_t compressed_size, std::size_t size,
+		                 std::string const &damage)
+			: file_(file),
+			  offset_(offset),
+			  compressed_size_(compressed_size),
+			  size_(size),
+			  damage_(damage)
+		{
+		}
+
+		/**
+		 * @throws DocumentError If the block is damaged.
+		 */
+		char const *data() const
+		{
+			std::call_once(inflated_, [this]() { inflate(); });
+
+			return bytes_.get();
+		}
+
+		std::size_t size() const
+		{
+			return size_;
+		}
+
+		char const *compressed() const
+		{
+			return file_->data() + offset_;
+		}
+
+		std::size_t compressed_size() const
+		{
+			return compressed_size_;
+		}
+
+	private:
+		void inflate() const
+		{
+			std::unique_ptr<char[]> bytes(new char[size_]);
+			uLongf length = size_;
+			int const result = ::uncompress(reinterpret_cast<Bytef *>(bytes.get()), &length,
+			                                 reinterpret_cast<Bytef const *>(compressed()),
+			                                 compressed_size_);
+
+			if (result != Z_OK || length != size_)
+			{
+				throw document_errors::DocumentError(damage_);
+			}
+
+			bytes_ = std::move(bytes);
+		}
+
+		// keeps the compressed bytes alive, mapped or on the heap
+		Rope::buffer_ptr const file_;
+		std::size_t const offset_;
+		std::size_t const compressed_size_;
+		std::size_t const size_;
+		// what an inflation error is reported as
+		std::string const damage_;
+		mutable std::once_flag inflated_;
+		mutable std::unique_ptr<char[]> bytes_;
+	};
+
+	/**
+	 * Collects bytes into blocks and deflates every full one.
+	 */
+	class BlockWriter
+	{
+	public:
+		BlockWriter(std::vector<char> &body)
+			: body_(body)
+		{
+		}
+
+		void write(char const *bytes, std::size_t length)
+		{
+			while (length)
+			{
+				std::size_t const part = std::min(length,
+					CompressedStorage::block_size - pending_.size());
+
+				pending_.insert(pending_.end(), bytes, bytes + part);
+				bytes += part;
+				length -= part;
+
+				if (pending_.size() == CompressedStorage::block_size)
+				{
+					flush();
+				}
+			}
+		}
+
+		/**
+		 * Append a block which is already compressed.
+		 */
+		void copy(CompressedBuffer const &block)
+		{
+			flush();
+			sizes_.push_back(std::make_pair(block.size(), block.compressed_size()));
+			body_.insert(body_.end(), block.compressed(),
+			             block.compressed() + block.compressed_size());
+		}
+
+		void flush()
+		{
+			if (pending_.empty())
+			{
+				return;
+			}
+
+			std::size_t const offset = body_.size();
+			uLongf length = ::compressBound(pending_.size());
+
+			body_.resize(offset + length);
+
+			if (::compress2(reinterpret_cast<Bytef *>(body_.data() + offset), &length,
+			                reinterpret_cast<Bytef const *>(pending_.data()), pending_.size(),
+			                Z_DEFAULT_COMPRESSION) != Z_OK)
+			{
+				throw document_errors::DocumentError("unable to compress document");
+			}
+
+			body_.resize(offset + length);
+			sizes_.push_back(std::make_pair(pending_.size(), length));
+			pending_.clear();
+		}
+
+		// the inflated and compressed size of every block written
+		std::vector<std::pair<std::size_t, std::size_t>> const &sizes() const
+		{
+			return sizes_;
+		}
+
+	private:
+		std::vector<char> &body_;
+		std::vector<char> pending_;
+		std::vector<std::pair<std::size_t, std::size_t>> sizes_;
+	};
+}
+
+using namespace document_errors;
+
+std::uint32_t const CompressedStorage::version;
+std::size_t const CompressedStorage::block_size;
+
+CompressedStorage::CompressedStorage(int fd, std::string const &name, Document::OpenMode mode)
+	: IndexedStorage(fd, name, mode),
+	  compressed_(false)
+{
+}
+
+bool CompressedStorage::is_compressed(int fd)
+{
+	char magic[sizeof(g_magic)];
+
+	return ::pread(fd, magic, sizeof(magic), 0) == static_cast<ssize_t>(sizeof(magic))
+		&& std::equal(magic, magic + sizeof(magic), g_magic);
+}
+
+Rope CompressedStorage::load()
+{
+	Header header;
+	Rope contents = read_blocks(header);
+
+	if (compressed_)
+	{
+		keep_loaded(ChunkTree(header.chunks), LineIndex(header.runs));
+	}
+
+	return contents;
+}
+
+std::function<void()> CompressedStorage::prepare_save(Rope &contents)
+{
+	Rope const snapshot = contents;
+	ChunkTree const chunks = chunks_;
+	LineIndex const lines = lines_;
+
+	return [this, snapshot, chunks, lines]()
+	{
+		std::vector<char> body;
+		BlockWriter writer(body);
+
+		// untouched blocks are copied without inflating them
+		snapshot.for_each_piece(
+			[&writer](Rope::buffer_ptr const &buffer, std::size_t offset, std::size_t length)
+			{
+				auto const block = std::dynamic_pointer_cast<CompressedBuffer const>(buffer);
+
+				if (block && !offset && length == block->size())
+				{
+					writer.copy(*block);
+				}
+				else
+				{
+					writer.write(buffer->data() + offset, length);
+				}
+			});
+		writer.flush();
+
+		std::vector<Block> blocks;
+
+		for (auto const &sizes: writer.sizes())
+		{
+			Block const block = { static_cast<std::uint32_t>(sizes.first),
+			                      static_cast<std::uint32_t>(sizes.second) };
+
+			blocks.push_back(block);
+		}
+
+		std::string const temporary_name = name_ + ".tmp";
+		// without matching indexes passed in, they are built from the snapshot
+		std::vector<char> const header = chunks.size() == snapshot.size()
+			&& lines.size() == snapshot.size()
+			? encode(chunks, lines, blocks)
+			: encode(ChunkTree(snapshot), LineIndex(snapshot), blocks);
+
+		replace(write_temporary(Rope(Rope::make_buffer(std::move(body))), temporary_name,
+		                        header), temporary_name);
+		compressed_ = true;
+	};
+}
+
+void CompressedStorage::save(Rope &contents)
+{
+	DocumentStorage::save(contents);
+
+	// the document keeps its indexes, only the blocks are taken over
+	Header header;
+
+	contents = read_blocks(header);
+}
+
+int CompressedStorage::contents_file(std::size_t &offset)
+{
+	return compressed_ ? -1 : FileStorage::contents_file(offset);
+}
+
+Rope CompressedStorage::read_blocks(Header &header)
+{
+	Rope const file = read_contents(fd_, mode_);
+	std::size_t offset = decode(file, header);
+
+	compressed_ = offset != 0;
+
+	if (!compressed_)
+	{
+		return file;
+	}
+
+	// read_contents() hands out the whole file as a single buffer
+	Rope::buffer_ptr buffer;
+
+	file.for_each_piece(
+		[&buffer](Rope::buffer_ptr const &piece, std::size_t, std::size_t)
+		{
+			buffer = piece;
+		});
+
+	std::vector<Rope::buffer_ptr> blocks;
+	std::string const damage = describe_damage(name_, "damaged block");
+
+	blocks.reserve(header.blocks.size());
+
+	for (auto const &block: header.blocks)
+	{
+		blocks.push_back(std::make_shared<CompressedBuffer>(buffer, offset,
+			block.compressed_size, block.size, damage));
+		offset += block.compressed_size;
+	}
+
+	return Rope(blocks);
+}
+
+std::vector<char> CompressedStorage::encode(ChunkTree const &chunks, LineIndex const &lines,
+                                            std::vector<Block> const &blocks)
+{
+	std::vector<LineIndex::Run> const runs = lines.runs();
+	std::vector<ChunkTree::Chunk> const hashes = chunks.chunks();
+	std::vector<char> bytes(g_magic, g_magic + sizeof(g_magic));
+
+	bytes.reserve(g_fixed_size + runs.size() * g_run_size + hashes.size() * g_chunk_size
+		+ blocks.size() * g_block_size);
+	append(bytes, version, 4);
+	append(bytes, chunks.size(), 8);
+	append(bytes, runs.size(), 8);
+	append(bytes, hashes.size(), 8);
+	append(bytes, blocks.size(), 8);
+
+	for (auto const &run: runs)
+	{
+		append(bytes, run.length, 4);
+		append(bytes, run.newlines, 4);
+	}
+
+	for (auto const &chunk: hashes)
+	{
+		append(bytes, chunk.length, 4);
+		bytes.insert(bytes.end(), chunk.hash.begin(), chunk.hash.end());
+	}
+
+	for (auto const &block: blocks)
+	{
+		append(bytes, block.size, 4);
+		append(bytes, block.compressed_size, 4);
+	}
+
+	return bytes;
+}
+
+std::size_t CompressedStorage::decode(Rope const &file, Header &header) const
+{
+	if (file.size() < g_fixed_size)
+	{
+		return 0;
+	}
+
+	std::vector<char> bytes = file.read(0, g_fixed_size);
+
+	if (!std::equal(g_magic, g_magic + sizeof(g_magic), bytes.begin()))
+	{
+		return 0;
+	}
+
+	std::size_t position = sizeof(g_magic);
+
+	if (extract(bytes, position, 4) != version)
+	{
+		throw DocumentError(describe_damage(name_, "unknown compressed format version"));
+	}
+
+	std::uint64_t const size = extract(bytes, position, 8);
+	std::uint64_t const runs = extract(bytes, position, 8);
+	std::uint64_t const chunks = extract(bytes, position, 8);
+	std::uint64_t const blocks = extract(bytes, position, 8);
+	std::size_t const available = file.size() - g_fixed_size;
+
+	// check the counts before multiplying them, damaged ones could overflow
+	if (runs > available / g_run_size || chunks > available / g_chunk_size
+		|| blocks > available / g_block_size
+		|| runs * g_run_size + chunks * g_chunk_size + blocks * g_block_size > available)
+	{
+		throw DocumentError(describe_damage(name_, "compressed header doesn't match the file"));
+	}
+
+	std::size_t const offset = g_fixed_size + runs * g_run_size + chunks * g_chunk_size
+		+ blocks * g_block_size;
+	std::size_t run_total = 0;
+	std::size_t chunk_total = 0;
+	std::size_t block_total = 0;
+	std::size_t compressed_total = 0;
+
+	bytes = file.read(g_fixed_size, offset - g_fixed_size);
+	position = 0;
+	header.size = size;
+
+	for (std::uint64_t i = 0; i < runs; i++)
+	{
+		LineIndex::Run run;
+
+		run.length = extract(bytes, position, 4);
+		run.newlines = extract(bytes, position, 4);
+		run_total += run.length;
+		header.runs.push_back(run);
+	}
+
+	for (std::uint64_t i = 0; i < chunks; i++)
+	{
+		ChunkTree::Chunk chunk;
+
+		chunk.length = extract(bytes, position, 4);
+		std::copy(bytes.begin() + position, bytes.begin() + position + chunk.hash.size(),
+		          chunk.hash.begin());
+		position += chunk.hash.size();
+		chunk_total += chunk.length;
+		header.chunks.push_back(chunk);
+	}
+
+	for (std::uint64_t i = 0; i < blocks; i++)
+	{
+		Block block;
+
+		block.size = extract(bytes, position, 4);
+		block.compressed_size = extract(bytes, position, 4);
+
+		if (!block.size || block.size > block_size)
+		{
+			throw DocumentError(describe_damage(name_, "compressed block has an invalid size"));
+		}
+
+		block_total += block.size;
+		compressed_total += block.compressed_size;
+		header.blocks.push_back(block);
+	}
+
+	if (run_total != size || chunk_total != size || block_total != size)
+	{
+		throw DocumentError(describe_damage(name_, "compressed indexes don't cover the contents"));
+	}
+
+	if (offset + compressed_total != file.size())
+	{
+		throw DocumentError(describe_damage(name_, "compressed blocks don't match the file"));
+	}
+
+	return offset;
+}
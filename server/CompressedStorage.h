@@ -0,0 +1,149 @@
+#ifndef COMPRESSEDSTORAGE_H_INCLUDED
+#define COMPRESSEDSTORAGE_H_INCLUDED
+
+#include "IndexedStorage.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @file CompressedStorage.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * The compressed storage for cold documents: the contents are cut into
+ * blocks of up to block_size bytes which are deflated independently, so
+ * any region can be reached by inflating only the blocks covering it. The
+ * header persists the line index and the chunk hashes like a container, so
+ * opening, hashing and addressing lines doesn't inflate anything.
+ *
+ * Every block becomes a buffer of the contents which keeps its compressed
+ * bytes and is only inflated once one of its bytes is read, which happens
+ * for the blocks next to an edit or when a client asks for the contents.
+ * Saving copies blocks which are still whole verbatim and only deflates
+ * the edited regions again.
+ *
+ * All numbers of the header are stored big endian:
+ *
+ *   magic       8 bytes  "\x89" "CTEZIP\n"
+ *   version     4 bytes  1
+ *   size        8 bytes  the number of bytes of the contents
+ *   runs        8 bytes  the number of line index runs
+ *   chunks      8 bytes  the number of chunks
+ *   blocks      8 bytes  the number of blocks
+ *   runs times  4 bytes  the length of the run
+ *               4 bytes  the number of newlines in the run
+ *   chunks times
+ *               4 bytes  the length of the chunk
+ *              20 bytes  the SHA-1 hash of the chunk
+ *   blocks times
+ *               4 bytes  the number of bytes the block inflates to
+ *               4 bytes  the number of compressed bytes
+ *
+ * The zlib streams of the blocks follow the header in order. A plain
+ * document file opened with this storage becomes compressed with its next
+ * save.
+ */
+
+class CompressedStorage
+	: public IndexedStorage
+{
+public:
+	/**
+	 * The format version written by this storage.
+	 */
+	static std::uint32_t const version = 1;
+
+	/**
+	 * The most bytes deflated into one block.
+	 */
+	static std::size_t const block_size = 64 * 1024;
+
+	/**
+	 * Construct the storage for an opened document file, which may still
+	 * be a plain file.
+	 *
+	 * @param fd The readable descriptor of the document file, the storage
+	 *           takes ownership.
+	 * @param name The path of the document file.
+	 * @param mode How the compressed file is brought into memory, mapping
+	 *             it leaves even the compressed blocks to the page cache.
+	 */
+	CompressedStorage(int fd, std::string const &name, Document::OpenMode mode);
+
+	/**
+	 * Check if a file is compressed by looking at its magic.
+	 *
+	 * @param fd A readable descriptor of the file.
+	 */
+	static bool is_compressed(int fd);
+
+	/**
+	 * @throws DocumentError If the file is compressed with a damaged header
+	 *                       or an unknown version. Damaged blocks are only
+	 *                       noticed when they are inflated.
+	 */
+	Rope load();
+
+	/**
+	 * The job deflates the edited regions, encodes the header from the
+	 * passed indexes and writes both to a temporary file which then
+	 * replaces the document.
+	 */
+	std::function<void()> prepare_save(Rope &contents);
+
+	/**
+	 * Save and load the written file again, which drops the inflated blocks.
+	 */
+	void save(Rope &contents);
+
+	/**
+	 * A compressed file can't be sent as it is.
+	 */
+	int contents_file(std::size_t &offset);
+
+private:
+	struct Block
+	{
+		std::uint32_t size;
+		std::uint32_t compressed_size;
+	};
+
+	struct Header
+	{
+		std::size_t size;
+		std::vector<LineIndex::Run> runs;
+		std::vector<ChunkTree::Chunk> chunks;
+		std::vector<Block> blocks;
+	};
+
+	/**
+	 * Read the document file and turn its blocks into the contents.
+	 *
+	 * @param header Receives the header of a compressed file.
+	 * @return The contents, the file itself if it isn't compressed.
+	 * @throws DocumentError If the header is damaged or has an unknown version.
+	 */
+	Rope read_blocks(Header &header);
+
+	/**
+	 * Encode the header for contents described by their indexes and blocks.
+	 */
+	static std::vector<char> encode(ChunkTree const &chunks, LineIndex const &lines,
+	                                std::vector<Block> const &blocks);
+
+	/**
+	 * Decode and check the header of a compressed file.
+	 *
+	 * @param file All bytes of the file.
+	 * @param header Receives the header.
+	 * @return The offset of the first block, 0 if the file isn't compressed.
+	 * @throws DocumentError If the header is damaged or has an unknown version.
+	 */
+	std::size_t decode(Rope const &file, Header &header) const;
+
+	// the file is compressed
+	bool compressed_;
+};
+
+#endif
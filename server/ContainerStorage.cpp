@@ -0,0 +1,201 @@
+#include "ContainerStorage.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <unistd.h>
+
+/**
+ * @file ContainerStorage.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the container document storage.
+ */
+
+namespace
+{
+	// the leading non-ASCII byte keeps text files from being mistaken for containers
+	char const g_magic[8] = { '\x89', 'C', 'T', 'E', 'D', 'O', 'C', '\n' };
+
+	// magic, version, size and the two counts
+	std::size_t const g_fixed_size = sizeof(g_magic) + 4 + 3 * 8;
+	std::size_t const g_run_size = 4 + 4;
+	std::size_t const g_chunk_size = 4 + sizeof(Hash::hash_t);
+}
+
+using namespace document_errors;
+
+std::uint32_t const ContainerStorage::version;
+
+ContainerStorage::ContainerStorage(int fd, std::string const &name, Document::OpenMode mode)
+	: IndexedStorage(fd, name, mode),
+	  contents_offset_(0)
+{
+}
+
+bool ContainerStorage::is_container(int fd)
+{
+	char magic[sizeof(g_magic)];
+
+	return ::pread(fd, magic, sizeof(magic), 0) == static_cast<ssize_t>(sizeof(magic))
+		&& std::equal(magic, magic + sizeof(magic), g_magic);
+}
+
+Rope ContainerStorage::load()
+{
+	Rope contents = read_contents(fd_, mode_);
+	Header header;
+	std::size_t const offset = decode(contents, header);
+
+	if (offset)
+	{
+		keep_loaded(ChunkTree(header.chunks), LineIndex(header.runs));
+
+		// the pieces keep referring to the file, only the header is cut off
+		contents.erase(0, offset);
+		contents_offset_ = offset;
+	}
+
+	return contents;
+}
+
+std::function<void()> ContainerStorage::prepare_save(Rope &contents)
+{
+	Rope const snapshot = contents;
+	ChunkTree const chunks = chunks_;
+	LineIndex const lines = lines_;
+
+	return [this, snapshot, chunks, lines]()
+	{
+		std::string const temporary_name = name_ + ".tmp";
+		// without matching indexes passed in, they are built from the snapshot
+		std::vector<char> const header = chunks.size() == snapshot.size()
+			&& lines.size() == snapshot.size()
+			? encode(chunks, lines)
+			: encode(ChunkTree(snapshot), LineIndex(snapshot));
+
+		replace(write_temporary(snapshot, temporary_name, header), temporary_name);
+		contents_offset_ = header.size();
+	};
+}
+
+void ContainerStorage::save(Rope &contents)
+{
+	DocumentStorage::save(contents);
+
+	// drop the copies of modified regions and map the saved file instead
+	if (mode_ == Document::OpenMode::mapped)
+	{
+		Header header;
+
+		contents = read_contents(fd_, mode_);
+		contents.erase(0, decode(contents, header));
+	}
+}
+
+int ContainerStorage::contents_file(std::size_t &offset)
+{
+	int const fd = FileStorage::contents_file(offset);
+
+	offset = contents_offset_;
+
+	return fd;
+}
+
+std::vector<char> ContainerStorage::encode(ChunkTree const &chunks, LineIndex const &lines)
+{
+	std::vector<LineIndex::Run> const runs = lines.runs();
+	std::vector<ChunkTree::Chunk> const hashes = chunks.chunks();
+	std::vector<char> bytes(g_magic, g_magic + sizeof(g_magic));
+
+	bytes.reserve(g_fixed_size + runs.size() * g_run_size + hashes.size() * g_chunk_size);
+	append(bytes, version, 4);
+	append(bytes, chunks.size(), 8);
+	append(bytes, runs.size(), 8);
+	append(bytes, hashes.size(), 8);
+
+	for (auto const &run: runs)
+	{
+		append(bytes, run.length, 4);
+		append(bytes, run.newlines, 4);
+	}
+
+	for (auto const &chunk: hashes)
+	{
+		append(bytes, chunk.length, 4);
+		bytes.insert(bytes.end(), chunk.hash.begin(), chunk.hash.end());
+	}
+
+	return bytes;
+}
+
+std::size_t ContainerStorage::decode(Rope const &file, Header &header) const
+{
+	if (file.size() < g_fixed_size)
+	{
+		return 0;
+	}
+
+	std::vector<char> bytes = file.read(0, g_fixed_size);
+
+	if (!std::equal(g_magic, g_magic + sizeof(g_magic), bytes.begin()))
+	{
+		return 0;
+	}
+
+	std::size_t position = sizeof(g_magic);
+
+	if (extract(bytes, position, 4) != version)
+	{
+		throw DocumentError(describe_damage(name_, "unknown container version"));
+	}
+
+	std::uint64_t const size = extract(bytes, position, 8);
+	std::uint64_t const runs = extract(bytes, position, 8);
+	std::uint64_t const chunks = extract(bytes, position, 8);
+	std::size_t const available = file.size() - g_fixed_size;
+
+	// check the counts before multiplying them, damaged ones could overflow
+	if (runs > available / g_run_size || chunks > available / g_chunk_size
+		|| runs * g_run_size + chunks * g_chunk_size + size != available)
+	{
+		throw DocumentError(describe_damage(name_, "container header doesn't match the file"));
+	}
+
+	std::size_t const offset = g_fixed_size + runs * g_run_size + chunks * g_chunk_size;
+	std::size_t run_total = 0;
+	std::size_t chunk_total = 0;
+
+	bytes = file.read(g_fixed_size, offset - g_fixed_size);
+	position = 0;
+	header.size = size;
+
+	for (std::uint64_t i = 0; i < runs; i++)
+	{
+		LineIndex::Run run;
+
+		run.length = extract(bytes, position, 4);
+		run.newlines = extract(bytes, position, 4);
+		run_total += run.length;
+		header.runs.push_back(run);
+	}
+
+	for (std::uint64_t i = 0; i < chunks; i++)
+	{
+		ChunkTree::Chunk chunk;
+
+		chunk.length = extract(bytes, position, 4);
+		std::copy(bytes.begin() + position, bytes.begin() + position + chunk.hash.size(),
+		          chunk.hash.begin());
+		position += chunk.hash.size();
+		chunk_total += chunk.length;
+		header.chunks.push_back(chunk);
+	}
+
+	if (run_total != size || chunk_total != size)
+	{
+		throw DocumentError(describe_damage(name_, "container indexes don't cover the contents"));
+	}
+
+	return offset;
+}
@@ -0,0 +1,110 @@
+#ifndef CONTAINERSTORAGE_H_INCLUDED
+#define CONTAINERSTORAGE_H_INCLUDED
+
+#include "IndexedStorage.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @file ContainerStorage.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * The container storage: the document file holds a header in front of the
+ * contents which persists the line index and the chunk hashes, so they are
+ * available right after opening without scanning the contents. Every save
+ * rewrites the whole file like the plain storage.
+ *
+ * All numbers of the header are stored big endian:
+ *
+ *   magic       8 bytes  "\x89" "CTEDOC\n"
+ *   version     4 bytes  1
+ *   size        8 bytes  the number of bytes of the contents
+ *   runs        8 bytes  the number of line index runs
+ *   chunks      8 bytes  the number of chunks
+ *   runs times  4 bytes  the length of the run
+ *               4 bytes  the number of newlines in the run
+ *   chunks times
+ *               4 bytes  the length of the chunk
+ *              20 bytes  the SHA-1 hash of the chunk
+ *
+ * The contents follow the header unchanged. A plain document file opened
+ * with this storage becomes a container with its next save.
+ */
+
+class ContainerStorage
+	: public IndexedStorage
+{
+public:
+	/**
+	 * The format version written by this storage.
+	 */
+	static std::uint32_t const version = 1;
+
+	/**
+	 * Construct the storage for an opened document file, which may still
+	 * be a plain file.
+	 *
+	 * @param fd The readable descriptor of the document file, the storage
+	 *           takes ownership.
+	 * @param name The path of the document file.
+	 * @param mode How the contents are brought into memory.
+	 */
+	ContainerStorage(int fd, std::string const &name, Document::OpenMode mode);
+
+	/**
+	 * Check if a file is a container by looking at its magic.
+	 *
+	 * @param fd A readable descriptor of the file.
+	 */
+	static bool is_container(int fd);
+
+	/**
+	 * @throws DocumentError If the file is a container with a damaged header
+	 *                       or an unknown version.
+	 */
+	Rope load();
+
+	/**
+	 * The job encodes the header from the passed indexes and writes it
+	 * together with the contents to a temporary file which then replaces
+	 * the document.
+	 */
+	std::function<void()> prepare_save(Rope &contents);
+
+	/**
+	 * Save and map the contents of the written file instead of the previous one.
+	 */
+	void save(Rope &contents);
+
+	int contents_file(std::size_t &offset);
+
+private:
+	struct Header
+	{
+		std::size_t size;
+		std::vector<LineIndex::Run> runs;
+		std::vector<ChunkTree::Chunk> chunks;
+	};
+
+	/**
+	 * Encode the header for contents described by their indexes.
+	 */
+	static std::vector<char> encode(ChunkTree const &chunks, LineIndex const &lines);
+
+	/**
+	 * Decode and check the header of a container file.
+	 *
+	 * @param file All bytes of the file.
+	 * @param header Receives the header.
+	 * @return The offset of the contents, 0 if the file isn't a container.
+	 * @throws DocumentError If the header is damaged or has an unknown version.
+	 */
+	std::size_t decode(Rope const &file, Header &header) const;
+
+	// the offset of the contents in the document file
+	std::size_t contents_offset_;
+};
+
+#endif
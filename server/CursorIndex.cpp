@@ -0,0 +1,292 @@
+#include "CursorIndex.h"
+
+#include <sstream>
+#include <stdexcept>
+
+/**
+ * @file CursorIndex.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the cursors of a document.
+ */
+
+namespace
+{
+	// the finalizer of splitmix64, good enough to scatter treap priorities
+	std::uint64_t mix(std::uint64_t value)
+	{
+		value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+
+		return value ^ (value >> 31);
+	}
+}
+
+/**
+ * The offset of a node is exact once the shifts pending in all of its
+ * ancestors are added, its own pending shift still has to be added to the
+ * offsets of its descendants.
+ */
+struct CursorIndex::Node
+{
+	id_type id;
+	std::size_t offset;
+	std::int64_t pending;
+	std::uint64_t priority;
+	node_ptr left;
+	node_ptr right;
+	Node *parent;
+};
+
+CursorIndex::CursorIndex()
+	: next_seed_(0)
+{
+}
+
+CursorIndex::CursorIndex(CursorIndex &&other) = default;
+CursorIndex &CursorIndex::operator=(CursorIndex &&other) = default;
+
+CursorIndex::~CursorIndex()
+{
+}
+
+void CursorIndex::set(id_type id, std::size_t offset)
+{
+	remove(id);
+
+	node_ptr node(new Node);
+
+	node->id = id;
+	node->offset = offset;
+	node->pending = 0;
+	node->priority = mix(++next_seed_);
+	node->parent = 0;
+	nodes_[id] = node.get();
+
+	auto parts = split(std::move(root_), offset, true);
+
+	root_ = merge(merge(std::move(parts.first), std::move(node)), std::move(parts.second));
+}
+
+void CursorIndex::remove(id_type id)
+{
+	auto const found = nodes_.find(id);
+
+	if (found == nodes_.end())
+	{
+		return;
+	}
+
+	Node *const node = found->second;
+	Node *const parent = node->parent;
+
+	// the children take the place of the node, without its pending shift
+	push(node);
+
+	node_ptr merged = merge(std::move(node->left), std::move(node->right));
+
+	if (merged)
+	{
+		merged->parent = parent;
+	}
+
+	nodes_.erase(found);
+
+	if (!parent)
+	{
+		root_ = std::move(merged);
+	}
+	else if (parent->left.get() == node)
+	{
+		parent->left = std::move(merged);
+	}
+	else
+	{
+		parent->right = std::move(merged);
+	}
+}
+
+std::size_t CursorIndex::offset_of(id_type id) const
+{
+	auto const found = nodes_.find(id);
+
+	if (found == nodes_.end())
+	{
+		std::ostringstream strm;
+
+		strm << "no cursor with the id " << id;
+
+		throw std::out_of_range(strm.str());
+	}
+
+	std::size_t offset = found->second->offset;
+
+	for (Node const *ancestor = found->second->parent; ancestor; ancestor = ancestor->parent)
+	{
+		offset += ancestor->pending;
+	}
+
+	return offset;
+}
+
+void CursorIndex::apply(std::size_t offset, std::size_t erased, std::size_t inserted)
+{
+	if (!root_ || (!erased && !inserted))
+	{
+		return;
+	}
+
+	auto head = split(std::move(root_), offset, true);
+	auto tail = split(std::move(head.second), offset + erased, false);
+
+	// the cursors within the erased bytes are the only ones visited
+	place(tail.first.get(), offset);
+
+	if (tail.second)
+	{
+		std::int64_t const shift = static_cast<std::int64_t>(inserted)
+			- static_cast<std::int64_t>(erased);
+
+		tail.second->offset += shift;
+		tail.second->pending += shift;
+	}
+
+	root_ = merge(merge(std::move(head.first), std::move(tail.first)), std::move(tail.second));
+}
+
+std::vector<CursorIndex::Cursor> CursorIndex::in_range(std::size_t begin,
+                                                        std::size_t end) const
+{
+	std::vector<Cursor> cursors;
+
+	collect(root_.get(), 0, begin, end, cursors);
+
+	return cursors;
+}
+
+void CursorIndex::push(Node *node)
+{
+	if (!node->pending)
+	{
+		return;
+	}
+
+	for (Node *child: { node->left.get(), node->right.get() })
+	{
+		if (child)
+		{
+			child->offset += node->pending;
+			child->pending += node->pending;
+		}
+	}
+
+	node->pending = 0;
+}
+
+std::pair<CursorIndex::node_ptr, CursorIndex::node_ptr> CursorIndex::split(node_ptr node,
+	std::size_t offset, bool inclusive)
+{
+	if (!node)
+	{
+		return std::pair<node_ptr, node_ptr>();
+	}
+
+	push(node.get());
+	node->parent = 0;
+
+	if (inclusive ? node->offset <= offset : node->offset < offset)
+	{
+		auto parts = split(std::move(node->right), offset, inclusive);
+
+		node->right = std::move(parts.first);
+
+		if (node->right)
+		{
+			node->right->parent = node.get();
+		}
+
+		return std::make_pair(std::move(node), std::move(parts.second));
+	}
+
+	auto parts = split(std::move(node->left), offset, inclusive);
+
+	node->left = std::move(parts.second);
+
+	if (node->left)
+	{
+		node->left->parent = node.get();
+	}
+
+	return std::make_pair(std::move(parts.first), std::move(node));
+}
+
+CursorIndex::node_ptr CursorIndex::merge(node_ptr left, node_ptr right)
+{
+	if (!left)
+	{
+		return right;
+	}
+
+	if (!right)
+	{
+		return left;
+	}
+
+	if (left->priority > right->priority)
+	{
+		push(left.get());
+		left->right = merge(std::move(left->right), std::move(right));
+		left->right->parent = left.get();
+
+		return left;
+	}
+
+	push(right.get());
+	right->left = merge(std::move(left), std::move(right->left));
+	right->left->parent = right.get();
+
+	return right;
+}
+
+void CursorIndex::place(Node *node, std::size_t offset)
+{
+	if (!node)
+	{
+		return;
+	}
+
+	node->offset = offset;
+	node->pending = 0;
+	place(node->left.get(), offset);
+	place(node->right.get(), offset);
+}
+
+void CursorIndex::collect(Node const *node, std::int64_t shift, std::size_t begin,
+                          std::size_t end, std::vector<Cursor> &cursors)
+{
+	if (!node)
+	{
+		return;
+	}
+
+	std::size_t const offset = node->offset + shift;
+	std::int64_t const below = shift + node->pending;
+
+	// the left subtree lies at or in front of the node, the right one at or behind it
+	if (offset >= begin)
+	{
+		collect(node->left.get(), below, begin, end, cursors);
+	}
+
+	if (offset >= begin && offset < end)
+	{
+		Cursor const cursor = { node->id, offset };
+
+		cursors.push_back(cursor);
+	}
+
+	if (offset < end)
+	{
+		collect(node->right.get(), below, begin, end, cursors);
+	}
+}
@@ -0,0 +1,147 @@
+#ifndef CURSORINDEX_H_INCLUDED
+#define CURSORINDEX_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @file CursorIndex.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * The cursors of the clients working on a document, ordered by their
+ * offset.
+ *
+ * The cursors are kept in a treap whose nodes carry a pending shift for
+ * their subtrees, so following an edit shifts all cursors behind it by
+ * tagging a single subtree in O(log n). Only the cursors within erased
+ * bytes are visited, they all move to the offset of the edit. Cursors
+ * follow edits like the positions of a Viewport do: cursors up to the
+ * offset of an insertion stay where they are.
+ *
+ * Looking a cursor up by its id walks from its node up to the root, adding
+ * the shifts still pending on the way, listing the cursors in a range
+ * costs O(log n + k) for k cursors.
+ */
+
+class CursorIndex
+{
+public:
+	typedef int id_type;
+
+	/**
+	 * A cursor and where it is.
+	 */
+	struct Cursor
+	{
+		id_type id;
+		std::size_t offset;
+	};
+
+	/**
+	 * Construct an index without cursors.
+	 */
+	CursorIndex();
+
+	CursorIndex(CursorIndex &&other);
+	CursorIndex &operator=(CursorIndex &&other);
+
+	~CursorIndex();
+
+	/**
+	 * Obtain the number of cursors.
+	 */
+	std::size_t size() const
+	{
+		return nodes_.size();
+	}
+
+	/**
+	 * Check if there is a cursor with an id.
+	 */
+	bool contains(id_type id) const
+	{
+		return nodes_.count(id) != 0;
+	}
+
+	/**
+	 * Place a cursor, moving it if it exists.
+	 *
+	 * @param id The id of the cursor.
+	 * @param offset The offset to place it at.
+	 */
+	void set(id_type id, std::size_t offset);
+
+	/**
+	 * Remove a cursor, unknown ids are ignored.
+	 *
+	 * @param id The id of the cursor.
+	 */
+	void remove(id_type id);
+
+	/**
+	 * Obtain the offset of a cursor.
+	 *
+	 * @param id The id of the cursor.
+	 * @return The offset.
+	 * @throws std::out_of_range If there is no such cursor.
+	 */
+	std::size_t offset_of(id_type id) const;
+
+	/**
+	 * Let all cursors follow an edit.
+	 *
+	 * @param offset The offset of the edit.
+	 * @param erased The number of bytes erased at the offset.
+	 * @param inserted The number of bytes inserted at the offset afterwards.
+	 */
+	void apply(std::size_t offset, std::size_t erased, std::size_t inserted);
+
+	/**
+	 * List the cursors within a range.
+	 *
+	 * @param begin The first offset of the range.
+	 * @param end The offset behind the range.
+	 * @return The cursors with begin <= offset < end, ordered by offset.
+	 */
+	std::vector<Cursor> in_range(std::size_t begin, std::size_t end) const;
+
+private:
+	struct Node;
+	typedef std::unique_ptr<Node> node_ptr;
+
+	/**
+	 * Hand the pending shift of a node down to its children.
+	 */
+	static void push(Node *node);
+
+	/**
+	 * Split a tree into the cursors in front of an offset and the others.
+	 *
+	 * @param inclusive Whether cursors at the offset go to the front.
+	 */
+	static std::pair<node_ptr, node_ptr> split(node_ptr node, std::size_t offset,
+	                                           bool inclusive);
+
+	/**
+	 * Merge two trees, all cursors of the left one lie in front of the right one.
+	 */
+	static node_ptr merge(node_ptr left, node_ptr right);
+
+	/**
+	 * Move all cursors of a tree to an offset.
+	 */
+	static void place(Node *node, std::size_t offset);
+
+	static void collect(Node const *node, std::int64_t shift, std::size_t begin,
+	                    std::size_t end, std::vector<Cursor> &cursors);
+
+	node_ptr root_;
+	std::unordered_map<id_type, Node *> nodes_;
+	std::uint64_t next_seed_;
+};
+
+#endif
@@ -0,0 +1,270 @@
+#include "DeltaSync.h"
+
+#include <arpa/inet.h>
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+/**
+ * @file DeltaSync.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the delta resynchronisation.
+ */
+
+namespace
+{
+	char const g_copy_operation = 'C';
+	char const g_literal_operation = 'L';
+
+	struct HashHasher
+	{
+		std::size_t operator()(Hash::hash_t const &hash) const
+		{
+			std::size_t value;
+
+			// the hash is uniformly distributed already
+			std::memcpy(&value, hash.data(), sizeof(value));
+
+			return value;
+		}
+	};
+
+	void append_uint32(std::vector<char> &dest, std::size_t value)
+	{
+		std::uint32_t const network_value = htonl(static_cast<std::uint32_t>(value));
+		char const *bytes = reinterpret_cast<char const *>(&network_value);
+
+		dest.insert(dest.end(), bytes, bytes + sizeof(network_value));
+	}
+
+	std::size_t read_uint32(char const *source, std::size_t size, std::size_t &position)
+	{
+		std::uint32_t network_value;
+
+		if (size - position < sizeof(network_value))
+		{
+			throw deltasync_errors::InvalidDeltaError("truncated delta");
+		}
+
+		std::memcpy(&network_value, source + position, sizeof(network_value));
+		position += sizeof(network_value);
+
+		return ntohl(network_value);
+	}
+
+	/**
+	 * Collects operations and joins adjacent ones of the same kind.
+	 */
+	class DeltaWriter
+	{
+	public:
+		DeltaWriter(Rope const &contents)
+			: contents_(contents),
+			  copy_offset_(0),
+			  copy_length_(0),
+			  literal_offset_(0),
+			  literal_length_(0)
+		{
+		}
+
+		void copy(std::size_t offset, std::size_t length)
+		{
+			flush_literal();
+
+			if (copy_length_ && copy_offset_ + copy_length_ == offset)
+			{
+				copy_length_ += length;
+				return;
+			}
+
+			flush_copy();
+			copy_offset_ = offset;
+			copy_length_ = length;
+		}
+
+		void literal(std::size_t offset, std::size_t length)
+		{
+			flush_copy();
+
+			if (!literal_length_)
+			{
+				literal_offset_ = offset;
+			}
+
+			literal_length_ += length;
+		}
+
+		std::vector<char> finish()
+		{
+			flush_copy();
+			flush_literal();
+
+			return std::move(delta_);
+		}
+
+	private:
+		void flush_copy()
+		{
+			if (copy_length_)
+			{
+				delta_.push_back(g_copy_operation);
+				append_uint32(delta_, copy_offset_);
+				append_uint32(delta_, copy_length_);
+				copy_length_ = 0;
+			}
+		}
+
+		void flush_literal()
+		{
+			if (literal_length_)
+			{
+				std::vector<char> &delta = delta_;
+
+				delta.push_back(g_literal_operation);
+				append_uint32(delta, literal_length_);
+				contents_.for_each_span(literal_offset_, literal_length_,
+					[&delta](char const *bytes, std::size_t length)
+					{
+						delta.insert(delta.end(), bytes, bytes + length);
+					});
+				literal_length_ = 0;
+			}
+		}
+
+		Rope const &contents_;
+		std::vector<char> delta_;
+		std::size_t copy_offset_;
+		std::size_t copy_length_;
+		std::size_t literal_offset_;
+		std::size_t literal_length_;
+	};
+}
+
+namespace deltasync_errors
+{
+	InvalidDeltaError::InvalidDeltaError(std::string const &message)
+		: std::runtime_error(message)
+	{
+	}
+}
+
+using namespace deltasync_errors;
+
+std::size_t const DeltaSync::signature_size;
+
+std::vector<char> DeltaSync::encode_signatures(std::vector<ChunkTree::Chunk> const &chunks)
+{
+	std::vector<char> bytes;
+
+	bytes.reserve(chunks.size() * signature_size);
+
+	for (auto const &chunk: chunks)
+	{
+		append_uint32(bytes, chunk.length);
+		bytes.insert(bytes.end(), chunk.hash.begin(), chunk.hash.end());
+	}
+
+	return bytes;
+}
+
+std::vector<ChunkTree::Chunk> DeltaSync::decode_signatures(char const *bytes,
+                                                            std::size_t size)
+{
+	if (size % signature_size)
+	{
+		throw InvalidDeltaError("signatures have an invalid length");
+	}
+
+	std::vector<ChunkTree::Chunk> chunks(size / signature_size);
+	std::size_t position = 0;
+
+	for (auto &chunk: chunks)
+	{
+		chunk.length = read_uint32(bytes, size, position);
+		std::copy(bytes + position, bytes + position + chunk.hash.size(), chunk.hash.begin());
+		position += chunk.hash.size();
+	}
+
+	return chunks;
+}
+
+std::vector<char> DeltaSync::make_delta(Rope const &contents, ChunkTree const &chunks,
+                                        std::vector<ChunkTree::Chunk> const &signatures)
+{
+	// where each chunk of the outdated copy starts
+	std::unordered_map<Hash::hash_t, std::size_t, HashHasher> known;
+	std::size_t offset = 0;
+
+	for (auto const &signature: signatures)
+	{
+		known.insert(std::make_pair(signature.hash, offset));
+		offset += signature.length;
+	}
+
+	DeltaWriter writer(contents);
+
+	offset = 0;
+
+	for (auto const &chunk: chunks.chunks())
+	{
+		auto const match = known.find(chunk.hash);
+
+		if (match != known.end())
+		{
+			writer.copy(match->second, chunk.length);
+		}
+		else
+		{
+			writer.literal(offset, chunk.length);
+		}
+
+		offset += chunk.length;
+	}
+
+	return writer.finish();
+}
+
+std::vector<char> DeltaSync::apply_delta(std::vector<char> const &outdated,
+                                         std::vector<char> const &delta)
+{
+	std::vector<char> contents;
+	std::size_t position = 0;
+
+	while (position < delta.size())
+	{
+		char const operation = delta[position++];
+		std::size_t const first = read_uint32(delta.data(), delta.size(), position);
+
+		if (operation == g_copy_operation)
+		{
+			std::size_t const length = read_uint32(delta.data(), delta.size(), position);
+
+			if (first > outdated.size() || length > outdated.size() - first)
+			{
+				throw InvalidDeltaError("copy exceeds the outdated copy");
+			}
+
+			contents.insert(contents.end(), outdated.begin() + first,
+				outdated.begin() + first + length);
+		}
+		else if (operation == g_literal_operation)
+		{
+			if (first > delta.size() - position)
+			{
+				throw InvalidDeltaError("truncated literal");
+			}
+
+			contents.insert(contents.end(), delta.begin() + position,
+				delta.begin() + position + first);
+			position += first;
+		}
+		else
+		{
+			throw InvalidDeltaError("unknown operation");
+		}
+	}
+
+	return contents;
+}
@@ -0,0 +1,93 @@
+#ifndef DELTASYNC_H_INCLUDED
+#define DELTASYNC_H_INCLUDED
+
+#include "ChunkTree.h"
+#include "Hash.h"
+#include "Rope.h"
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * @file DeltaSync.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Resynchronisation of an outdated copy of a document by sending only the
+ * ranges which differ.
+ *
+ * The holder of the outdated copy cuts it into chunks (see Chunker.h) and
+ * sends their signatures, each consisting of the length (4 bytes, network
+ * byte order) and the hash (20 bytes) of the chunk. The holder of the
+ * current contents answers with a delta, a sequence of operations which
+ * rebuild the current contents:
+ *
+ *   'C' offset length   copy a range of the outdated copy
+ *   'L' length bytes    insert literal bytes
+ *
+ * where offset and length are 4 bytes in network byte order.
+ */
+
+namespace deltasync_errors
+{
+	struct InvalidDeltaError
+		: std::runtime_error
+	{
+		InvalidDeltaError(std::string const &message);
+	};
+}
+
+class DeltaSync
+{
+public:
+	static std::size_t const signature_size = 4 + sizeof(Hash::hash_t);
+
+	/**
+	 * Encode the signatures of chunks.
+	 *
+	 * @param chunks The chunks of the outdated copy in order.
+	 * @return The encoded signatures.
+	 */
+	static std::vector<char> encode_signatures(std::vector<ChunkTree::Chunk> const &chunks);
+
+	/**
+	 * Decode received signatures.
+	 *
+	 * @param bytes The first byte of the encoded signatures.
+	 * @param size The number of bytes.
+	 * @return The chunks of the outdated copy in order.
+	 * @throws deltasync_errors::InvalidDeltaError If the bytes are no signatures.
+	 */
+	static std::vector<ChunkTree::Chunk> decode_signatures(char const *bytes, std::size_t size);
+
+	static std::vector<ChunkTree::Chunk> decode_signatures(std::vector<char> const &bytes)
+	{
+		return decode_signatures(bytes.data(), bytes.size());
+	}
+
+	/**
+	 * Create the delta which turns the outdated copy into the contents.
+	 *
+	 * @param contents The current contents.
+	 * @param chunks The chunk tree of the current contents.
+	 * @param signatures The chunks of the outdated copy.
+	 * @return The encoded delta.
+	 */
+	static std::vector<char> make_delta(Rope const &contents, ChunkTree const &chunks,
+	                                    std::vector<ChunkTree::Chunk> const &signatures);
+
+	/**
+	 * Apply a delta to an outdated copy.
+	 *
+	 * @param outdated The outdated copy.
+	 * @param delta The encoded delta.
+	 * @return The current contents.
+	 * @throws deltasync_errors::InvalidDeltaError If the delta is malformed or
+	 *                                             doesn't fit the copy.
+	 */
+	static std::vector<char> apply_delta(std::vector<char> const &outdated,
+	                                     std::vector<char> const &delta);
+};
+
+#endif
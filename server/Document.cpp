@@ -1,11 +1,21 @@
 #include "Document.h"
-
-#include <cassert>
+#include "ChunkStorage.h"
+#include "CompressedStorage.h"
+#include "ContainerStorage.h"
+#include "DocumentLayout.h"
+#include "FileStorage.h"
+#include "InPlaceStorage.h"
+#include "JournalStorage.h"
+
+#include <atomic>
 #include <cerrno>
+#include <cstring>
+#include <limits>
 #include <sstream>
 
-#include <dirent.h>
 #include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -21,7 +31,116 @@ std::string const Document::directory_ = "./documents/";
 
 namespace
 {
-	std::int32_t g_current_global_document_id = 1;
+	std::atomic<std::int32_t> g_current_global_document_id(1);
+
+	/**
+	 * Hand out the next document id, safe to call from any thread. Once the
+	 * maximum id is reached, it starts at 1 again.
+	 */
+	std::int32_t next_document_id()
+	{
+		std::int32_t id = g_current_global_document_id;
+		std::int32_t next;
+
+		do
+		{
+			next = id == std::numeric_limits<std::int32_t>::max() ? 1 : id + 1;
+		}
+		while (!g_current_global_document_id.compare_exchange_weak(id, next));
+
+		return id;
+	}
+
+	/**
+	 * Copy a whole file into an empty one without passing the bytes through
+	 * user space.
+	 *
+	 * @return False if the filesystems can't do that, the target may hold
+	 *         a part of the file then.
+	 */
+	bool copy_file(int from, int to)
+	{
+		// a reflink shares the extents of the source, constant time on disk
+		if (::ioctl(to, FICLONE, from) == 0)
+		{
+			return true;
+		}
+
+		struct ::stat status;
+
+		if (::fstat(from, &status))
+		{
+			return false;
+		}
+
+		loff_t in = 0;
+		loff_t out = 0;
+		std::size_t remaining = status.st_size;
+
+		while (remaining)
+		{
+			ssize_t const copied = ::copy_file_range(from, &in, to, &out, remaining, 0);
+
+			if (copied < 0 && errno == EINTR)
+			{
+				continue;
+			}
+
+			// unsupported across these filesystems, or the source shrank
+			if (copied <= 0)
+			{
+				return false;
+			}
+
+			remaining -= copied;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Replace the contents of a file by the bytes of a rope.
+	 */
+	void write_contents(int fd, Rope const &contents, std::string const &name)
+	{
+		if (::ftruncate(fd, 0))
+		{
+			throw document_errors::DocumentError("while cloning document <" + name + ">: "
+				+ std::strerror(errno));
+		}
+
+		off_t offset = 0;
+
+		contents.for_each_span(
+			[fd, &offset, &name](char const *bytes, std::size_t size)
+			{
+				while (size)
+				{
+					ssize_t const written = ::pwrite(fd, bytes, size, offset);
+
+					if (written < 0 && errno == EINTR)
+					{
+						continue;
+					}
+
+					if (written < 0)
+					{
+						throw document_errors::DocumentError("while cloning document <" + name
+							+ ">: " + std::strerror(errno));
+					}
+
+					bytes += written;
+					size -= written;
+					offset += written;
+				}
+			});
+	}
+
+	bool ends_with(std::string const &name, std::string const &suffix)
+	{
+		return name.size() >= suffix.size()
+			&& name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
 }
 
 namespace document_errors
@@ -45,13 +164,41 @@ namespace document_errors
 		: DocumentError(message)
 	{
 	}
+
+	DocumentNameError::DocumentNameError(std::string const &message)
+		: DocumentError(message)
+	{
+	}
 }
 
 using namespace document_errors;
 
+Document::Version::Version(std::uint64_t number, Rope const &contents, ChunkTree const *chunks)
+	: number_(number),
+	  contents_(contents),
+	  chunks_(chunks ? *chunks : ChunkTree()),
+	  chunks_valid_(chunks != 0)
+{
+}
+
+Hash::hash_t Document::Version::hash() const
+{
+	return chunks_valid_ ? chunks_.root() : ChunkTree(contents_).root();
+}
+
 Document::Document(Document &&other)
 	: contents_(std::move(other.contents_)),
-	  fd_(other.fd_),
+	  chunks_(std::move(other.chunks_)),
+	  chunks_valid_(other.chunks_valid_),
+	  lines_(std::move(other.lines_)),
+	  lines_valid_(other.lines_valid_),
+	  storage_(std::move(other.storage_)),
+	  last_save_(std::move(other.last_save_)),
+	  version_(other.version_),
+	  stored_version_(std::move(other.stored_version_)),
+	  current_(std::atomic_load(&other.current_)),
+	  history_(std::move(other.history_)),
+	  cursors_(std::move(other.cursors_)),
 	  name_(std::move(other.name_)),
 	  id_(other.id_),
 	  document_closed_(other.document_closed_)
@@ -65,10 +212,65 @@ Document::~Document()
 	close();
 }
 
-Document Document::create(std::string const &name, bool overwrite)
+Document Document::create(std::string const &name, bool overwrite, StorageMode storage)
+{
+	return create(name, next_document_id(), overwrite, storage);
+}
+
+Document Document::create(std::string const &name, std::int32_t id, bool overwrite,
+                          StorageMode storage)
+{
+	return Document(make_storage(create_file(name, overwrite), name, OpenMode::read, storage),
+	                name, id);
+}
+
+Document Document::clone(Document const &source, std::string const &name, bool overwrite,
+                         StorageMode storage)
+{
+	return clone(source, name, next_document_id(), overwrite, storage);
+}
+
+Document Document::clone(Document const &source, std::string const &name, std::int32_t id,
+                         bool overwrite, StorageMode storage)
+{
+	int const fd = create_file(name, overwrite);
+
+	try
+	{
+		std::size_t offset;
+		int const source_fd = source.get_contents_file(offset);
+
+		// the whole file is copied, a container keeps its header
+		if (source_fd < 0 || !copy_file(source_fd, fd))
+		{
+			write_contents(fd, source.pin()->get_contents(), name);
+		}
+	}
+	catch (...)
+	{
+		::close(fd);
+		::unlink(name.c_str());
+		throw;
+	}
+
+	// mapping the copy only sets up page tables, the contents come from the source
+	Document copy(make_storage(fd, name, OpenMode::mapped, storage), name, id);
+
+	copy.contents_ = source.contents_;
+	copy.chunks_ = source.chunks_;
+	copy.chunks_valid_ = source.chunks_valid_;
+	copy.lines_ = source.lines_;
+	copy.lines_valid_ = source.lines_valid_;
+	copy.history_ = DocumentHistory(copy.contents_, copy.version_);
+	copy.publish();
+
+	return copy;
+}
+
+int Document::create_file(std::string const &name, bool overwrite)
 {
 	// using Linux API here because of error checking functionality
-	int flags = O_CREAT | O_WRONLY | O_TRUNC;
+	int flags = O_CREAT | O_RDWR | O_TRUNC;
 
 	if (!overwrite)
 	{
@@ -102,48 +304,30 @@ Document Document::create(std::string const &name, bool overwrite)
 		throw DocumentError(strm.str());
 	}
 
-	Document doc(fd, name, g_current_global_document_id);
+	// a journal left behind by a previous document doesn't apply anymore
+	::unlink(JournalStorage::journal_name(name).c_str());
 
-	if (g_current_global_document_id == std::numeric_limits<std::int32_t>::max())
-	{
-		g_current_global_document_id = 1;
-	}
-	else
-	{
-		g_current_global_document_id++;
-	}
+	return fd;
+}
 
-	return doc;
+Document Document::open(std::string const &name, OpenMode mode, StorageMode storage)
+{
+	return open(name, next_document_id(), mode, storage);
 }
 
-Document Document::open(std::string const &name)
+Document Document::open(std::string const &name, std::int32_t id, OpenMode mode,
+                        StorageMode storage)
 {
 	int const fd = open_readable(name);
 
-	Document doc(fd, name, g_current_global_document_id);
-
-	if (g_current_global_document_id == std::numeric_limits<std::int32_t>::max())
-	{
-		g_current_global_document_id = 1;
-	}
-	else
-	{
-		g_current_global_document_id++;
-	}
-
-	return doc;
+	return Document(make_storage(fd, name, mode, storage), name, id);
 }
 
 bool Document::is_empty(std::string const &name)
 {
-	int const fd = open_readable(name);
-
-	off_t const end = ::lseek(fd, 0, SEEK_END);
-
-	// should never fail
-	assert(end != static_cast<off_t>(-1));
-
-	return end == 0;
+	// the journal may hold contents the document file doesn't have yet
+	return make_storage(open_readable(name), name, OpenMode::mapped,
+	                    StorageMode::rewrite)->load().empty();
 }
 
 int Document::open_readable(std::string const &name)
@@ -181,158 +365,280 @@ int Document::open_readable(std::string const &name)
 
 void Document::remove()
 {
-	int const result = ::unlink(name_.c_str());
+	wait_for_saves();
+	storage_->remove();
+}
 
-	if (result)
-	{
-		std::ostringstream strm;
+void Document::save()
+{
+	wait_for_saves();
+	store_indexes();
+	storage_->save(contents_);
+	*stored_version_ = version_;
 
-		strm << "while removing document <" << name_ << ">: ";
+	// the storage may have replaced the contents by an equal rope
+	publish();
+}
 
-		if (errno == ENOENT)
-		{
-			strm << "document does not exist";
+void Document::save(SaveQueue &queue, SaveQueue::Completion completion)
+{
+	store_indexes();
 
-			throw DocumentDoesntExistError(strm.str());
-		}
+	std::function<void()> const job = storage_->prepare_save(contents_);
+	std::shared_ptr<std::atomic<std::uint64_t>> const stored_version = stored_version_;
+	std::uint64_t const version = version_;
 
-		if (errno == EACCES || errno == EROFS)
+	publish();
+	last_save_ = queue.enqueue(
+		[job, stored_version, version]()
 		{
-			strm << "insufficient permissions to delete document";
-
-			throw DocumentPermissionsError(strm.str());
-		}
+			job();
+			*stored_version = version;
+		},
+		std::move(completion));
+}
 
-		strm << std::strerror(errno);
+void Document::wait_for_saves()
+{
+	if (last_save_.valid())
+	{
+		// failures are reported to the completion
+		last_save_.wait();
+		last_save_ = std::shared_future<void>();
+	}
+}
 
-		throw DocumentError(strm.str());
+void Document::store_indexes()
+{
+	if (storage_->keeps_indexes())
+	{
+		storage_->store_indexes(get_chunks(), get_lines());
 	}
 }
 
-void Document::save()
+void Document::publish() const
 {
-	off_t const begin = ::lseek(fd_, 0, SEEK_SET);
+	std::atomic_store(&current_, std::make_shared<Version const>(version_, contents_,
+		chunks_valid_ ? &chunks_ : 0));
+}
 
-	// should never fail
-	assert(begin != static_cast<off_t>(-1));
+void Document::insert(std::size_t offset, char const *bytes, std::size_t length)
+{
+	contents_.insert(offset, bytes, length);
+	storage_->inserted(offset, bytes, length);
+	version_++;
+	history_.inserted(offset, bytes, length, contents_);
+	cursors_.apply(offset, 0, length);
 
-	ssize_t const write_result = ::write(fd_, &contents_[0], contents_.size());
+	if (chunks_valid_)
+	{
+		chunks_.update(contents_, offset, 0, length);
+	}
 
-	if (static_cast<std::vector<char>::size_type>(write_result) != contents_.size())
+	if (lines_valid_)
 	{
-		throw DocumentError("unable to write all data to file");
+		lines_.update(contents_, offset, 0, length);
 	}
+
+	publish();
+}
+
+void Document::erase(std::size_t offset, std::size_t length)
+{
+	contents_.erase(offset, length);
+	storage_->erased(offset, length);
+	version_++;
+	history_.erased(offset, length, contents_);
+	cursors_.apply(offset, length, 0);
+
+	if (chunks_valid_)
+	{
+		chunks_.update(contents_, offset, length, 0);
+	}
+
+	if (lines_valid_)
+	{
+		lines_.update(contents_, offset, length, 0);
+	}
+
+	publish();
 }
 
 void Document::close()
 {
 	if (!document_closed_)
 	{
-		::close(fd_);
+		wait_for_saves();
+		storage_->close();
 		document_closed_ = true;
 	}
 }
 
 Hash::hash_t Document::hash() const
 {
-	if (contents_.size() >= std::numeric_limits<unsigned long>::max())
+	return get_chunks().root();
+}
+
+ChunkTree const &Document::get_chunks() const
+{
+	if (!chunks_valid_)
 	{
-		throw std::runtime_error("unable to create hash because document is too big");
+		chunks_ = ChunkTree(contents_);
+		chunks_valid_ = true;
+
+		// let the versions hash without cutting the contents again
+		publish();
 	}
 
-	return Hash::hash_bytes(contents_);
+	return chunks_;
 }
 
-std::vector<std::string> Document::list_documents()
+LineIndex const &Document::get_lines() const
+{
+	if (!lines_valid_)
+	{
+		lines_ = LineIndex(contents_);
+		lines_valid_ = true;
+	}
+
+	return lines_;
+}
+
+int Document::get_contents_file(std::size_t &offset) const
 {
-	DIR *dir = ::opendir(Document::directory_.c_str());
-	std::vector<std::string> list;
+	// a running save may still replace the file
+	if (last_save_.valid()
+		&& last_save_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+	{
+		return -1;
+	}
 
-	if (!dir)
+	if (*stored_version_ != version_)
+	{
+		return -1;
+	}
+
+	return storage_->contents_file(offset);
+}
+
+Document::version_ptr Document::pin() const
+{
+	return std::atomic_load(&current_);
+}
+
+std::pair<std::size_t, std::size_t> Document::position_of(std::size_t offset) const
+{
+	LineIndex const &lines = get_lines();
+	std::size_t const line = lines.line_of(contents_, offset);
+
+	return std::make_pair(line, offset - lines.offset_of(contents_, line));
+}
+
+std::size_t Document::offset_of(std::size_t line, std::size_t column) const
+{
+	LineIndex const &lines = get_lines();
+	std::size_t const begin = lines.offset_of(contents_, line);
+	// the end of the line is where its newline is
+	std::size_t const end = line + 1 < lines.lines()
+		? lines.offset_of(contents_, line + 1) - 1
+		: contents_.size();
+
+	if (column > end - begin)
 	{
 		std::ostringstream strm;
 
-		strm << "while listing documents <" << Document::directory_ << ">: ";
+		strm << "column " << column << " exceeds the length " << end - begin
+		     << " of line " << line;
 
-		if (errno == ENOENT || errno == ENOTDIR)
-		{
-			strm << "document directory does not exist";
+		throw rope_errors::OutOfRangeError(strm.str());
+	}
 
-			throw DocumentDoesntExistError(strm.str());
-		}
+	return begin + column;
+}
 
-		if (errno == EACCES)
-		{
-			strm << "insufficient permissions to open document directory";
+std::vector<std::string> Document::list_documents()
+{
+	return list_documents(directory_);
+}
 
-			throw DocumentPermissionsError(strm.str());
-		}
+std::vector<std::string> Document::list_documents(std::string const &directory)
+{
+	return DocumentLayout::list(directory);
+}
 
-		strm << std::strerror(errno);
+bool Document::is_auxiliary(std::string const &name)
+{
+	return ends_with(name, JournalStorage::journal_name(""))
+		|| ends_with(name, ".tmp")
+		|| ends_with(name, ".compact");
+}
 
-		throw DocumentError(strm.str());
+std::unique_ptr<DocumentStorage> Document::make_storage(int fd, std::string const &name,
+                                                       OpenMode mode, StorageMode storage)
+{
+	if (ContainerStorage::is_container(fd))
+	{
+		return std::unique_ptr<DocumentStorage>(new ContainerStorage(fd, name, mode));
 	}
 
-	::dirent *entry;
+	if (ChunkStorage::is_manifest(fd))
+	{
+		return std::unique_ptr<DocumentStorage>(new ChunkStorage(fd, name, mode));
+	}
 
-	try
+	if (CompressedStorage::is_compressed(fd))
 	{
-		while ((entry = ::readdir(dir)))
-		{
-			std::string const name = entry->d_name;
+		return std::unique_ptr<DocumentStorage>(new CompressedStorage(fd, name, mode));
+	}
 
-			if (name != "." && name != "..")
-			{
-				list.push_back(name);
-			}
-		}
+	if (storage == StorageMode::journal
+		|| ::access(JournalStorage::journal_name(name).c_str(), F_OK) == 0)
+	{
+		return std::unique_ptr<DocumentStorage>(new JournalStorage(fd, name, mode));
+	}
 
-		::closedir(dir);
+	if (storage == StorageMode::container)
+	{
+		return std::unique_ptr<DocumentStorage>(new ContainerStorage(fd, name, mode));
 	}
-	catch (...)
+
+	if (storage == StorageMode::deduplicated)
 	{
-		::closedir(dir);
-		throw;
+		return std::unique_ptr<DocumentStorage>(new ChunkStorage(fd, name, mode));
+	}
+
+	if (storage == StorageMode::compressed)
+	{
+		return std::unique_ptr<DocumentStorage>(new CompressedStorage(fd, name, mode));
 	}
 
-	return list;
+	if (storage == StorageMode::in_place)
+	{
+		return std::unique_ptr<DocumentStorage>(new InPlaceStorage(fd, name, mode));
+	}
+
+	return std::unique_ptr<DocumentStorage>(new FileStorage(fd, name, mode));
 }
 
-Document::Document(int fd, std::string const &name, std::int32_t id)
-try
-	: fd_(fd),
+Document::Document(std::unique_ptr<DocumentStorage> storage, std::string const &name,
+                   std::int32_t id)
+	: chunks_valid_(false),
+	  lines_valid_(false),
+	  storage_(std::move(storage)),
+	  version_(0),
+	  stored_version_(std::make_shared<std::atomic<std::uint64_t>>(0)),
 	  name_(name),
 	  id_(id),
 	  document_closed_(false)
 {
-	off_t const end = ::lseek(fd, 0, SEEK_END);
+	contents_ = storage_->load();
 
-	if (end == static_cast<off_t>(-1))
+	// a container comes with up to date indexes, sparing the scan
+	if (storage_->load_indexes(chunks_, lines_))
 	{
-		// should only fail if file too large
-		if (errno == EOVERFLOW)
-		{
-			throw DocumentError("file too big");
-		}
+		chunks_valid_ = lines_valid_ = true;
 	}
 
-	// should never fail
-	off_t const seek_result = ::lseek(fd, 0, SEEK_SET);
-
-	assert(seek_result != static_cast<off_t>(-1));
-
-	// reserve space
-	contents_.resize(end);
-
-	ssize_t const read_result = ::read(fd, &contents_[0], end);
-
-	if (read_result != end)
-	{
-		throw DocumentError("unable to read all data from file");
-	}
-}
-catch (...)
-{
-	::close(fd);
-	throw;
+	history_ = DocumentHistory(contents_, version_);
+	publish();
 }
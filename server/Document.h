@@ -1,12 +1,22 @@
 #ifndef DOCUMENT_H_INCLUDED
 #define DOCUMENT_H_INCLUDED
 
+#include "ChunkTree.h"
+#include "CursorIndex.h"
+#include "DocumentHistory.h"
 #include "Hash.h"
+#include "LineIndex.h"
+#include "Rope.h"
+#include "SaveQueue.h"
 
 #include <array>
+#include <atomic>
 #include <cstdint>
+#include <future>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 /**
@@ -41,11 +51,106 @@ namespace document_errors
 	{
 		DocumentPermissionsError(std::string const &message);
 	};
+
+	struct DocumentNameError
+		: DocumentError
+	{
+		DocumentNameError(std::string const &message);
+	};
 }
 
+class DocumentStorage;
+
 class Document
 {
 public:
+	/**
+	 * An immutable state of a document.
+	 *
+	 * Versions share all unchanged parts of their contents with the document,
+	 * so pinning one costs nothing but keeping the parts edited since alive.
+	 * A pinned version can be read on any thread while the document is
+	 * edited.
+	 */
+	class Version
+	{
+	public:
+		/**
+		 * Construct a version.
+		 *
+		 * @param number The number of the version.
+		 * @param contents The contents of the version.
+		 * @param chunks The chunk tree of the contents, 0 if there is none yet.
+		 */
+		Version(std::uint64_t number, Rope const &contents, ChunkTree const *chunks);
+
+		/**
+		 * Obtain the number of the version, it grows with every edit.
+		 */
+		std::uint64_t get_number() const
+		{
+			return number_;
+		}
+
+		/**
+		 * Obtain the contents of the version.
+		 */
+		Rope const &get_contents() const
+		{
+			return contents_;
+		}
+
+		/**
+		 * Obtain the hash of the contents, see Document::hash. Cutting and
+		 * hashing all contents is only necessary if the document had no
+		 * chunk tree when the version was published.
+		 */
+		Hash::hash_t hash() const;
+
+	private:
+		std::uint64_t const number_;
+		Rope const contents_;
+		ChunkTree const chunks_;
+		bool const chunks_valid_;
+	};
+
+	typedef std::shared_ptr<Version const> version_ptr;
+
+	/**
+	 * How the contents of a document are brought into memory.
+	 */
+	enum class OpenMode
+	{
+		// read the whole file onto the heap up front
+		read,
+		// map the file and let the kernel page it in on demand, only
+		// modified regions are copied onto the heap
+		mapped
+	};
+
+	/**
+	 * How changes of a document are written to disk.
+	 */
+	enum class StorageMode
+	{
+		// rewrite the whole document on every save
+		rewrite,
+		// append the edits to a journal next to the document and rewrite
+		// it in the background once the journal grows too large
+		journal,
+		// write only the changed ranges into the document, not crash safe
+		in_place,
+		// rewrite the whole document together with a header persisting its
+		// line index and chunk hashes, see ContainerStorage
+		container,
+		// keep every chunk of the contents once in a store shared by all
+		// documents, the document lists its chunks, see ChunkStorage
+		deduplicated,
+		// rewrite the whole document as independently deflated blocks which
+		// are only inflated once read, see CompressedStorage
+		compressed
+	};
+
 	/**
 	 * Move a document.
 	 *
@@ -65,25 +170,97 @@ public:
 	 *
 	 * @param name The name the document is referenced by.
 	 * @param overwrite Allow overwriting if the document exists.
+	 * @param storage How changes are written to disk.
 	 * @throws DocumentAlreadyExistsError If the document does exists and overwrite is
 	 *                                    false.
 	 * @throws DocumentPermissionsError If the file would have to be created but the
 	 *                                  creater lacks sufficient permissions.
 	 * @throws DocumentError If creating fails for other reasons.
 	 */
-	static Document create(std::string const &name, bool overwrite = false);
+	static Document create(std::string const &name, bool overwrite = false,
+	                       StorageMode storage = StorageMode::journal);
+
+	/**
+	 * Create a document by name with a given id.
+	 *
+	 * @param name The name the document is referenced by.
+	 * @param id The id for this document.
+	 * @param overwrite Allow overwriting if the document exists.
+	 * @param storage How changes are written to disk.
+	 * @throws DocumentAlreadyExistsError If the document does exists and overwrite is
+	 *                                    false.
+	 * @throws DocumentPermissionsError If the file would have to be created but the
+	 *                                  creater lacks sufficient permissions.
+	 * @throws DocumentError If creating fails for other reasons.
+	 */
+	static Document create(std::string const &name, std::int32_t id, bool overwrite,
+	                       StorageMode storage);
+
+	/**
+	 * Create a document as a copy of another one.
+	 *
+	 * If the file of the source holds its contents, it is cloned by a
+	 * reflink (FICLONE) where the filesystem supports it, which shares the
+	 * extents and takes constant time, else by copy_file_range, which lets
+	 * the kernel copy without passing the bytes through user space. Other
+	 * sources are written from their contents. A container is cloned as a
+	 * container. In memory the clone shares all pieces of the contents and
+	 * the indexes with the source, both copy on write.
+	 *
+	 * @param source The document to copy.
+	 * @param name The name the clone is referenced by.
+	 * @param overwrite Allow overwriting if the document exists.
+	 * @param storage How changes of the clone are written to disk.
+	 * @throws DocumentAlreadyExistsError If the document does exists and overwrite is
+	 *                                    false.
+	 * @throws DocumentPermissionsError If the file would have to be created but the
+	 *                                  creater lacks sufficient permissions.
+	 * @throws DocumentError If creating or copying fails for other reasons.
+	 */
+	static Document clone(Document const &source, std::string const &name,
+	                      bool overwrite = false, StorageMode storage = StorageMode::journal);
+
+	/**
+	 * Create a document as a copy of another one with a given id, see
+	 * clone(Document const &, std::string const &, bool, StorageMode).
+	 *
+	 * @param id The id for the clone.
+	 */
+	static Document clone(Document const &source, std::string const &name, std::int32_t id,
+	                      bool overwrite, StorageMode storage);
 
 	/**
 	 * Open a document by name.
 	 *
+	 * Documents that have a journal are always opened in journal mode.
+	 *
+	 * @param name The name the document is referenced by.
+	 * @param mode How the contents are brought into memory.
+	 * @param storage How changes are written to disk.
+	 * @return The Document instance.
+	 * @throws DocumentDoesntExistError If the document doesn't exist.
+	 * @throws DocumentPermissionsError If the opener lacks sufficient permissions to
+	 *                                  open the file.
+	 * @throws DocumentError If opening fails for other reasons.
+	 */
+	static Document open(std::string const &name, OpenMode mode = OpenMode::mapped,
+	                     StorageMode storage = StorageMode::journal);
+
+	/**
+	 * Open a document by name, keeping the id it had before it was closed.
+	 *
 	 * @param name The name the document is referenced by.
+	 * @param id The id for this document.
+	 * @param mode How the contents are brought into memory.
+	 * @param storage How changes are written to disk.
 	 * @return The Document instance.
 	 * @throws DocumentDoesntExistError If the document doesn't exist.
 	 * @throws DocumentPermissionsError If the opener lacks sufficient permissions to
 	 *                                  open the file.
 	 * @throws DocumentError If opening fails for other reasons.
 	 */
-	static Document open(std::string const &name);
+	static Document open(std::string const &name, std::int32_t id, OpenMode mode,
+	                     StorageMode storage);
 
 	/**
 	 * Check if a document is empty.
@@ -110,32 +287,189 @@ public:
 	/**
 	 * Save the document physically.
 	 *
+	 * In rewrite mode the contents are written to a temporary file which
+	 * then replaces the document, so mapped regions of the previous file
+	 * stay intact. In journal mode only the edits since the last save are
+	 * appended to the journal. In in-place mode the changed ranges are
+	 * written into the document which is then truncated to the new size.
+	 * In container mode the document is rewritten together with its indexes.
+	 *
 	 * @throws DocumentError If not all data could be copied.
 	 */
 	void save();
 
+	/**
+	 * Save the document on the thread of a save queue.
+	 *
+	 * An immutable snapshot of the contents is taken right away, which is
+	 * cheap as the rope shares its pieces, so editing can go on while the
+	 * snapshot is written. Other operations touching the disk wait for the
+	 * save to finish.
+	 *
+	 * @param queue The queue to run the save on.
+	 * @param completion Called by SaveQueue::dispatch once the snapshot is
+	 *                   saved, with the error if saving failed.
+	 * @throws DocumentError If preparing the save fails.
+	 */
+	void save(SaveQueue &queue, SaveQueue::Completion completion);
+
 	/**
 	 * Close the document.
 	 */
 	void close();
 
 	/**
-	 * Create a SHA-1 hash for this document and return it.
+	 * Obtain the hash of this document.
 	 *
-	 * @return The SHA-1 hash (20 bytes) of the contents.
+	 * The hash is the root of the chunk tree (see ChunkTree.h), which is built
+	 * on the first call and kept up to date by insert() and erase(). Documents
+	 * smaller than Chunker::min_size hash like their plain SHA-1.
+	 *
+	 * @return The SHA-1 based hash (20 bytes) of the contents.
 	 */
 	Hash::hash_t hash() const;
 
+	/**
+	 * Obtain the chunk tree of this document, building it if necessary.
+	 *
+	 * @return A reference to the chunk tree of the contents.
+	 */
+	ChunkTree const &get_chunks() const;
+
+	/**
+	 * Obtain the line index of this document, building it if necessary.
+	 *
+	 * The index is built on the first call and kept up to date by insert()
+	 * and erase(), like the chunk tree.
+	 *
+	 * @return A reference to the line index of the contents.
+	 */
+	LineIndex const &get_lines() const;
+
+	/**
+	 * Obtain the number of lines of the document.
+	 */
+	std::size_t lines() const
+	{
+		return get_lines().lines();
+	}
+
+	/**
+	 * Translate a byte offset into a line and a column. Both count from 0,
+	 * columns count bytes.
+	 *
+	 * @param offset The offset, may be equal to size().
+	 * @return The line and the column.
+	 * @throws rope_errors::OutOfRangeError If the offset is beyond the end.
+	 */
+	std::pair<std::size_t, std::size_t> position_of(std::size_t offset) const;
+
+	/**
+	 * Translate a line and a column into a byte offset.
+	 *
+	 * @param line The line, counting from 0.
+	 * @param column The column in bytes, may point behind the last byte of
+	 *               the line but not behind its newline.
+	 * @return The offset.
+	 * @throws rope_errors::OutOfRangeError If there is no such line or the
+	 *                                      column is beyond its end.
+	 */
+	std::size_t offset_of(std::size_t line, std::size_t column) const;
+
 	/**
 	 * Obtain the bytes of the document.
 	 *
-	 * @return A reference to the vector with all the bytes of the document.
+	 * Use Rope::for_each_span to walk them without copying.
+	 *
+	 * @return A reference to the rope holding all the bytes of the document.
 	 */
-	std::vector<char> &get_contents()
+	Rope const &get_contents() const
 	{
 		return contents_;
 	}
 
+	/**
+	 * Obtain the file holding the contents as they are, so they can be sent
+	 * straight from it without bringing them into memory.
+	 *
+	 * @param offset Receives the offset of the contents in the file.
+	 * @return The descriptor of the file, it stays owned by the document.
+	 *         -1 if the document was edited since it was loaded or saved,
+	 *         a save is still running or the storage keeps the contents
+	 *         differently.
+	 */
+	int get_contents_file(std::size_t &offset) const;
+
+	/**
+	 * Pin the current version of the document, safe to call on any thread.
+	 *
+	 * @return The version, it stays unchanged however the document is edited.
+	 */
+	version_ptr pin() const;
+
+	/**
+	 * Obtain the number of the current version.
+	 */
+	std::uint64_t get_version() const
+	{
+		return version_;
+	}
+
+	/**
+	 * Obtain the past versions of the document since it was opened, use
+	 * DocumentHistory::at to materialise one.
+	 */
+	DocumentHistory const &get_history() const
+	{
+		return history_;
+	}
+
+	/**
+	 * Obtain the cursors of the clients working on the document, insert()
+	 * and erase() let them follow every edit.
+	 */
+	CursorIndex &get_cursors()
+	{
+		return cursors_;
+	}
+
+	CursorIndex const &get_cursors() const
+	{
+		return cursors_;
+	}
+
+	/**
+	 * Obtain the number of bytes of the document.
+	 */
+	std::size_t size() const
+	{
+		return contents_.size();
+	}
+
+	/**
+	 * Insert bytes into the document.
+	 *
+	 * @param offset The offset to insert at, may be equal to size().
+	 * @param bytes The first byte to insert.
+	 * @param length The number of bytes to insert.
+	 * @throws rope_errors::OutOfRangeError If the offset is beyond the end.
+	 */
+	void insert(std::size_t offset, char const *bytes, std::size_t length);
+
+	void insert(std::size_t offset, std::vector<char> const &bytes)
+	{
+		insert(offset, bytes.data(), bytes.size());
+	}
+
+	/**
+	 * Erase bytes from the document.
+	 *
+	 * @param offset The first byte to erase.
+	 * @param length The number of bytes to erase.
+	 * @throws rope_errors::OutOfRangeError If the range exceeds the end.
+	 */
+	void erase(std::size_t offset, std::size_t length);
+
 	/**
 	 * Obtain a list of documents that can be opened.
 	 *
@@ -143,6 +477,34 @@ public:
 	 */
 	static std::vector<std::string> list_documents();
 
+	/**
+	 * Obtain a list of documents that can be opened from a directory laid
+	 * out as described in DocumentLayout.h.
+	 *
+	 * @param directory The directory, ending with a slash.
+	 * @return A list of documents that can be opened.
+	 */
+	static std::vector<std::string> list_documents(std::string const &directory);
+
+	/**
+	 * Check if a file in a document directory belongs to the storage of a
+	 * document rather than being a document itself.
+	 *
+	 * @param name The name of the file, without directory.
+	 * @return true for journals and temporary files, false otherwise.
+	 */
+	static bool is_auxiliary(std::string const &name);
+
+	/**
+	 * Obtain the directory the documents are kept in.
+	 *
+	 * @return The path of the directory, ending with a slash.
+	 */
+	static std::string const &get_directory()
+	{
+		return directory_;
+	}
+
 	/**
 	 * Obtain the id.
 	 *
@@ -154,6 +516,19 @@ public:
 	}
 
 private:
+	/**
+	 * Create the file of a document and remove a journal left behind.
+	 *
+	 * @param name The name the document is referenced by.
+	 * @param overwrite Allow overwriting if the document exists.
+	 * @return The UNIX file descriptor, readable and writable.
+	 * @throws DocumentAlreadyExistsError If the document does exists and overwrite is
+	 *                                    false.
+	 * @throws DocumentPermissionsError If the creater lacks sufficient permissions.
+	 * @throws DocumentError If creating fails for other reasons.
+	 */
+	static int create_file(std::string const &name, bool overwrite);
+
 	/**
 	 * Open a document by name and return the file descriptor.
 	 *
@@ -167,14 +542,48 @@ private:
 	static int open_readable(std::string const &name);
 
 	/**
-	 * Create a document with a linux specific file descriptor.
+	 * Wait until the saves running on a save queue finished.
+	 */
+	void wait_for_saves();
+
+	/**
+	 * Hand the indexes to the storage if it keeps them along with the contents.
+	 */
+	void store_indexes();
+
+	/**
+	 * Publish the contents as the current version.
+	 */
+	void publish() const;
+
+	/**
+	 * Construct the storage for an opened document file.
+	 *
+	 * @param fd The readable descriptor of the document file, the storage
+	 *           takes ownership.
+	 * @param name The name the document is referenced by.
+	 * @param mode How the contents are brought into memory.
+	 * @param storage The requested storage mode, container, deduplicated and
+	 *                compressed mode are used anyway if the document file is
+	 *                in their format and journal mode if the document has a
+	 *                journal.
+	 * @return The storage.
+	 * @throws DocumentError If the storage can't be set up.
+	 */
+	static std::unique_ptr<DocumentStorage> make_storage(int fd, std::string const &name,
+	                                                     OpenMode mode, StorageMode storage);
+
+	/**
+	 * Create a document from its storage.
 	 *
-	 * @param fd The descriptor for this document.
+	 * @param storage The storage for this document.
 	 * @param name The name the document is referenced by.
 	 * @param id The id for this document. Keep in mind that once the
 	 *           maximum id is reached, it starts at 0 again.
+	 * @throws DocumentError If the contents can't be loaded.
 	 */
-	explicit Document(int fd, std::string const &name, std::int32_t id);
+	explicit Document(std::unique_ptr<DocumentStorage> storage, std::string const &name,
+	                  std::int32_t id);
 
 	/**
 	 * Delete the default copy constructor, making copying a document object
@@ -188,8 +597,21 @@ private:
 	 */
 	Document &operator=(Document const &) = delete;
 
-	std::vector<char> contents_;
-	int fd_;
+	Rope contents_;
+	mutable ChunkTree chunks_;
+	mutable bool chunks_valid_;
+	mutable LineIndex lines_;
+	mutable bool lines_valid_;
+	std::unique_ptr<DocumentStorage> storage_;
+	// the last save queued, saves of one queue finish in order
+	std::shared_future<void> last_save_;
+	// the number of the current version and the one the file holds
+	std::uint64_t version_;
+	std::shared_ptr<std::atomic<std::uint64_t>> stored_version_;
+	// only replaced atomically, pinned from any thread
+	mutable version_ptr current_;
+	DocumentHistory history_;
+	CursorIndex cursors_;
 	std::string const name_;
 	static std::string const directory_;
 	std::int32_t id_;
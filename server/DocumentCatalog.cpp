@@ -0,0 +1,568 @@
+#include "DocumentCatalog.h"
+#include "DocumentLayout.h"
+#include "JournalStorage.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <sstream>
+#include <unordered_map>
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * @file DocumentCatalog.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the document catalog.
+ */
+
+namespace
+{
+	std::string const g_sql_queries[] = {
+		"CREATE TABLE IF NOT EXISTS DocumentCatalog ("
+			"d_id INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT,"
+			"d_name VARCHAR(128) NOT NULL,"
+			"d_size INTEGER NOT NULL,"
+			"d_hash VARCHAR(40) NOT NULL,"
+			"d_mtime INTEGER NOT NULL,"
+			"d_stored INTEGER NOT NULL,"
+			"UNIQUE(d_name)"
+		");",
+		"SELECT * FROM DocumentCatalog WHERE d_name = %Q;",
+		// reserved rows never match a stamp, so they are read on the next refresh
+		"INSERT OR IGNORE INTO DocumentCatalog (d_name, d_size, d_hash, d_mtime, d_stored) "
+			"VALUES (%Q, 0, '', 0, -1);",
+		"UPDATE DocumentCatalog SET d_size = %lld, d_hash = %Q, d_mtime = %lld, d_stored = %lld "
+			"WHERE d_name = %Q;",
+		"DELETE FROM DocumentCatalog WHERE d_name = %Q;",
+		"SELECT * FROM DocumentCatalog WHERE d_name > %Q ORDER BY d_name LIMIT %lld;",
+		"SELECT d_name, d_mtime, d_stored FROM DocumentCatalog;",
+		"SELECT COUNT(*) FROM DocumentCatalog;",
+		"BEGIN;",
+		"COMMIT;",
+		"ROLLBACK;",
+	};
+
+	// the changes which may alter a document or its journal, or add a shard
+	std::uint32_t const g_watched_events = IN_CREATE | IN_MODIFY | IN_ATTRIB | IN_DELETE
+		| IN_MOVED_FROM | IN_MOVED_TO;
+
+	std::string describe_errno(std::string const &action, std::string const &name)
+	{
+		std::ostringstream strm;
+
+		strm << "while " << action << " <" << name << ">: " << std::strerror(errno);
+
+		return strm.str();
+	}
+
+	/**
+	 * Check if a file in the document directory is a document, i.e. a name
+	 * DocumentManager would accept.
+	 */
+	bool is_document(std::string const &name)
+	{
+		return !name.empty() && name[0] != '.' && !Document::is_auxiliary(name);
+	}
+
+	std::int64_t nanoseconds_of(::timespec const &time)
+	{
+		return static_cast<std::int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+	}
+
+	DocumentCatalog::Entry entry_of(Database::result_t const &row)
+	{
+		DocumentCatalog::Entry entry;
+
+		entry.id = std::stoi(row.at("d_id"));
+		entry.name = row.at("d_name");
+		entry.size = std::stoull(row.at("d_size"));
+		entry.hash = Hash::hash_t();
+		entry.mtime = std::stoll(row.at("d_mtime"));
+
+		// reserved rows don't have a hash yet
+		if (!row.at("d_hash").empty())
+		{
+			entry.hash = Hash::string_to_hash(row.at("d_hash"));
+		}
+
+		return entry;
+	}
+
+	template <class Function>
+	void in_transaction(Database &database, Function const &function)
+	{
+		database.execute_sql(g_sql_queries[8]);
+
+		try
+		{
+			function();
+		}
+		catch (...)
+		{
+			database.execute_sql(g_sql_queries[10]);
+			throw;
+		}
+
+		database.execute_sql(g_sql_queries[9]);
+	}
+}
+
+using namespace document_errors;
+
+DocumentCatalog::DocumentCatalog(std::shared_ptr<Database> database,
+                                 std::string const &directory)
+	: database_(database),
+	  directory_(directory),
+	  inotify_fd_(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+	  lost_events_(false)
+{
+	if (inotify_fd_ < 0)
+	{
+		throw DocumentError(describe_errno("watching document directory", directory_));
+	}
+
+	try
+	{
+		watch(directory_, 0);
+		database_->execute_sql(g_sql_queries[0]);
+		reconcile();
+	}
+	catch (...)
+	{
+		::close(inotify_fd_);
+		throw;
+	}
+}
+
+DocumentCatalog::~DocumentCatalog()
+{
+	::close(inotify_fd_);
+}
+
+void DocumentCatalog::process_events()
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+	// large enough for at least one event with the longest name
+	alignas(::inotify_event) char buffer[sizeof(::inotify_event) + NAME_MAX + 1];
+
+	while (true)
+	{
+		ssize_t const length = ::read(inotify_fd_, buffer, sizeof(buffer));
+
+		if (length < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				return;
+			}
+
+			throw DocumentError(describe_errno("watching document directory", directory_));
+		}
+
+		for (ssize_t offset = 0; offset < length; )
+		{
+			::inotify_event const *event =
+				reinterpret_cast< ::inotify_event const *>(buffer + offset);
+
+			offset += sizeof(::inotify_event) + event->len;
+
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				lost_events_ = true;
+				continue;
+			}
+
+			auto const watched = watches_.find(event->wd);
+
+			if (watched == watches_.end())
+			{
+				continue;
+			}
+
+			if (event->mask & IN_IGNORED)
+			{
+				// the shard was pruned
+				watches_.erase(watched);
+				continue;
+			}
+
+			if (!event->len)
+			{
+				continue;
+			}
+
+			std::string const name = event->name;
+			std::string const directory = watched->second.first;
+			unsigned const level = watched->second.second;
+
+			if (level < DocumentLayout::levels)
+			{
+				if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))
+					&& DocumentLayout::is_shard(name))
+				{
+					watch(directory + name + '/', level + 1);
+				}
+			}
+			else if (!(event->mask & IN_ISDIR))
+			{
+				mark_stale(name);
+			}
+		}
+	}
+}
+
+DocumentCatalog::Entry DocumentCatalog::lookup(std::string const &name)
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+	if (lost_events_)
+	{
+		reconcile();
+	}
+
+	Database::results_t rows = database_->execute_sql(g_sql_queries[1], name);
+
+	if (rows.empty() || stale_.count(name) || rows[0].at("d_stored") == "-1")
+	{
+		refresh(name);
+		rows = database_->execute_sql(g_sql_queries[1], name);
+	}
+
+	if (rows.empty())
+	{
+		throw DocumentDoesntExistError("while looking up document <" + name
+			+ ">: document does not exist");
+	}
+
+	return entry_of(rows[0]);
+}
+
+std::int32_t DocumentCatalog::id_of(std::string const &name)
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+	database_->execute_sql(g_sql_queries[2], name);
+
+	Database::results_t const rows = database_->execute_sql(g_sql_queries[1], name);
+
+	if (rows.size() != 1)
+	{
+		throw database_errors::Failure("no catalog row for document <" + name + ">");
+	}
+
+	// fill in or drop the reserved row on the next refresh
+	if (rows[0].at("d_stored") == "-1")
+	{
+		stale_.insert(name);
+	}
+
+	return std::stoi(rows[0].at("d_id"));
+}
+
+void DocumentCatalog::update(std::string const &name, Document const &document)
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+	Stamp stamp;
+
+	if (stamp_of(name, stamp))
+	{
+		store(name, stamp, document.size(), document.hash());
+		stale_.erase(name);
+	}
+}
+
+void DocumentCatalog::refresh(std::string const &name)
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+	Stamp stamp;
+
+	stale_.erase(name);
+
+	if (!stamp_of(name, stamp))
+	{
+		database_->execute_sql(g_sql_queries[4], name);
+		return;
+	}
+
+	Database::results_t const rows = database_->execute_sql(g_sql_queries[1], name);
+
+	if (rows.size() == 1 && std::stoll(rows[0].at("d_mtime")) == stamp.mtime
+		&& std::stoll(rows[0].at("d_stored")) == stamp.stored)
+	{
+		return;
+	}
+
+	try
+	{
+		store(name, stamp);
+	}
+	catch (DocumentDoesntExistError const &)
+	{
+		// removed in the meantime
+		database_->execute_sql(g_sql_queries[4], name);
+	}
+}
+
+std::vector<DocumentCatalog::Entry> DocumentCatalog::list(std::string const &after,
+                                                          std::size_t count)
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+	refresh_stale();
+
+	Database::results_t const rows = database_->execute_sql(g_sql_queries[5], after,
+		static_cast<long long>(count));
+	std::vector<Entry> entries;
+
+	entries.reserve(rows.size());
+
+	for (auto const &row: rows)
+	{
+		entries.push_back(entry_of(row));
+	}
+
+	return entries;
+}
+
+std::size_t DocumentCatalog::size()
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+	refresh_stale();
+
+	Database::results_t const rows = database_->execute_sql(g_sql_queries[7]);
+
+	if (rows.size() != 1)
+	{
+		throw database_errors::Failure("no document count");
+	}
+
+	return std::stoull(rows[0].at("COUNT(*)"));
+}
+
+bool DocumentCatalog::stamp_of(std::string const &name, Stamp &stamp) const
+{
+	std::string const path = DocumentLayout::path_of(directory_, name);
+	struct ::stat status;
+
+	if (::stat(path.c_str(), &status))
+	{
+		if (errno == ENOENT || errno == ENOTDIR)
+		{
+			return false;
+		}
+
+		throw DocumentError(describe_errno("examining document", path));
+	}
+
+	stamp.mtime = nanoseconds_of(status.st_mtim);
+	stamp.stored = status.st_size;
+
+	std::string const journal = JournalStorage::journal_name(path);
+
+	if (::stat(journal.c_str(), &status))
+	{
+		if (errno == ENOENT)
+		{
+			return true;
+		}
+
+		throw DocumentError(describe_errno("examining document", journal));
+	}
+
+	stamp.mtime = std::max(stamp.mtime, nanoseconds_of(status.st_mtim));
+	stamp.stored += status.st_size;
+
+	return true;
+}
+
+void DocumentCatalog::store(std::string const &name, Stamp const &stamp)
+{
+	// rewrite mode doesn't touch the files, the journal is replayed anyway
+	Document const document = Document::open(DocumentLayout::path_of(directory_, name),
+		Document::OpenMode::mapped, Document::StorageMode::rewrite);
+
+	store(name, stamp, document.size(), document.hash());
+}
+
+void DocumentCatalog::store(std::string const &name, Stamp const &stamp, std::uint64_t size,
+                            Hash::hash_t const &hash)
+{
+	database_->execute_sql(g_sql_queries[2], name);
+	database_->execute_sql(g_sql_queries[3], static_cast<long long>(size),
+		Hash::hash_to_string(hash), static_cast<long long>(stamp.mtime),
+		static_cast<long long>(stamp.stored), name);
+}
+
+void DocumentCatalog::reconcile()
+{
+	std::vector<std::string> const names = Document::list_documents(directory_);
+	std::unordered_map<std::string, Stamp> known;
+
+	for (auto const &row: database_->execute_sql(g_sql_queries[6]))
+	{
+		Stamp &stamp = known[row.at("d_name")];
+
+		stamp.mtime = std::stoll(row.at("d_mtime"));
+		stamp.stored = std::stoll(row.at("d_stored"));
+	}
+
+	lost_events_ = false;
+	stale_.clear();
+
+	in_transaction(*database_,
+		[&]()
+		{
+			for (auto const &name: names)
+			{
+				Stamp stamp;
+
+				if (!is_document(name) || !stamp_of(name, stamp))
+				{
+					continue;
+				}
+
+				auto const row = known.find(name);
+
+				if (row != known.end())
+				{
+					bool const unchanged = row->second.mtime == stamp.mtime
+						&& row->second.stored == stamp.stored;
+
+					known.erase(row);
+
+					if (unchanged)
+					{
+						continue;
+					}
+				}
+
+				try
+				{
+					store(name, stamp);
+				}
+				catch (DocumentError const &)
+				{
+					// unreadable documents stay out of date until they change
+				}
+			}
+
+			// what is left has vanished
+			for (auto const &row: known)
+			{
+				database_->execute_sql(g_sql_queries[4], row.first);
+			}
+		});
+}
+
+void DocumentCatalog::watch(std::string const &directory, unsigned level)
+{
+	int const descriptor = ::inotify_add_watch(inotify_fd_, directory.c_str(), g_watched_events);
+
+	if (descriptor < 0)
+	{
+		if (errno == ENOENT || errno == ENOTDIR)
+		{
+			// a shard pruned right after it was announced doesn't matter
+			if (level)
+			{
+				return;
+			}
+
+			throw DocumentDoesntExistError("while watching document directory <"
+				+ directory + ">: document directory does not exist");
+		}
+
+		throw DocumentError(describe_errno("watching document directory", directory));
+	}
+
+	watches_[descriptor] = std::make_pair(directory, level);
+
+	try
+	{
+		if (level < DocumentLayout::levels)
+		{
+			for (auto const &name: DocumentLayout::read_directory(directory, true))
+			{
+				if (DocumentLayout::is_shard(name))
+				{
+					watch(directory + name + '/', level + 1);
+				}
+			}
+		}
+		else
+		{
+			for (auto const &name: DocumentLayout::read_directory(directory, false))
+			{
+				mark_stale(name);
+			}
+		}
+	}
+	catch (DocumentDoesntExistError const &)
+	{
+		// pruned again already, the watch reports that
+	}
+}
+
+void DocumentCatalog::mark_stale(std::string name)
+{
+	std::string const journal_suffix = JournalStorage::journal_name("");
+
+	// changing the journal changes the document
+	if (name.size() > journal_suffix.size() && name.compare(name.size()
+		- journal_suffix.size(), journal_suffix.size(), journal_suffix) == 0)
+	{
+		name.erase(name.size() - journal_suffix.size());
+	}
+
+	if (is_document(name))
+	{
+		stale_.insert(name);
+	}
+}
+
+void DocumentCatalog::refresh_stale()
+{
+	if (lost_events_)
+	{
+		reconcile();
+		return;
+	}
+
+	if (stale_.empty())
+	{
+		return;
+	}
+
+	std::vector<std::string> const names(stale_.begin(), stale_.end());
+
+	in_transaction(*database_,
+		[&]()
+		{
+			for (auto const &name: names)
+			{
+				try
+				{
+					refresh(name);
+				}
+				catch (DocumentError const &)
+				{
+					// the row keeps describing the last readable version
+				}
+			}
+		});
+}
@@ -0,0 +1,228 @@
+#ifndef DOCUMENTCATALOG_H_INCLUDED
+#define DOCUMENTCATALOG_H_INCLUDED
+
+#include "Database.h"
+#include "Document.h"
+#include "Hash.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/**
+ * @file DocumentCatalog.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * A persistent catalog of the documents in the document directory, kept in
+ * the database so listing and looking up documents doesn't need to scan the
+ * directory or read any document.
+ *
+ * Every document has a row with its id, size, hash and modification time.
+ * The rows are validated by a stamp of the files on disk (modification time
+ * and bytes stored, journal included): on startup only documents whose stamp
+ * changed are read again. Changes made while running are reported by
+ * inotify, which watches every shard directory (see DocumentLayout.h) and
+ * only marks the documents as stale; they are read again the next time they
+ * are looked up or listed. Every call holds a lock, so the network threads
+ * can share one catalog.
+ */
+
+class DocumentCatalog
+{
+public:
+	/**
+	 * A row of the catalog.
+	 */
+	struct Entry
+	{
+		std::int32_t id;
+		std::string name;
+		std::uint64_t size;
+		Hash::hash_t hash;
+		// nanoseconds since the epoch
+		std::int64_t mtime;
+	};
+
+	/**
+	 * Open the catalog, creating its table if necessary, start watching the
+	 * directory and bring the catalog up to date with it.
+	 *
+	 * @param database A shared database handle.
+	 * @param directory The directory holding the documents, ending with a
+	 *                  slash.
+	 * @throws DocumentError If the directory can't be watched or listed.
+	 * @throws database_errors::Failure If accessing the database fails.
+	 */
+	explicit DocumentCatalog(std::shared_ptr<Database> database,
+	                         std::string const &directory = Document::get_directory());
+
+	/**
+	 * Stop watching the directory.
+	 */
+	~DocumentCatalog();
+
+	/**
+	 * Delete the default copy constructor, making copying a catalog
+	 * impossible.
+	 */
+	DocumentCatalog(DocumentCatalog const &) = delete;
+
+	/**
+	 * Delete the default assignment operator, making assigning a catalog
+	 * impossible.
+	 */
+	DocumentCatalog &operator=(DocumentCatalog const &) = delete;
+
+	/**
+	 * Obtain the descriptor which becomes readable when the directory
+	 * changed, call process_events() then.
+	 */
+	int get_fd() const
+	{
+		return inotify_fd_;
+	}
+
+	/**
+	 * Read the pending change notifications and mark the changed documents
+	 * as stale. Doesn't block.
+	 *
+	 * @throws DocumentError If reading the notifications fails.
+	 */
+	void process_events();
+
+	/**
+	 * Obtain the row of a document, reading the document first if it is
+	 * stale.
+	 *
+	 * @param name The name of the document, without directory.
+	 * @return The row.
+	 * @throws DocumentDoesntExistError If the document doesn't exist.
+	 * @throws DocumentError If the document can't be read.
+	 * @throws database_errors::Failure If accessing the database fails.
+	 */
+	Entry lookup(std::string const &name);
+
+	/**
+	 * Obtain the id of a document, which stays the same as long as the
+	 * document exists. A row is reserved for documents the catalog doesn't
+	 * know yet, it is filled in or dropped once the document is looked up.
+	 *
+	 * @param name The name of the document, without directory.
+	 * @return The id.
+	 * @throws database_errors::Failure If accessing the database fails.
+	 */
+	std::int32_t id_of(std::string const &name);
+
+	/**
+	 * Update the row of a document from its contents in memory, e.g. right
+	 * after saving it, so it doesn't have to be read again.
+	 *
+	 * @param name The name of the document, without directory.
+	 * @param document The document, as it is on disk.
+	 * @throws database_errors::Failure If accessing the database fails.
+	 */
+	void update(std::string const &name, Document const &document);
+
+	/**
+	 * Bring the row of a document up to date with the disk, reading the
+	 * document if its stamp changed and dropping the row if it is gone.
+	 *
+	 * @param name The name of the document, without directory.
+	 * @throws DocumentError If the document can't be read.
+	 * @throws database_errors::Failure If accessing the database fails.
+	 */
+	void refresh(std::string const &name);
+
+	/**
+	 * Obtain a page of the catalog, ordered by name.
+	 *
+	 * Pages are addressed by the last name of the previous page, so paging
+	 * through the catalog doesn't skip or repeat rows while documents are
+	 * created or removed.
+	 *
+	 * @param after The last name of the previous page, empty for the first.
+	 * @param count The maximum number of rows.
+	 * @return The rows.
+	 * @throws database_errors::Failure If accessing the database fails.
+	 */
+	std::vector<Entry> list(std::string const &after, std::size_t count);
+
+	/**
+	 * Obtain the number of documents.
+	 *
+	 * @throws database_errors::Failure If accessing the database fails.
+	 */
+	std::size_t size();
+
+private:
+	/**
+	 * What identifies a version of a document on disk.
+	 */
+	struct Stamp
+	{
+		std::int64_t mtime;
+		std::int64_t stored;
+	};
+
+	/**
+	 * Obtain the stamp of a document.
+	 *
+	 * @return false if the document doesn't exist.
+	 * @throws DocumentError If the files can't be examined.
+	 */
+	bool stamp_of(std::string const &name, Stamp &stamp) const;
+
+	/**
+	 * Read a document and write its row.
+	 */
+	void store(std::string const &name, Stamp const &stamp);
+
+	/**
+	 * Write the row of a document.
+	 */
+	void store(std::string const &name, Stamp const &stamp, std::uint64_t size,
+	           Hash::hash_t const &hash);
+
+	/**
+	 * Compare all rows with the directory, reading changed documents only.
+	 */
+	void reconcile();
+
+	/**
+	 * Refresh all stale documents, reconciling if notifications were lost.
+	 */
+	void refresh_stale();
+
+	/**
+	 * Watch a directory of the layout and the shards below it, marking the
+	 * documents found as stale as they may have changed before the watch
+	 * was set up.
+	 *
+	 * @param directory The directory, ending with a slash.
+	 * @param level The level of the directory, 0 for the document directory.
+	 */
+	void watch(std::string const &directory, unsigned level);
+
+	/**
+	 * Mark the document a file in a shard belongs to as stale.
+	 */
+	void mark_stale(std::string name);
+
+	std::shared_ptr<Database> database_;
+	std::string const directory_;
+	int inotify_fd_;
+	// the watched directories and their levels by watch descriptor
+	std::unordered_map<int, std::pair<std::string, unsigned>> watches_;
+	std::unordered_set<std::string> stale_;
+	bool lost_events_;
+	// lookup() refreshes while holding it
+	std::recursive_mutex mutex_;
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "DocumentHistory.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+/**
+ * @file DocumentHistory.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the history of a document.
+ */
+
+namespace
+{
+	std::int64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+}
+
+std::size_t const DocumentHistory::checkpoint_interval;
+
+DocumentHistory::DocumentHistory(Rope const &contents, std::uint64_t version,
+                                 std::size_t retained)
+	: retained_(std::max(retained, checkpoint_interval)),
+	  first_(version),
+	  first_time_(now())
+{
+	checkpoints_.push_back(contents);
+}
+
+void DocumentHistory::inserted(std::size_t offset, char const *bytes, std::size_t length,
+                               Rope const &contents)
+{
+	Operation operation = { now(), offset, 0, std::vector<char>(bytes, bytes + length) };
+
+	record(std::move(operation), contents);
+}
+
+void DocumentHistory::erased(std::size_t offset, std::size_t length, Rope const &contents)
+{
+	Operation operation = { now(), offset, length, std::vector<char>() };
+
+	record(std::move(operation), contents);
+}
+
+Rope DocumentHistory::at(std::uint64_t version) const
+{
+	check_version(version);
+
+	std::size_t const index = version - first_;
+	std::size_t const begin = index - index % checkpoint_interval;
+	Rope contents = checkpoints_[begin / checkpoint_interval];
+
+	for (std::size_t i = begin; i < index; i++)
+	{
+		Operation const &operation = operations_[i];
+
+		if (operation.length)
+		{
+			contents.erase(operation.offset, operation.length);
+		}
+		else
+		{
+			contents.insert(operation.offset, operation.bytes);
+		}
+	}
+
+	return contents;
+}
+
+std::int64_t DocumentHistory::time_of(std::uint64_t version) const
+{
+	check_version(version);
+
+	return version == first_ ? first_time_ : operations_[version - first_ - 1].time;
+}
+
+std::uint64_t DocumentHistory::version_at(std::int64_t time) const
+{
+	if (time < first_time_)
+	{
+		std::ostringstream strm;
+
+		strm << "the history starts after " << time;
+
+		throw rope_errors::OutOfRangeError(strm.str());
+	}
+
+	// the operations are recorded in order, so are their times
+	auto const later = std::upper_bound(operations_.begin(), operations_.end(), time,
+		[](std::int64_t time, Operation const &operation)
+		{
+			return time < operation.time;
+		});
+
+	return first_ + (later - operations_.begin());
+}
+
+void DocumentHistory::record(Operation operation, Rope const &contents)
+{
+	operations_.push_back(std::move(operation));
+
+	if (operations_.size() % checkpoint_interval == 0)
+	{
+		checkpoints_.push_back(contents);
+	}
+
+	// drop the oldest checkpoint and its operations once enough remain without them
+	if (operations_.size() >= retained_ + checkpoint_interval)
+	{
+		first_time_ = operations_[checkpoint_interval - 1].time;
+		first_ += checkpoint_interval;
+		operations_.erase(operations_.begin(), operations_.begin() + checkpoint_interval);
+		checkpoints_.pop_front();
+	}
+}
+
+void DocumentHistory::check_version(std::uint64_t version) const
+{
+	if (version < first_ || version > last())
+	{
+		std::ostringstream strm;
+
+		strm << "version " << version << " isn't within the history from " << first_
+		     << " to " << last();
+
+		throw rope_errors::OutOfRangeError(strm.str());
+	}
+}
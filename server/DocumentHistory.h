@@ -0,0 +1,144 @@
+#ifndef DOCUMENTHISTORY_H_INCLUDED
+#define DOCUMENTHISTORY_H_INCLUDED
+
+#include "Rope.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+/**
+ * @file DocumentHistory.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * The past versions of a document.
+ *
+ * Every edit is kept in an operation log, and after every
+ * checkpoint_interval operations the contents are kept as a checkpoint.
+ * Checkpoints are rope copies sharing all unchanged pieces, so they only
+ * keep the bytes alive that were edited since. Materialising a version
+ * copies the closest checkpoint in front of it and replays less than
+ * checkpoint_interval operations onto it.
+ *
+ * Once the log grows beyond the retained number of operations, the oldest
+ * checkpoint and the operations following it are dropped.
+ */
+
+class DocumentHistory
+{
+public:
+	/**
+	 * The number of operations between two checkpoints, which bounds the
+	 * operations replayed to materialise a version.
+	 */
+	static std::size_t const checkpoint_interval = 256;
+
+	/**
+	 * Start the history of a document.
+	 *
+	 * @param contents The contents of the first version.
+	 * @param version The number of the first version.
+	 * @param retained The number of operations to retain at least, older
+	 *                 ones are dropped a checkpoint interval at a time.
+	 */
+	explicit DocumentHistory(Rope const &contents = Rope(), std::uint64_t version = 0,
+	                         std::size_t retained = 64 * 1024);
+
+	/**
+	 * Record an insertion, producing the next version.
+	 *
+	 * @param offset The offset the bytes were inserted at.
+	 * @param bytes The first inserted byte.
+	 * @param length The number of inserted bytes.
+	 * @param contents The contents after the insertion.
+	 */
+	void inserted(std::size_t offset, char const *bytes, std::size_t length,
+	              Rope const &contents);
+
+	/**
+	 * Record an erasure, producing the next version.
+	 *
+	 * @param offset The offset of the first erased byte.
+	 * @param length The number of erased bytes.
+	 * @param contents The contents after the erasure.
+	 */
+	void erased(std::size_t offset, std::size_t length, Rope const &contents);
+
+	/**
+	 * Obtain the number of the oldest version still available.
+	 */
+	std::uint64_t first() const
+	{
+		return first_;
+	}
+
+	/**
+	 * Obtain the number of the latest version.
+	 */
+	std::uint64_t last() const
+	{
+		return first_ + operations_.size();
+	}
+
+	/**
+	 * Materialise the contents of a version.
+	 *
+	 * @param version The number of the version.
+	 * @return The contents as they were at that version.
+	 * @throws rope_errors::OutOfRangeError If the version isn't available.
+	 */
+	Rope at(std::uint64_t version) const;
+
+	/**
+	 * Obtain the time a version came into being.
+	 *
+	 * @param version The number of the version.
+	 * @return Nanoseconds since the epoch, the first version dates from
+	 *         the start of the history.
+	 * @throws rope_errors::OutOfRangeError If the version isn't available.
+	 */
+	std::int64_t time_of(std::uint64_t version) const;
+
+	/**
+	 * Find the version which was current at a point in time.
+	 *
+	 * @param time Nanoseconds since the epoch.
+	 * @return The latest version created at or before the time.
+	 * @throws rope_errors::OutOfRangeError If the time lies before the first
+	 *                                      available version.
+	 */
+	std::uint64_t version_at(std::int64_t time) const;
+
+private:
+	struct Operation
+	{
+		std::int64_t time;
+		std::size_t offset;
+		// the number of erased bytes, erasures carry no bytes
+		std::size_t length;
+		std::vector<char> bytes;
+	};
+
+	/**
+	 * Append an operation and take a checkpoint or drop old ones if due.
+	 */
+	void record(Operation operation, Rope const &contents);
+
+	/**
+	 * Check that a version is available.
+	 *
+	 * @throws rope_errors::OutOfRangeError If it isn't.
+	 */
+	void check_version(std::uint64_t version) const;
+
+	std::size_t retained_;
+	std::uint64_t first_;
+	std::int64_t first_time_;
+	// operations_[i] produced the version first_ + i + 1
+	std::deque<Operation> operations_;
+	// checkpoints_[k] holds the version first_ + k * checkpoint_interval
+	std::deque<Rope> checkpoints_;
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include "DocumentLayout.h"
+#include "Document.h"
+#include "Hash.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * @file DocumentLayout.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the layout of document directories.
+ */
+
+namespace
+{
+	/**
+	 * Obtain the directory part of a path, without the trailing slash.
+	 */
+	std::string parent_of(std::string const &path)
+	{
+		std::string::size_type const slash = path.find_last_of('/');
+
+		return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+	}
+
+	bool is_directory(std::string const &directory, ::dirent const &entry)
+	{
+		if (entry.d_type != DT_UNKNOWN)
+		{
+			return entry.d_type == DT_DIR;
+		}
+
+		// not every file system fills in the type
+		struct ::stat status;
+
+		return ::lstat((directory + entry.d_name).c_str(), &status) == 0
+			&& S_ISDIR(status.st_mode);
+	}
+}
+
+using namespace document_errors;
+
+unsigned const DocumentLayout::levels;
+
+std::string DocumentLayout::shard_of(std::string const &name)
+{
+	std::string const hash = Hash::hash_to_string(Hash::hash_bytes(name.data(), name.size()));
+	std::string shard;
+
+	for (unsigned level = 0; level < levels; level++)
+	{
+		shard += hash[level];
+		shard += '/';
+	}
+
+	return shard;
+}
+
+std::string DocumentLayout::path_of(std::string const &directory, std::string const &name)
+{
+	return directory + shard_of(name) + name;
+}
+
+void DocumentLayout::make_shard(std::string const &path)
+{
+	std::vector<std::string> parents;
+
+	for (std::string parent = parent_of(path); parents.size() < levels;
+		parent = parent_of(parent))
+	{
+		parents.push_back(parent);
+	}
+
+	// outermost first
+	for (auto parent = parents.rbegin(); parent != parents.rend(); ++parent)
+	{
+		if (::mkdir(parent->c_str(), 0755) && errno != EEXIST)
+		{
+			std::ostringstream strm;
+
+			strm << "while creating document shard <" << *parent << ">: ";
+
+			if (errno == EACCES || errno == EROFS)
+			{
+				strm << "insufficient permissions to create document shard";
+
+				throw DocumentPermissionsError(strm.str());
+			}
+
+			strm << std::strerror(errno);
+
+			throw DocumentError(strm.str());
+		}
+	}
+}
+
+void DocumentLayout::prune_shard(std::string const &path)
+{
+	std::string parent = parent_of(path);
+
+	// stops at the first directory still holding documents
+	for (unsigned level = 0; level < levels && ::rmdir(parent.c_str()) == 0; level++)
+	{
+		parent = parent_of(parent);
+	}
+}
+
+std::string DocumentLayout::root_of(std::string const &path)
+{
+	std::string const directory = parent_of(path);
+	std::string root = directory;
+
+	for (unsigned level = 0; level < levels; level++)
+	{
+		std::string::size_type const slash = root.find_last_of('/');
+
+		if (!is_shard(slash == std::string::npos ? root : root.substr(slash + 1)))
+		{
+			return directory + '/';
+		}
+
+		root = parent_of(root);
+	}
+
+	return root + '/';
+}
+
+std::vector<std::string> DocumentLayout::list(std::string const &directory)
+{
+	std::vector<std::string> shards(1, directory);
+
+	for (unsigned level = 0; level < levels; level++)
+	{
+		std::vector<std::string> next;
+
+		for (auto const &shard: shards)
+		{
+			for (auto const &name: read_directory(shard, true))
+			{
+				if (is_shard(name))
+				{
+					next.push_back(shard + name + '/');
+				}
+			}
+		}
+
+		shards.swap(next);
+	}
+
+	std::vector<std::string> list;
+
+	for (auto const &shard: shards)
+	{
+		for (auto const &name: read_directory(shard, false))
+		{
+			if (!Document::is_auxiliary(name))
+			{
+				list.push_back(name);
+			}
+		}
+	}
+
+	return list;
+}
+
+std::vector<std::string> DocumentLayout::read_directory(std::string const &directory,
+                                                        bool directories)
+{
+	DIR *dir = ::opendir(directory.c_str());
+	std::vector<std::string> list;
+
+	if (!dir)
+	{
+		std::ostringstream strm;
+
+		strm << "while listing documents <" << directory << ">: ";
+
+		if (errno == ENOENT || errno == ENOTDIR)
+		{
+			strm << "document directory does not exist";
+
+			throw DocumentDoesntExistError(strm.str());
+		}
+
+		if (errno == EACCES)
+		{
+			strm << "insufficient permissions to open document directory";
+
+			throw DocumentPermissionsError(strm.str());
+		}
+
+		strm << std::strerror(errno);
+
+		throw DocumentError(strm.str());
+	}
+
+	::dirent *entry;
+
+	try
+	{
+		while ((entry = ::readdir(dir)))
+		{
+			std::string const name = entry->d_name;
+
+			if (name != "." && name != ".." && is_directory(directory, *entry) == directories)
+			{
+				list.push_back(name);
+			}
+		}
+
+		::closedir(dir);
+	}
+	catch (...)
+	{
+		::closedir(dir);
+		throw;
+	}
+
+	return list;
+}
+
+bool DocumentLayout::is_shard(std::string const &name)
+{
+	return name.size() == 1
+		&& ((name[0] >= '0' && name[0] <= '9') || (name[0] >= 'a' && name[0] <= 'f'));
+}
@@ -0,0 +1,116 @@
+#ifndef DOCUMENTLAYOUT_H_INCLUDED
+#define DOCUMENTLAYOUT_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+/**
+ * @file DocumentLayout.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * The on-disk layout of a document directory.
+ *
+ * Documents aren't kept in the document directory itself but fanned out
+ * into subdirectories named after their hash: the document "notes" lives in
+ * "<directory>/<a>/<b>/notes", where a and b are the first two hexadecimal
+ * digits of the SHA-1 of the name. That makes 256 shards, so a million
+ * documents still put about 4000 entries into every shard, a few hundred
+ * times fewer than one flat directory. Hashed directory indexes as in ext4
+ * or XFS look names up quickly at that size. Two digits per level, as git
+ * names its object directories, would make 65536 shards. DocumentCatalog
+ * watches every shard with inotify, though, and that is far beyond the
+ * common default limit of 8192 watches per user, while 256 shards need 273
+ * watches in total.
+ *
+ * Shard directories are created when the first document is created in them
+ * and removed along with their last document. Directories using the old flat
+ * layout are converted by the migrate_documents tool.
+ */
+
+class DocumentLayout
+{
+public:
+	/**
+	 * The number of subdirectory levels below the document directory.
+	 */
+	static unsigned const levels = 2;
+
+	/**
+	 * Obtain the shard of a document.
+	 *
+	 * @param name The name of the document, without directory.
+	 * @return The relative path of the shard, ending with a slash.
+	 */
+	static std::string shard_of(std::string const &name);
+
+	/**
+	 * Obtain the path of a document.
+	 *
+	 * @param directory The document directory, ending with a slash.
+	 * @param name The name of the document, without directory.
+	 * @return The path of the document within its shard.
+	 */
+	static std::string path_of(std::string const &directory, std::string const &name);
+
+	/**
+	 * Create the shard directories a document path lies in, if necessary.
+	 *
+	 * @param path The path of the document, as returned by path_of.
+	 * @throws DocumentPermissionsError If a directory can't be created for
+	 *                                  lack of permissions.
+	 * @throws DocumentError If a directory can't be created for other reasons.
+	 */
+	static void make_shard(std::string const &path);
+
+	/**
+	 * Remove the shard directories a document path lies in, as far as they
+	 * are empty.
+	 *
+	 * @param path The path of the document, as returned by path_of.
+	 */
+	static void prune_shard(std::string const &path);
+
+	/**
+	 * Obtain the document directory a document path lies in.
+	 *
+	 * @param path The path of the document, as returned by path_of or a
+	 *             path in a flat directory.
+	 * @return The directory above the shards, or the directory of the
+	 *         document if it doesn't lie in shards, ending with a slash.
+	 */
+	static std::string root_of(std::string const &path);
+
+	/**
+	 * Obtain the names of the documents in a document directory.
+	 *
+	 * @param directory The document directory, ending with a slash.
+	 * @return The names, without directory.
+	 * @throws DocumentDoesntExistError If the directory doesn't exist.
+	 * @throws DocumentPermissionsError If the directory can't be read for
+	 *                                  lack of permissions.
+	 * @throws DocumentError If the directory can't be read for other reasons.
+	 */
+	static std::vector<std::string> list(std::string const &directory);
+
+	/**
+	 * Obtain the entries of a single directory.
+	 *
+	 * @param directory The directory, ending with a slash.
+	 * @param directories true for the subdirectories, false for all other
+	 *                    entries.
+	 * @return The names of the entries, without "." and "..".
+	 * @throws DocumentError As list.
+	 */
+	static std::vector<std::string> read_directory(std::string const &directory,
+	                                               bool directories);
+
+	/**
+	 * Check if a directory entry is named like a shard directory of any level.
+	 *
+	 * @param name The name of the entry.
+	 * @return true if the name is a single lower case hexadecimal digit.
+	 */
+	static bool is_shard(std::string const &name);
+};
+
+#endif
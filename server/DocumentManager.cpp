@@ -0,0 +1,323 @@
+#include "DocumentManager.h"
+#include "DocumentLayout.h"
+
+/**
+ * @file DocumentManager.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the table of open documents.
+ */
+
+using namespace document_errors;
+
+DocumentManager::DocumentManager(SaveQueue &queue, clock::duration idle_timeout,
+                                 std::string const &directory, DocumentCatalog *catalog)
+	: queue_(queue),
+	  idle_timeout_(idle_timeout),
+	  directory_(directory),
+	  catalog_(catalog)
+{
+}
+
+DocumentManager::~DocumentManager()
+{
+	for (auto &entry: entries_)
+	{
+		if (entry.second.document)
+		{
+			try
+			{
+				entry.second.document->save();
+			}
+			catch (DocumentError const &)
+			{
+				// nobody is left to tell
+			}
+		}
+	}
+}
+
+DocumentManager::document_ptr DocumentManager::create(std::string const &name)
+{
+	std::string const path = path_of(name);
+
+	DocumentLayout::make_shard(path);
+
+	document_ptr const document = add(name, std::make_shared<Document>(catalog_
+		? Document::create(path, catalog_id(name), false, Document::StorageMode::journal)
+		: Document::create(path)));
+
+	catalog(name, *document);
+
+	return document;
+}
+
+DocumentManager::document_ptr DocumentManager::clone(Document const &source,
+                                                     std::string const &name)
+{
+	std::string const path = path_of(name);
+
+	DocumentLayout::make_shard(path);
+
+	document_ptr const document = add(name, std::make_shared<Document>(catalog_
+		? Document::clone(source, path, catalog_id(name), false, Document::StorageMode::journal)
+		: Document::clone(source, path)));
+
+	catalog(name, *document);
+
+	return document;
+}
+
+DocumentManager::document_ptr DocumentManager::open(std::string const &name)
+{
+	std::string const path = path_of(name);
+	auto const id = ids_.find(name);
+
+	if (id == ids_.end())
+	{
+		return add(name, std::make_shared<Document>(catalog_
+			? Document::open(path, catalog_id(name), Document::OpenMode::mapped,
+				Document::StorageMode::journal)
+			: Document::open(path)));
+	}
+
+	Entry &entry = entries_.at(id->second);
+
+	if (!entry.document)
+	{
+		auto const saving = saving_.find(id->second);
+
+		// still being saved for hibernation, take it back
+		if (saving != saving_.end())
+		{
+			entry.document = saving->second;
+			saving_.erase(saving);
+		}
+		else
+		{
+			entry.document = std::make_shared<Document>(Document::open(path, id->second,
+				Document::OpenMode::mapped, Document::StorageMode::journal));
+		}
+	}
+
+	// mark as recently used
+	set_idle(entry, id->second, entry.clients == 0);
+
+	return entry.document;
+}
+
+DocumentManager::document_ptr DocumentManager::find(std::int32_t id)
+{
+	auto const entry = entries_.find(id);
+
+	if (entry == entries_.end())
+	{
+		return document_ptr();
+	}
+
+	return open(entry->second.name);
+}
+
+void DocumentManager::remove(std::string const &name)
+{
+	open(name)->remove();
+	DocumentLayout::prune_shard(path_of(name));
+
+	std::int32_t const id = ids_.at(name);
+	Entry &entry = entries_.at(id);
+
+	set_idle(entry, id, false);
+	entries_.erase(id);
+	ids_.erase(name);
+
+	if (catalog_)
+	{
+		try
+		{
+			catalog_->refresh(name);
+		}
+		catch (std::exception const &)
+		{
+			// the catalog notices the removal itself
+		}
+	}
+}
+
+void DocumentManager::acquire(std::int32_t id)
+{
+	auto const entry = entries_.find(id);
+
+	if (entry != entries_.end() && entry->second.clients++ == 0)
+	{
+		set_idle(entry->second, id, false);
+	}
+}
+
+void DocumentManager::release(std::int32_t id)
+{
+	auto const entry = entries_.find(id);
+
+	if (entry != entries_.end() && entry->second.clients && --entry->second.clients == 0)
+	{
+		set_idle(entry->second, id, static_cast<bool>(entry->second.document));
+	}
+}
+
+std::size_t DocumentManager::hibernate(clock::time_point now)
+{
+	std::size_t hibernated = 0;
+
+	for (std::size_t candidates = idle_.size(); candidates; candidates--)
+	{
+		std::int32_t const id = idle_.front();
+		Entry &entry = entries_.at(id);
+
+		if (now - entry.idle_since < idle_timeout_)
+		{
+			break;
+		}
+
+		document_ptr const document = entry.document;
+
+		set_idle(entry, id, false);
+		entry.document.reset();
+		saving_[id] = document;
+
+		auto const completion = [this, id, document](std::exception_ptr error)
+		{
+			auto const entry = entries_.find(id);
+
+			if (!error && entry != entries_.end())
+			{
+				catalog(entry->second.name, *document);
+			}
+
+			auto const saving = saving_.find(id);
+
+			if (saving != saving_.end() && saving->second == document)
+			{
+				saving_.erase(saving);
+			}
+
+			// keep it, the next hibernation tries again
+			if (error && entry != entries_.end() && !entry->second.document)
+			{
+				entry->second.document = document;
+				set_idle(entry->second, id, entry->second.clients == 0);
+			}
+		};
+
+		try
+		{
+			document->save(queue_, completion);
+			hibernated++;
+		}
+		catch (DocumentError const &)
+		{
+			saving_.erase(id);
+			entry.document = document;
+			set_idle(entry, id, true);
+		}
+	}
+
+	return hibernated;
+}
+
+std::size_t DocumentManager::resident() const
+{
+	std::size_t count = saving_.size();
+
+	for (auto const &entry: entries_)
+	{
+		if (entry.second.document)
+		{
+			count++;
+		}
+	}
+
+	return count;
+}
+
+std::string DocumentManager::path_of(std::string const &name) const
+{
+	// the files next to a document belong to its storage, they are no documents themselves
+	if (name.empty() || name[0] == '.' || name.find_first_of(std::string("/\0", 2))
+		!= std::string::npos || Document::is_auxiliary(name))
+	{
+		throw DocumentNameError("invalid document name <" + name + ">");
+	}
+
+	return DocumentLayout::path_of(directory_, name);
+}
+
+DocumentManager::document_ptr DocumentManager::add(std::string const &name,
+                                                   document_ptr document)
+{
+	std::int32_t const id = document->get_id();
+	auto const previous = ids_.find(name);
+
+	// the document was replaced behind the table's back
+	if (previous != ids_.end())
+	{
+		set_idle(entries_.at(previous->second), previous->second, false);
+		entries_.erase(previous->second);
+		saving_.erase(previous->second);
+	}
+
+	Entry &entry = entries_[id];
+
+	entry.name = name;
+	entry.document = document;
+	entry.clients = 0;
+	entry.idle = false;
+	ids_[name] = id;
+	set_idle(entry, id, true);
+
+	return document;
+}
+
+std::int32_t DocumentManager::catalog_id(std::string const &name)
+{
+	try
+	{
+		return catalog_->id_of(name);
+	}
+	catch (database_errors::Failure const &exception)
+	{
+		throw DocumentError("while obtaining the id of document <" + name + ">: "
+			+ exception.what());
+	}
+}
+
+void DocumentManager::catalog(std::string const &name, Document const &document)
+{
+	if (!catalog_)
+	{
+		return;
+	}
+
+	try
+	{
+		catalog_->update(name, document);
+	}
+	catch (std::exception const &)
+	{
+		// the catalog reads the document again once it notices the change
+	}
+}
+
+void DocumentManager::set_idle(Entry &entry, std::int32_t id, bool idle)
+{
+	if (entry.idle)
+	{
+		idle_.erase(entry.idle_position);
+		entry.idle = false;
+	}
+
+	if (idle)
+	{
+		entry.idle_position = idle_.insert(idle_.end(), id);
+		entry.idle_since = clock::now();
+		entry.idle = true;
+	}
+}
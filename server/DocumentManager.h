@@ -0,0 +1,208 @@
+#ifndef DOCUMENTMANAGER_H_INCLUDED
+#define DOCUMENTMANAGER_H_INCLUDED
+
+#include "Document.h"
+#include "DocumentCatalog.h"
+#include "SaveQueue.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @file DocumentManager.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * The table of open documents. Every document is opened once and shared by
+ * all clients working on it, and is found by its name as well as by its id.
+ *
+ * Documents without clients are hibernated after an idle timeout: they are
+ * saved on the save queue and closed, so only the working set stays in
+ * memory. The id of a document survives hibernation, finding it by id opens
+ * it again. Not thread safe, use it from the thread dispatching the save
+ * queue.
+ *
+ * With a catalog the documents get the ids of their catalog rows, which stay
+ * the same across restarts, and the catalog is told about every document the
+ * table creates, saves for hibernation or removes.
+ */
+
+class DocumentManager
+{
+public:
+	typedef std::chrono::steady_clock clock;
+	typedef std::shared_ptr<Document> document_ptr;
+
+	/**
+	 * Create an empty table.
+	 *
+	 * @param queue The queue hibernated documents are saved on.
+	 * @param idle_timeout How long a document without clients stays open.
+	 * @param directory The directory holding the documents.
+	 * @param catalog The catalog of the directory, if any.
+	 */
+	explicit DocumentManager(SaveQueue &queue,
+	                         clock::duration idle_timeout = std::chrono::minutes(5),
+	                         std::string const &directory = Document::get_directory(),
+	                         DocumentCatalog *catalog = 0);
+
+	/**
+	 * Save and close all open documents.
+	 */
+	~DocumentManager();
+
+	/**
+	 * Delete the default copy constructor, making copying a table impossible.
+	 */
+	DocumentManager(DocumentManager const &) = delete;
+
+	/**
+	 * Delete the default assignment operator, making assigning a table
+	 * impossible.
+	 */
+	DocumentManager &operator=(DocumentManager const &) = delete;
+
+	/**
+	 * Create a document and add it to the table.
+	 *
+	 * @param name The name of the document, without directory.
+	 * @return The document.
+	 * @throws DocumentNameError If the name isn't a plain file name.
+	 * @throws DocumentAlreadyExistsError If the document exists.
+	 * @throws DocumentError If creating fails for other reasons.
+	 */
+	document_ptr create(std::string const &name);
+
+	/**
+	 * Create a document as a copy of another one and add it to the table,
+	 * see Document::clone.
+	 *
+	 * @param source The document to copy.
+	 * @param name The name of the clone, without directory.
+	 * @return The clone.
+	 * @throws DocumentNameError If the name isn't a plain file name.
+	 * @throws DocumentAlreadyExistsError If the document exists.
+	 * @throws DocumentError If creating or copying fails for other reasons.
+	 */
+	document_ptr clone(Document const &source, std::string const &name);
+
+	/**
+	 * Obtain the shared instance of a document, opening it if necessary.
+	 *
+	 * @param name The name of the document, without directory.
+	 * @return The document.
+	 * @throws DocumentNameError If the name isn't a plain file name.
+	 * @throws DocumentDoesntExistError If the document doesn't exist.
+	 * @throws DocumentError If opening fails for other reasons.
+	 */
+	document_ptr open(std::string const &name);
+
+	/**
+	 * Obtain the shared instance of a document by id, opening it again if
+	 * it was hibernated.
+	 *
+	 * @param id The id of the document.
+	 * @return The document or a null pointer if the id is unknown.
+	 * @throws DocumentError If opening fails.
+	 */
+	document_ptr find(std::int32_t id);
+
+	/**
+	 * Remove a document physically and from the table.
+	 *
+	 * @param name The name of the document, without directory.
+	 * @throws DocumentNameError If the name isn't a plain file name.
+	 * @throws DocumentDoesntExistError If the document doesn't exist.
+	 * @throws DocumentError If removing fails for other reasons.
+	 */
+	void remove(std::string const &name);
+
+	/**
+	 * Note that a client started working on a document, which keeps it open.
+	 *
+	 * @param id The id of the document, unknown ids are ignored.
+	 */
+	void acquire(std::int32_t id);
+
+	/**
+	 * Note that a client stopped working on a document.
+	 *
+	 * @param id The id of the document, unknown ids are ignored.
+	 */
+	void release(std::int32_t id);
+
+	/**
+	 * Hibernate the documents which have been without clients for longer
+	 * than the idle timeout, least recently used first.
+	 *
+	 * @param now The current time.
+	 * @return The number of hibernated documents.
+	 */
+	std::size_t hibernate(clock::time_point now = clock::now());
+
+	/**
+	 * Obtain the number of documents in memory, including those still being
+	 * saved for hibernation.
+	 */
+	std::size_t resident() const;
+
+private:
+	struct Entry
+	{
+		std::string name;
+		// null while hibernated
+		document_ptr document;
+		std::size_t clients;
+		clock::time_point idle_since;
+		// position in idle_ while resident without clients
+		std::list<std::int32_t>::iterator idle_position;
+		bool idle;
+	};
+
+	/**
+	 * Obtain the path of a document within its shard.
+	 *
+	 * @throws DocumentNameError If the name isn't a plain file name or names
+	 *                           a file belonging to the storage of a document.
+	 */
+	std::string path_of(std::string const &name) const;
+
+	/**
+	 * Add an opened document to the table, without clients.
+	 */
+	document_ptr add(std::string const &name, document_ptr document);
+
+	/**
+	 * Move a document to the end of the idle list, or take it off.
+	 */
+	void set_idle(Entry &entry, std::int32_t id, bool idle);
+
+	/**
+	 * Obtain the catalog id of a document.
+	 *
+	 * @throws DocumentError If the catalog can't be accessed.
+	 */
+	std::int32_t catalog_id(std::string const &name);
+
+	/**
+	 * Tell the catalog about a document which is on disk as it is in memory.
+	 */
+	void catalog(std::string const &name, Document const &document);
+
+	SaveQueue &queue_;
+	clock::duration const idle_timeout_;
+	std::string const directory_;
+	DocumentCatalog *const catalog_;
+	std::unordered_map<std::string, std::int32_t> ids_;
+	std::unordered_map<std::int32_t, Entry> entries_;
+	// resident documents without clients, least recently used first
+	std::list<std::int32_t> idle_;
+	// hibernated documents whose save didn't finish yet
+	std::unordered_map<std::int32_t, document_ptr> saving_;
+};
+
+#endif
@@ -0,0 +1,44 @@
+#include "DocumentStorage.h"
+
+/**
+ * @file DocumentStorage.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for common abstractions of document storages.
+ */
+
+DocumentStorage::~DocumentStorage()
+{
+}
+
+bool DocumentStorage::load_indexes(ChunkTree &, LineIndex &)
+{
+	return false;
+}
+
+bool DocumentStorage::keeps_indexes() const
+{
+	return false;
+}
+
+void DocumentStorage::store_indexes(ChunkTree const &, LineIndex const &)
+{
+}
+
+int DocumentStorage::contents_file(std::size_t &)
+{
+	return -1;
+}
+
+void DocumentStorage::inserted(std::size_t, char const *, std::size_t)
+{
+}
+
+void DocumentStorage::erased(std::size_t, std::size_t)
+{
+}
+
+void DocumentStorage::save(Rope &contents)
+{
+	prepare_save(contents)();
+}
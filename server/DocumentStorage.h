@@ -0,0 +1,139 @@
+#ifndef DOCUMENTSTORAGE_H_INCLUDED
+#define DOCUMENTSTORAGE_H_INCLUDED
+
+#include "ChunkTree.h"
+#include "LineIndex.h"
+#include "Rope.h"
+
+#include <cstddef>
+#include <functional>
+
+/**
+ * @file DocumentStorage.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Interface for the ways a document is kept on disk.
+ */
+
+class DocumentStorage
+{
+public:
+	DocumentStorage() = default;
+
+	/**
+	 * Release all resources, doesn't save anything.
+	 */
+	virtual ~DocumentStorage();
+
+	/**
+	 * Delete the default copy constructor, making copying a storage
+	 * object impossible.
+	 */
+	DocumentStorage(DocumentStorage const &) = delete;
+
+	/**
+	 * Delete the default assignment operator, making assigning a storage
+	 * object impossible.
+	 */
+	DocumentStorage &operator=(DocumentStorage const &) = delete;
+
+	/**
+	 * Bring the stored contents into memory.
+	 *
+	 * @return The contents.
+	 * @throws document_errors::DocumentError If the contents can't be loaded.
+	 */
+	virtual Rope load() = 0;
+
+	/**
+	 * Obtain the indexes of the loaded contents, if the storage keeps them
+	 * along with the contents.
+	 *
+	 * @param chunks Receives the chunk tree of the contents.
+	 * @param lines Receives the line index of the contents.
+	 * @return False if the storage doesn't keep indexes, they have to be
+	 *         built from the contents then.
+	 */
+	virtual bool load_indexes(ChunkTree &chunks, LineIndex &lines);
+
+	/**
+	 * Check if the storage keeps the indexes along with the contents.
+	 */
+	virtual bool keeps_indexes() const;
+
+	/**
+	 * Pass the indexes of the contents stored by the next prepared save,
+	 * called before prepare_save if the storage keeps indexes.
+	 *
+	 * @param chunks The chunk tree of the contents.
+	 * @param lines The line index of the contents.
+	 */
+	virtual void store_indexes(ChunkTree const &chunks, LineIndex const &lines);
+
+	/**
+	 * Obtain the file holding the contents as last loaded or stored, if
+	 * they are kept there as they are.
+	 *
+	 * @param offset Receives the offset of the contents in the file.
+	 * @return The descriptor of the file, -1 if there is none.
+	 */
+	virtual int contents_file(std::size_t &offset);
+
+	/**
+	 * Called after bytes were inserted into the contents.
+	 *
+	 * @param offset The offset the bytes were inserted at.
+	 * @param bytes The first inserted byte.
+	 * @param length The number of inserted bytes.
+	 */
+	virtual void inserted(std::size_t offset, char const *bytes, std::size_t length);
+
+	/**
+	 * Called after bytes were erased from the contents.
+	 *
+	 * @param offset The offset of the first erased byte.
+	 * @param length The number of erased bytes.
+	 */
+	virtual void erased(std::size_t offset, std::size_t length);
+
+	/**
+	 * Prepare storing the contents, on the thread editing them.
+	 *
+	 * The returned job stores a snapshot of the contents and may run on
+	 * another thread while editing continues. Jobs of one storage have to
+	 * run one after another in the order they were prepared, and the
+	 * storage must not be used otherwise until they finished.
+	 *
+	 * @param contents The contents to store. The storage may replace them
+	 *                 by an equal rope.
+	 * @return The job storing the snapshot.
+	 * @throws document_errors::DocumentError If preparing fails.
+	 */
+	virtual std::function<void()> prepare_save(Rope &contents) = 0;
+
+	/**
+	 * Store the contents, by running the prepared job right away.
+	 *
+	 * @param contents The contents to store. The storage may replace them
+	 *                 by an equal rope which refers to the stored data.
+	 * @throws document_errors::DocumentError If not all data could be stored.
+	 */
+	virtual void save(Rope &contents);
+
+	/**
+	 * Remove everything stored for the document.
+	 *
+	 * @throws document_errors::DocumentDoesntExistError If the document doesn't exist.
+	 * @throws document_errors::DocumentPermissionsError If the remover lacks sufficient
+	 *                                                   permissions.
+	 * @throws document_errors::DocumentError If removing fails for other reasons.
+	 */
+	virtual void remove() = 0;
+
+	/**
+	 * Release the files of the storage.
+	 */
+	virtual void close() = 0;
+};
+
+#endif
@@ -0,0 +1,280 @@
+#include "FileStorage.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * @file FileStorage.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the plain document storage.
+ */
+
+namespace
+{
+	/**
+	 * A read-only private mapping of a whole file.
+	 */
+	class MappedBuffer
+		: public Rope::Buffer
+	{
+	public:
+		MappedBuffer(void *address, std::size_t size)
+			: address_(address),
+			  size_(size)
+		{
+		}
+
+		~MappedBuffer()
+		{
+			::munmap(address_, size_);
+		}
+
+		char const *data() const
+		{
+			return static_cast<char const *>(address_);
+		}
+
+		std::size_t size() const
+		{
+			return size_;
+		}
+
+	private:
+		void *const address_;
+		std::size_t const size_;
+	};
+
+	std::string describe_errno(std::string const &action, std::string const &name)
+	{
+		std::ostringstream strm;
+
+		strm << "while " << action << " document <" << name << ">: " << std::strerror(errno);
+
+		return strm.str();
+	}
+}
+
+using namespace document_errors;
+
+FileStorage::FileStorage(int fd, std::string const &name, Document::OpenMode mode)
+	: name_(name),
+	  mode_(mode),
+	  fd_(fd),
+	  closed_(false)
+{
+}
+
+FileStorage::~FileStorage()
+{
+	FileStorage::close();
+}
+
+Rope FileStorage::load()
+{
+	return read_contents(fd_, mode_);
+}
+
+std::function<void()> FileStorage::prepare_save(Rope &contents)
+{
+	Rope const snapshot = contents;
+
+	return [this, snapshot]()
+	{
+		/* never write into the current file, mapped pieces of the contents
+		 * still refer to it
+		 */
+		std::string const temporary_name = name_ + ".tmp";
+
+		replace(write_temporary(snapshot, temporary_name), temporary_name);
+	};
+}
+
+void FileStorage::save(Rope &contents)
+{
+	DocumentStorage::save(contents);
+
+	// drop the copies of modified regions and map the saved file instead
+	if (mode_ == Document::OpenMode::mapped)
+	{
+		contents = read_contents(fd_, mode_);
+	}
+}
+
+int FileStorage::contents_file(std::size_t &offset)
+{
+	offset = 0;
+
+	return closed_ ? -1 : fd_;
+}
+
+void FileStorage::remove()
+{
+	int const result = ::unlink(name_.c_str());
+
+	if (result)
+	{
+		std::ostringstream strm;
+
+		strm << "while removing document <" << name_ << ">: ";
+
+		if (errno == ENOENT)
+		{
+			strm << "document does not exist";
+
+			throw DocumentDoesntExistError(strm.str());
+		}
+
+		if (errno == EACCES || errno == EROFS)
+		{
+			strm << "insufficient permissions to delete document";
+
+			throw DocumentPermissionsError(strm.str());
+		}
+
+		strm << std::strerror(errno);
+
+		throw DocumentError(strm.str());
+	}
+}
+
+void FileStorage::close()
+{
+	if (!closed_)
+	{
+		::close(fd_);
+		closed_ = true;
+	}
+}
+
+Rope FileStorage::read_contents(int fd, Document::OpenMode mode)
+{
+	struct ::stat status;
+
+	if (::fstat(fd, &status))
+	{
+		// should only fail if file too large
+		if (errno == EOVERFLOW)
+		{
+			throw DocumentError("file too big");
+		}
+
+		throw DocumentError(std::strerror(errno));
+	}
+
+	std::size_t const size = status.st_size;
+
+	if (!size)
+	{
+		return Rope();
+	}
+
+	if (mode == Document::OpenMode::mapped)
+	{
+		void *const address = ::mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (address == MAP_FAILED)
+		{
+			throw DocumentError(std::strerror(errno));
+		}
+
+		return Rope(std::make_shared<MappedBuffer>(address, size));
+	}
+
+	std::vector<char> bytes(size);
+
+	ssize_t const read_result = ::pread(fd, bytes.data(), size, 0);
+
+	if (read_result < 0 || static_cast<std::size_t>(read_result) != size)
+	{
+		throw DocumentError("unable to read all data from file");
+	}
+
+	return Rope(Rope::make_buffer(std::move(bytes)));
+}
+
+void FileStorage::write_all(int fd, char const *bytes, std::size_t size)
+{
+	while (size)
+	{
+		ssize_t const write_result = ::write(fd, bytes, size);
+
+		if (write_result < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			throw DocumentError("unable to write all data to file");
+		}
+
+		bytes += write_result;
+		size -= write_result;
+	}
+}
+
+int FileStorage::write_temporary(Rope const &contents, std::string const &temporary_name,
+                                 std::vector<char> const &header) const
+{
+	int const fd = ::open(temporary_name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+
+	if (fd < 0)
+	{
+		throw DocumentError(describe_errno("saving", name_));
+	}
+
+	try
+	{
+		struct ::stat status;
+
+		// keep the permissions of the document
+		if (::fstat(fd_, &status) == 0)
+		{
+			::fchmod(fd, status.st_mode & 07777);
+		}
+
+		write_all(fd, header.data(), header.size());
+		contents.for_each_span(
+			[fd](char const *bytes, std::size_t size)
+			{
+				write_all(fd, bytes, size);
+			});
+
+		if (::fsync(fd))
+		{
+			throw DocumentError(describe_errno("saving", name_));
+		}
+	}
+	catch (...)
+	{
+		::close(fd);
+		::unlink(temporary_name.c_str());
+		throw;
+	}
+
+	return fd;
+}
+
+void FileStorage::replace(int fd, std::string const &temporary_name)
+{
+	if (::rename(temporary_name.c_str(), name_.c_str()))
+	{
+		std::string const message = describe_errno("saving", name_);
+
+		::close(fd);
+		::unlink(temporary_name.c_str());
+
+		throw DocumentError(message);
+	}
+
+	::close(fd_);
+	fd_ = fd;
+}
@@ -0,0 +1,100 @@
+#ifndef FILESTORAGE_H_INCLUDED
+#define FILESTORAGE_H_INCLUDED
+
+#include "Document.h"
+#include "DocumentStorage.h"
+
+#include <string>
+#include <vector>
+
+/**
+ * @file FileStorage.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * The plain storage: the document is one file holding the contents, every
+ * save rewrites it completely.
+ */
+
+class FileStorage
+	: public DocumentStorage
+{
+public:
+	/**
+	 * Construct the storage for an opened document file.
+	 *
+	 * @param fd The readable descriptor of the document file, the storage
+	 *           takes ownership.
+	 * @param name The path of the document file.
+	 * @param mode How the contents are brought into memory.
+	 */
+	FileStorage(int fd, std::string const &name, Document::OpenMode mode);
+
+	/**
+	 * Close the document file.
+	 */
+	~FileStorage();
+
+	Rope load();
+
+	/**
+	 * The job writes the contents to a temporary file which then replaces
+	 * the document, so mapped regions of the previous file stay intact.
+	 */
+	std::function<void()> prepare_save(Rope &contents);
+
+	/**
+	 * Save and map the written file instead of the previous one.
+	 */
+	void save(Rope &contents);
+
+	int contents_file(std::size_t &offset);
+
+	void remove();
+	void close();
+
+protected:
+	/**
+	 * Bring the contents of a file into a rope.
+	 *
+	 * @param fd The readable descriptor of the file.
+	 * @param mode How the contents are brought into memory.
+	 * @return The rope holding the contents.
+	 * @throws DocumentError If reading or mapping fails.
+	 */
+	static Rope read_contents(int fd, Document::OpenMode mode);
+
+	/**
+	 * Write bytes to a file, continuing after partial writes.
+	 *
+	 * @throws DocumentError If not all data could be written.
+	 */
+	static void write_all(int fd, char const *bytes, std::size_t size);
+
+	/**
+	 * Write the contents to a new file next to the document and sync it.
+	 *
+	 * @param contents The contents to write.
+	 * @param temporary_name The path of the new file.
+	 * @param header Bytes written in front of the contents.
+	 * @return The descriptor of the written file.
+	 * @throws DocumentError If not all data could be written.
+	 */
+	int write_temporary(Rope const &contents, std::string const &temporary_name,
+	                    std::vector<char> const &header = std::vector<char>()) const;
+
+	/**
+	 * Replace the document file by a file written with write_temporary.
+	 *
+	 * @param fd The descriptor of the written file, the storage takes ownership.
+	 * @param temporary_name The path of the written file.
+	 * @throws DocumentError If renaming fails.
+	 */
+	void replace(int fd, std::string const &temporary_name);
+
+	std::string const name_;
+	Document::OpenMode const mode_;
+	int fd_;
+	bool closed_;
+};
+
+#endif
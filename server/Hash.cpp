@@ -2,6 +2,7 @@
 
 #include <openssl/sha.h>
 
+#include <new>
 #include <sstream>
 
 namespace hash_errors
@@ -12,14 +13,53 @@ namespace hash_errors
 	}
 }
 
+Hash::Builder::Builder()
+	: context_(::EVP_MD_CTX_new())
+{
+	if (!context_)
+	{
+		throw std::bad_alloc();
+	}
+
+	// should never fail
+	::EVP_DigestInit_ex(context_, ::EVP_sha1(), 0);
+}
+
+Hash::Builder::~Builder()
+{
+	::EVP_MD_CTX_free(context_);
+}
+
+void Hash::Builder::update(char const *bytes, std::size_t size)
+{
+	// should never fail
+	::EVP_DigestUpdate(context_, bytes, size);
+}
+
+Hash::hash_t Hash::Builder::finish()
+{
+	hash_t sha1_hash;
+
+	// should never fail
+	::EVP_DigestFinal_ex(context_, reinterpret_cast<unsigned char *>(&sha1_hash[0]), 0);
+	::EVP_DigestInit_ex(context_, ::EVP_sha1(), 0);
+
+	return sha1_hash;
+}
+
 Hash::hash_t Hash::hash_bytes(std::vector<char> const &bytes)
+{
+	return hash_bytes(bytes.data(), bytes.size());
+}
+
+Hash::hash_t Hash::hash_bytes(char const *bytes, std::size_t size)
 {
 	hash_t sha1_hash;
 
 	// should never fail
 	::SHA1(
-		reinterpret_cast<unsigned char const *>(&bytes[0]),
-		bytes.size(),
+		reinterpret_cast<unsigned char const *>(bytes),
+		size,
 		reinterpret_cast<unsigned char *>(&sha1_hash[0]));
 
 	return sha1_hash;
@@ -1,7 +1,10 @@
 #ifndef HASH_H_INCLUDED
 #define HASH_H_INCLUDED
 
+#include <openssl/evp.h>
+
 #include <array>
+#include <cstddef>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -20,6 +23,39 @@ class Hash
 public:
 	typedef std::array<char, 20> hash_t;
 
+	/**
+	 * Create a hash over a sequence of byte spans without
+	 * joining them first.
+	 */
+	class Builder
+	{
+	public:
+		Builder();
+		~Builder();
+
+		Builder(Builder const &) = delete;
+		Builder &operator=(Builder const &) = delete;
+
+		/**
+		 * Feed the next span of bytes.
+		 *
+		 * @param bytes The first byte of the span.
+		 * @param size The number of bytes in the span.
+		 */
+		void update(char const *bytes, std::size_t size);
+
+		/**
+		 * Obtain the hash of all spans fed so far. The builder starts
+		 * over afterwards.
+		 *
+		 * @return The hash sequence for the fed spans.
+		 */
+		hash_t finish();
+
+	private:
+		::EVP_MD_CTX *context_;
+	};
+
 	/**
 	 * Create a hash for the specificied byte sequence.
 	 *
@@ -28,6 +64,15 @@ public:
 	 */
 	static hash_t hash_bytes(std::vector<char> const &bytes);
 
+	/**
+	 * Create a hash for the specificied byte sequence.
+	 *
+	 * @param bytes The first byte of the data input for the hash algorithm.
+	 * @param size The number of bytes.
+	 * @return The hash sequence for the specified bytes.
+	 */
+	static hash_t hash_bytes(char const *bytes, std::size_t size);
+
 	/**
 	 * Convert a raw hash bytestream to hexadecimal represented string.
 	 *
@@ -0,0 +1,210 @@
+#include "InPlaceStorage.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * @file InPlaceStorage.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the in-place document storage.
+ */
+
+namespace
+{
+	std::string describe_errno(std::string const &action, std::string const &name)
+	{
+		std::ostringstream strm;
+
+		strm << "while " << action << " document <" << name << ">: " << std::strerror(errno);
+
+		return strm.str();
+	}
+
+	void pwrite_all(int fd, char const *bytes, std::size_t size, std::size_t offset)
+	{
+		while (size)
+		{
+			ssize_t const write_result = ::pwrite(fd, bytes, size, offset);
+
+			if (write_result < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+
+				throw document_errors::DocumentError("unable to write all data to file");
+			}
+
+			bytes += write_result;
+			size -= write_result;
+			offset += write_result;
+		}
+	}
+}
+
+using namespace document_errors;
+
+InPlaceStorage::InPlaceStorage(int fd, std::string const &name, Document::OpenMode)
+	/* saving writes into the file, which would change the pages mapped
+	 * by pinned versions and cut them off when truncating, so the contents
+	 * always live on the heap
+	 */
+	: FileStorage(fd, name, Document::OpenMode::read)
+{
+	int const writable_fd = ::open(name_.c_str(), O_RDWR);
+
+	if (writable_fd < 0)
+	{
+		std::ostringstream strm;
+
+		strm << "while opening document <" << name_ << "> for writing: ";
+
+		if (errno == EACCES || errno == EROFS)
+		{
+			strm << "insufficient permissions to write document";
+
+			throw DocumentPermissionsError(strm.str());
+		}
+
+		strm << std::strerror(errno);
+
+		throw DocumentError(strm.str());
+	}
+
+	::close(fd_);
+	fd_ = writable_fd;
+}
+
+Rope InPlaceStorage::load()
+{
+	stored_ = read_contents(fd_, mode_);
+	file_size_ = stored_.size();
+	failed_ = false;
+
+	return stored_;
+}
+
+std::function<void()> InPlaceStorage::prepare_save(Rope &contents)
+{
+	std::vector<Range> const ranges = dirty_ranges(contents, stored_);
+	Rope const snapshot = contents;
+
+	/* jobs run in order, so the next save only has to write what changed
+	 * since this snapshot, whether it's saved in the background or not
+	 */
+	stored_ = snapshot;
+
+	return [this, ranges, snapshot]()
+	{
+		write(ranges, snapshot);
+	};
+}
+
+void InPlaceStorage::write(std::vector<Range> const &ranges, Rope const &snapshot)
+{
+	// after a failed job the file is unknown, rewrite it as a whole
+	bool const rewrite = failed_;
+	std::vector<Range> const whole { Range { 0, snapshot.size() } };
+
+	failed_ = true;
+
+	for (auto const &range: rewrite ? whole : ranges)
+	{
+		std::size_t offset = range.offset;
+
+		snapshot.for_each_span(range.offset, range.length,
+			[this, &offset](char const *bytes, std::size_t size)
+			{
+				pwrite_all(fd_, bytes, size, offset);
+				offset += size;
+			});
+	}
+
+	if (((rewrite || snapshot.size() != file_size_) && ::ftruncate(fd_, snapshot.size()))
+		|| ::fdatasync(fd_))
+	{
+		throw DocumentError(describe_errno("saving", name_));
+	}
+
+	file_size_ = snapshot.size();
+	failed_ = false;
+}
+
+std::vector<InPlaceStorage::Range> InPlaceStorage::dirty_ranges(Rope const &contents,
+                                                               Rope const &stored)
+{
+	struct Span
+	{
+		std::size_t position;
+		char const *bytes;
+		std::size_t size;
+	};
+
+	std::vector<Span> stored_spans;
+	std::vector<Range> ranges;
+	std::size_t position = 0;
+
+	stored.for_each_span(
+		[&stored_spans, &position](char const *bytes, std::size_t size)
+		{
+			stored_spans.push_back(Span { position, bytes, size });
+			position += size;
+		});
+
+	// both ropes are walked front to back, the stored span only moves on
+	std::vector<Span>::const_iterator span = stored_spans.begin();
+	position = 0;
+
+	contents.for_each_span(
+		[&](char const *bytes, std::size_t size)
+		{
+			// clean if the stored bytes at the same offsets are the very same bytes
+			bool clean = true;
+
+			for (std::size_t covered = 0; covered < size && clean; )
+			{
+				while (span != stored_spans.end()
+					&& span->position + span->size <= position + covered)
+				{
+					++span;
+				}
+
+				if (span == stored_spans.end())
+				{
+					clean = false;
+					break;
+				}
+
+				std::size_t const within = position + covered - span->position;
+
+				clean = span->bytes + within == bytes + covered;
+				covered += std::min(span->size - within, size - covered);
+			}
+
+			if (!clean)
+			{
+				if (!ranges.empty()
+					&& ranges.back().offset + ranges.back().length == position)
+				{
+					ranges.back().length += size;
+				}
+				else
+				{
+					ranges.push_back(Range { position, size });
+				}
+			}
+
+			position += size;
+		});
+
+	return ranges;
+}
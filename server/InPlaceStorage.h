@@ -0,0 +1,99 @@
+#ifndef INPLACESTORAGE_H_INCLUDED
+#define INPLACESTORAGE_H_INCLUDED
+
+#include "FileStorage.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @file InPlaceStorage.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * The in-place storage: saving writes only the byte ranges which differ
+ * from the document file and truncates it to the new size.
+ *
+ * The changed ranges follow from the pieces of the contents: a byte is
+ * unchanged if it still refers to the same byte as the contents last saved
+ * or loaded at its own offset. So an edit in the middle dirties the edited
+ * bytes plus, if the length changed, the shifted tail, while erasing and
+ * inserting the same number of bytes leaves the tail clean. This holds for
+ * saves in the background as well, each one only writes what changed since
+ * the one before.
+ *
+ * Unlike the other storages a save isn't atomic, a crash while saving may
+ * leave a mixture of both versions behind. The contents are never mapped:
+ * saving writes into the file, which mapped versions still pinned by
+ * readers would share.
+ */
+
+class InPlaceStorage
+	: public FileStorage
+{
+public:
+	/**
+	 * A range of bytes.
+	 */
+	struct Range
+	{
+		std::size_t offset;
+		std::size_t length;
+	};
+
+	/**
+	 * Construct the storage for an opened document file, which gets
+	 * reopened for writing.
+	 *
+	 * @param fd The readable descriptor of the document file, the storage
+	 *           takes ownership.
+	 * @param name The path of the document file.
+	 * @param mode Ignored, the contents are always read onto the heap.
+	 * @throws DocumentPermissionsError If the file isn't writable.
+	 * @throws DocumentError If reopening fails for other reasons.
+	 */
+	InPlaceStorage(int fd, std::string const &name, Document::OpenMode mode);
+
+	Rope load();
+
+	/**
+	 * Find the changed ranges of the contents, the job writes them into
+	 * the document file.
+	 */
+	std::function<void()> prepare_save(Rope &contents);
+
+	/**
+	 * Find the ranges of the contents which don't refer to the stored bytes
+	 * at the same offset.
+	 *
+	 * @param contents The contents.
+	 * @param stored The stored bytes, the contents as loaded or last saved.
+	 * @return The changed ranges in ascending order, adjacent ranges are
+	 *         merged.
+	 */
+	static std::vector<Range> dirty_ranges(Rope const &contents, Rope const &stored);
+
+private:
+	/**
+	 * Write ranges of a snapshot into the document file, runs as save job.
+	 *
+	 * @param ranges The changed ranges.
+	 * @param snapshot The contents to store.
+	 */
+	void write(std::vector<Range> const &ranges, Rope const &snapshot);
+
+	// the size of the document file, only touched by save jobs
+	std::size_t file_size_;
+
+	// whether the last job failed, only touched by save jobs
+	bool failed_;
+
+	/* the contents the file holds once the queued jobs are done. Keeps the
+	 * buffers of the stored bytes alive, so no other buffer can take their
+	 * addresses: pieces still referring to them at the same offsets match
+	 * the file.
+	 */
+	Rope stored_;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "IndexedStorage.h"
+
+#include <sstream>
+
+/**
+ * @file IndexedStorage.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the base of the storages keeping indexes.
+ */
+
+IndexedStorage::IndexedStorage(int fd, std::string const &name, Document::OpenMode mode)
+	: FileStorage(fd, name, mode),
+	  loaded_(false)
+{
+}
+
+bool IndexedStorage::load_indexes(ChunkTree &chunks, LineIndex &lines)
+{
+	if (!loaded_)
+	{
+		return false;
+	}
+
+	chunks = loaded_chunks_;
+	lines = loaded_lines_;
+
+	// edits change the document's copies, these would only pin the loaded nodes
+	loaded_chunks_ = ChunkTree();
+	loaded_lines_ = LineIndex();
+	loaded_ = false;
+
+	return true;
+}
+
+bool IndexedStorage::keeps_indexes() const
+{
+	return true;
+}
+
+void IndexedStorage::store_indexes(ChunkTree const &chunks, LineIndex const &lines)
+{
+	// both trees are persistent, the copies share all their nodes
+	chunks_ = chunks;
+	lines_ = lines;
+}
+
+void IndexedStorage::keep_loaded(ChunkTree const &chunks, LineIndex const &lines)
+{
+	loaded_chunks_ = chunks;
+	loaded_lines_ = lines;
+	loaded_ = true;
+}
+
+void IndexedStorage::append(std::vector<char> &bytes, std::uint64_t value, std::size_t size)
+{
+	for (std::size_t i = size; i--; )
+	{
+		bytes.push_back(static_cast<char>(value >> (8 * i)));
+	}
+}
+
+std::uint64_t IndexedStorage::extract(std::vector<char> const &bytes, std::size_t &position,
+                                      std::size_t size)
+{
+	std::uint64_t value = 0;
+
+	for (std::size_t i = 0; i < size; i++)
+	{
+		value = (value << 8) | static_cast<unsigned char>(bytes[position++]);
+	}
+
+	return value;
+}
+
+std::string IndexedStorage::describe_damage(std::string const &name, std::string const &reason)
+{
+	std::ostringstream strm;
+
+	strm << "while loading document <" << name << ">: " << reason;
+
+	return strm.str();
+}
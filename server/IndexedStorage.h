@@ -0,0 +1,86 @@
+#ifndef INDEXEDSTORAGE_H_INCLUDED
+#define INDEXEDSTORAGE_H_INCLUDED
+
+#include "FileStorage.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @file IndexedStorage.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Base of the storages which keep the chunk tree and the line index along
+ * with the contents, so a loaded document needn't scan its contents to
+ * build them. Their files start with headers of big endian numbers.
+ */
+
+class IndexedStorage
+	: public FileStorage
+{
+public:
+	/**
+	 * Hand the indexes read by load() to the document, once.
+	 */
+	bool load_indexes(ChunkTree &chunks, LineIndex &lines);
+
+	bool keeps_indexes() const;
+	void store_indexes(ChunkTree const &chunks, LineIndex const &lines);
+
+protected:
+	/**
+	 * @see FileStorage::FileStorage
+	 */
+	IndexedStorage(int fd, std::string const &name, Document::OpenMode mode);
+
+	/**
+	 * Keep the indexes read by load() until the document asks for them.
+	 *
+	 * @param chunks The chunk tree of the loaded contents.
+	 * @param lines The line index of the loaded contents.
+	 */
+	void keep_loaded(ChunkTree const &chunks, LineIndex const &lines);
+
+	/**
+	 * Append a big endian number to a header.
+	 *
+	 * @param bytes The header.
+	 * @param value The number.
+	 * @param size The number of bytes the number takes.
+	 */
+	static void append(std::vector<char> &bytes, std::uint64_t value, std::size_t size);
+
+	/**
+	 * Read a big endian number from a header.
+	 *
+	 * @param bytes The header.
+	 * @param position The offset of the number, moved behind it.
+	 * @param size The number of bytes the number takes.
+	 * @return The number.
+	 */
+	static std::uint64_t extract(std::vector<char> const &bytes, std::size_t &position,
+	                             std::size_t size);
+
+	/**
+	 * Describe why a document file can't be loaded.
+	 *
+	 * @param name The path of the document file.
+	 * @param reason What is wrong with it.
+	 * @return The message of the DocumentError to throw.
+	 */
+	static std::string describe_damage(std::string const &name, std::string const &reason);
+
+	// the indexes for the next prepared save
+	ChunkTree chunks_;
+	LineIndex lines_;
+
+private:
+	// the indexes read by load() until they are handed to the document
+	ChunkTree loaded_chunks_;
+	LineIndex loaded_lines_;
+	bool loaded_;
+};
+
+#endif
@@ -0,0 +1,485 @@
+#include "JournalStorage.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+/**
+ * @file JournalStorage.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the journaled document storage.
+ */
+
+namespace
+{
+	char const g_magic[4] = { 'C', 'T', 'E', 'J' };
+	std::size_t const g_header_size = sizeof(g_magic) + 8;
+	std::size_t const g_number_size = 8;
+	std::size_t const g_record_size = 1 + 2 * g_number_size;
+
+	void put_number(std::vector<char> &bytes, std::uint64_t number)
+	{
+		std::uint32_t const parts[2] = {
+			htonl(static_cast<std::uint32_t>(number >> 32)),
+			htonl(static_cast<std::uint32_t>(number))
+		};
+		char const *const begin = reinterpret_cast<char const *>(parts);
+
+		bytes.insert(bytes.end(), begin, begin + sizeof(parts));
+	}
+
+	std::uint64_t get_number(char const *bytes)
+	{
+		std::uint32_t parts[2];
+
+		std::memcpy(parts, bytes, sizeof(parts));
+
+		return static_cast<std::uint64_t>(ntohl(parts[0])) << 32 | ntohl(parts[1]);
+	}
+
+	std::string describe_errno(std::string const &action, std::string const &name)
+	{
+		std::ostringstream strm;
+
+		strm << "while " << action << " journal <" << name << ">: " << std::strerror(errno);
+
+		return strm.str();
+	}
+
+	std::uint64_t inode_of(int fd, std::string const &name)
+	{
+		struct ::stat status;
+
+		if (::fstat(fd, &status))
+		{
+			throw document_errors::DocumentError(describe_errno("inspecting", name));
+		}
+
+		return status.st_ino;
+	}
+
+	void truncate_to(int fd, std::uint64_t size)
+	{
+		// only called while handling another error, which is reported instead
+		if (::ftruncate(fd, size))
+		{
+		}
+	}
+
+	void read_all(int fd, char *bytes, std::size_t size, std::uint64_t offset)
+	{
+		while (size)
+		{
+			ssize_t const read_result = ::pread(fd, bytes, size, offset);
+
+			if (read_result < 0 && errno == EINTR)
+			{
+				continue;
+			}
+
+			if (read_result <= 0)
+			{
+				throw document_errors::DocumentError("unable to read all data from journal");
+			}
+
+			bytes += read_result;
+			size -= read_result;
+			offset += read_result;
+		}
+	}
+}
+
+using namespace document_errors;
+
+std::uint64_t const JournalStorage::compaction_threshold;
+
+JournalStorage::JournalStorage(int fd, std::string const &name, Document::OpenMode mode)
+	: FileStorage(fd, name, mode),
+	  journal_name_(journal_name(name)),
+	  journal_fd_(::open(journal_name_.c_str(), O_RDWR | O_APPEND)),
+	  journal_size_(0),
+	  torn_(false),
+	  compacting_(false)
+{
+	struct ::stat status;
+
+	if (journal_fd_ >= 0 && ::fstat(journal_fd_, &status) == 0)
+	{
+		journal_size_ = status.st_size;
+	}
+	else if (journal_fd_ >= 0 || errno != ENOENT)
+	{
+		std::string const message = describe_errno("opening", journal_name_);
+
+		if (journal_fd_ >= 0)
+		{
+			::close(journal_fd_);
+		}
+
+		throw DocumentError(message);
+	}
+}
+
+JournalStorage::~JournalStorage()
+{
+	JournalStorage::close();
+}
+
+std::string JournalStorage::journal_name(std::string const &name)
+{
+	return name + ".journal";
+}
+
+Rope JournalStorage::load()
+{
+	Rope contents = read_contents(fd_, mode_);
+
+	// no journal yet, or its creation was interrupted
+	if (journal_size_ < g_header_size)
+	{
+		return contents;
+	}
+
+	std::uint64_t const inode = inode_of(fd_, name_);
+	std::vector<char> journal(journal_size_);
+
+	read_all(journal_fd_, journal.data(), journal.size(), 0);
+
+	if (std::memcmp(journal.data(), g_magic, sizeof(g_magic)))
+	{
+		throw DocumentError("journal <" + journal_name_ + "> is corrupt");
+	}
+
+	// find the end of the last complete record and where replaying starts
+	bool const current = get_number(journal.data() + sizeof(g_magic)) == inode;
+	std::size_t start = current ? g_header_size : 0;
+	std::size_t end = g_header_size;
+
+	while (end + g_record_size <= journal.size())
+	{
+		char const type = journal[end];
+		std::uint64_t const first = get_number(&journal[end + 1]);
+		std::uint64_t const second = get_number(&journal[end + 1 + g_number_size]);
+		std::size_t next = end + g_record_size;
+
+		if (type == 'I')
+		{
+			if (second > journal.size() - next)
+			{
+				break;
+			}
+
+			next += second;
+		}
+		else if (type == 'K')
+		{
+			// the document file was replaced by a compaction
+			if (!current && first == inode)
+			{
+				start = second;
+			}
+		}
+		else if (type != 'D')
+		{
+			break;
+		}
+
+		end = next;
+	}
+
+	if (!start || start > end)
+	{
+		throw DocumentError("journal <" + journal_name_ + "> doesn't belong to document");
+	}
+
+	try
+	{
+		for (std::size_t position = start; position < end; )
+		{
+			char const type = journal[position];
+			std::uint64_t const offset = get_number(&journal[position + 1]);
+			std::uint64_t const length = get_number(&journal[position + 1 + g_number_size]);
+
+			position += g_record_size;
+
+			if (type == 'I')
+			{
+				contents.insert(offset, journal.data() + position, length);
+				position += length;
+			}
+			else if (type == 'D')
+			{
+				contents.erase(offset, length);
+			}
+		}
+	}
+	catch (rope_errors::OutOfRangeError const &)
+	{
+		throw DocumentError("journal <" + journal_name_ + "> is corrupt");
+	}
+
+	/* what an interrupted save left behind is dropped by the next save,
+	 * loading never modifies the journal
+	 */
+	torn_ = end < journal_size_;
+	journal_size_ = end;
+
+	return contents;
+}
+
+void JournalStorage::inserted(std::size_t offset, char const *bytes, std::size_t length)
+{
+	pending_.push_back('I');
+	put_number(pending_, offset);
+	put_number(pending_, length);
+	pending_.insert(pending_.end(), bytes, bytes + length);
+}
+
+void JournalStorage::erased(std::size_t offset, std::size_t length)
+{
+	pending_.push_back('D');
+	put_number(pending_, offset);
+	put_number(pending_, length);
+}
+
+std::function<void()> JournalStorage::prepare_save(Rope &contents)
+{
+	std::vector<char> records;
+	Rope const snapshot = contents;
+
+	records.swap(pending_);
+
+	return [this, records, snapshot]()
+	{
+		append(records, snapshot);
+	};
+}
+
+void JournalStorage::save(Rope &contents)
+{
+	DocumentStorage::save(contents);
+}
+
+int JournalStorage::contents_file(std::size_t &offset)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	// a compaction replaces the document file
+	if (compacting_ || journal_size_ > g_header_size)
+	{
+		return -1;
+	}
+
+	return FileStorage::contents_file(offset);
+}
+
+void JournalStorage::append(std::vector<char> const &records, Rope const &snapshot)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	unsaved_.insert(unsaved_.end(), records.begin(), records.end());
+
+	if (compaction_error_)
+	{
+		std::exception_ptr const error = compaction_error_;
+
+		compaction_error_ = std::exception_ptr();
+		std::rethrow_exception(error);
+	}
+
+	// the journal is only created once there is something to record
+	if (!unsaved_.empty() && journal_size_ < g_header_size)
+	{
+		write_journal(inode_of(fd_, name_), 0, 0);
+	}
+
+	// a compaction started below appends as well
+	cut_torn_tail();
+
+	if (!unsaved_.empty())
+	{
+		try
+		{
+			write_all(journal_fd_, unsaved_.data(), unsaved_.size());
+
+			if (::fdatasync(journal_fd_))
+			{
+				throw DocumentError(describe_errno("saving", journal_name_));
+			}
+		}
+		catch (...)
+		{
+			// later records must not follow a partial one
+			truncate_to(journal_fd_, journal_size_);
+			throw;
+		}
+
+		journal_size_ += unsaved_.size();
+		unsaved_.clear();
+	}
+
+	if (journal_size_ > compaction_threshold && !compacting_)
+	{
+		join();
+		compacting_ = true;
+		compaction_ = std::thread(&JournalStorage::compact, this, snapshot, journal_size_);
+	}
+}
+
+void JournalStorage::remove()
+{
+	join();
+	FileStorage::remove();
+
+	if (::unlink(journal_name_.c_str()) && errno != ENOENT)
+	{
+		throw DocumentError(describe_errno("removing", journal_name_));
+	}
+}
+
+void JournalStorage::close()
+{
+	join();
+
+	if (journal_fd_ >= 0)
+	{
+		::close(journal_fd_);
+		journal_fd_ = -1;
+	}
+
+	FileStorage::close();
+}
+
+void JournalStorage::compact(Rope snapshot, std::uint64_t position)
+{
+	try
+	{
+		// writing the snapshot is the expensive part and needs no lock
+		std::string const temporary_name = name_ + ".compact";
+		int const fd = write_temporary(snapshot, temporary_name);
+		std::uint64_t inode;
+
+		try
+		{
+			inode = inode_of(fd, temporary_name);
+		}
+		catch (...)
+		{
+			::close(fd);
+			::unlink(temporary_name.c_str());
+			throw;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::vector<char> record(1, 'K');
+
+		put_number(record, inode);
+		put_number(record, position);
+
+		try
+		{
+			// loading stops at a torn record, it would never see this one
+			cut_torn_tail();
+			write_all(journal_fd_, record.data(), record.size());
+
+			if (::fdatasync(journal_fd_))
+			{
+				throw DocumentError(describe_errno("saving", journal_name_));
+			}
+		}
+		catch (...)
+		{
+			truncate_to(journal_fd_, journal_size_);
+			::close(fd);
+			::unlink(temporary_name.c_str());
+			throw;
+		}
+
+		std::vector<char> records(journal_size_ - position);
+
+		journal_size_ += record.size();
+
+		replace(fd, temporary_name);
+
+		// keep the records saved while the snapshot was written
+		read_all(journal_fd_, records.data(), records.size(), position);
+		write_journal(inode, records.data(), records.size());
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		compaction_error_ = std::current_exception();
+	}
+
+	compacting_ = false;
+}
+
+void JournalStorage::cut_torn_tail()
+{
+	if (!torn_)
+	{
+		return;
+	}
+
+	if (::ftruncate(journal_fd_, journal_size_))
+	{
+		throw DocumentError(describe_errno("truncating", journal_name_));
+	}
+
+	torn_ = false;
+}
+
+void JournalStorage::join()
+{
+	if (compaction_.joinable())
+	{
+		compaction_.join();
+	}
+}
+
+void JournalStorage::write_journal(std::uint64_t inode, char const *records, std::size_t size)
+{
+	std::string const temporary_name = journal_name_ + ".tmp";
+	int const fd = ::open(temporary_name.c_str(), O_CREAT | O_RDWR | O_TRUNC | O_APPEND, 0644);
+
+	if (fd < 0)
+	{
+		throw DocumentError(describe_errno("creating", journal_name_));
+	}
+
+	try
+	{
+		std::vector<char> header(g_magic, g_magic + sizeof(g_magic));
+
+		put_number(header, inode);
+		write_all(fd, header.data(), header.size());
+		write_all(fd, records, size);
+
+		if (::fsync(fd) || ::rename(temporary_name.c_str(), journal_name_.c_str()))
+		{
+			throw DocumentError(describe_errno("creating", journal_name_));
+		}
+	}
+	catch (...)
+	{
+		::close(fd);
+		::unlink(temporary_name.c_str());
+		throw;
+	}
+
+	if (journal_fd_ >= 0)
+	{
+		::close(journal_fd_);
+	}
+
+	journal_fd_ = fd;
+	journal_size_ = g_header_size + size;
+}
@@ -0,0 +1,168 @@
+#ifndef JOURNALSTORAGE_H_INCLUDED
+#define JOURNALSTORAGE_H_INCLUDED
+
+#include "FileStorage.h"
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @file JournalStorage.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * The journaled storage: edits are appended to a journal next to the
+ * document file, so saving costs only the edits since the last save. Once
+ * the journal grows beyond compaction_threshold, a background thread
+ * rewrites the document file from a snapshot and starts a new journal.
+ *
+ * The journal begins with a header naming the inode of the document file it
+ * applies to, followed by records:
+ *
+ *   'I' offset length bytes   bytes were inserted at offset
+ *   'D' offset length         length bytes were erased at offset
+ *   'K' inode position        a compacted document file with this inode
+ *                             contains all records before position
+ *
+ * All numbers are 64 bit in network byte order. The 'K' record is written
+ * before the compacted file replaces the document, so a crash between
+ * replacing the document and replacing the journal loses nothing.
+ */
+
+class JournalStorage
+	: public FileStorage
+{
+public:
+	/**
+	 * The journal size in bytes which triggers a compaction.
+	 */
+	static std::uint64_t const compaction_threshold = 4 * 1024 * 1024;
+
+	/**
+	 * Construct the storage for an opened document file. The journal is
+	 * created by the first save which has edits to record.
+	 *
+	 * @param fd The readable descriptor of the document file, the storage
+	 *           takes ownership.
+	 * @param name The path of the document file.
+	 * @param mode How the contents are brought into memory.
+	 * @throws DocumentError If the journal can't be opened.
+	 */
+	JournalStorage(int fd, std::string const &name, Document::OpenMode mode);
+
+	/**
+	 * Wait for a running compaction and close all files.
+	 */
+	~JournalStorage();
+
+	/**
+	 * Obtain the path of the journal belonging to a document file.
+	 *
+	 * @param name The path of the document file.
+	 * @return The path of the journal.
+	 */
+	static std::string journal_name(std::string const &name);
+
+	/**
+	 * Load the document file and replay the journal on top of it. An
+	 * incomplete record at the end, left by an interrupted save, is ignored
+	 * and cut off by the next save, even one without edits. Loading doesn't
+	 * modify any file, so documents may be loaded while another storage
+	 * appends to them.
+	 *
+	 * @throws DocumentError If the journal doesn't match the document file.
+	 */
+	Rope load();
+
+	void inserted(std::size_t offset, char const *bytes, std::size_t length);
+	void erased(std::size_t offset, std::size_t length);
+
+	/**
+	 * The job appends the edits since the last save to the journal and
+	 * starts a compaction if the journal became too large. It fails if
+	 * appending fails or the last compaction failed, the edits are then
+	 * appended by the next save.
+	 */
+	std::function<void()> prepare_save(Rope &contents);
+
+	/**
+	 * Save without mapping the document file again, it lacks the journaled
+	 * edits.
+	 */
+	void save(Rope &contents);
+
+	/**
+	 * The document file only holds the contents while the journal holds no
+	 * records.
+	 */
+	int contents_file(std::size_t &offset);
+
+	/**
+	 * Remove the document file and its journal.
+	 */
+	void remove();
+
+	void close();
+
+private:
+	/**
+	 * Append records to the journal, runs as save job.
+	 *
+	 * @param records The records to append.
+	 * @param snapshot The contents described by the journal afterwards.
+	 */
+	void append(std::vector<char> const &records, Rope const &snapshot);
+
+	/**
+	 * Write the snapshot as new document file and replace the journal by
+	 * the records after position. Runs on its own thread.
+	 *
+	 * @param snapshot The contents described by the journal up to position.
+	 * @param position The journal size at the time of the snapshot.
+	 */
+	void compact(Rope snapshot, std::uint64_t position);
+
+	/**
+	 * Cut off the incomplete record an interrupted save left behind, before
+	 * anything is appended behind it. Called with the mutex held.
+	 *
+	 * @throws DocumentError If truncating the journal fails.
+	 */
+	void cut_torn_tail();
+
+	/**
+	 * Wait for a running compaction to finish.
+	 */
+	void join();
+
+	/**
+	 * Create a new journal for a document file, holding the given records.
+	 *
+	 * @param inode The inode of the document file.
+	 * @param records The bytes of the records.
+	 * @param size The number of bytes of the records.
+	 * @throws DocumentError If writing the journal fails.
+	 */
+	void write_journal(std::uint64_t inode, char const *records, std::size_t size);
+
+	std::string const journal_name_;
+	int journal_fd_;
+	std::uint64_t journal_size_;
+	// the journal continues with an incomplete record after journal_size_
+	bool torn_;
+	// edits since the last prepared save
+	std::vector<char> pending_;
+	// records of failed saves, appended by the next one
+	std::vector<char> unsaved_;
+	std::thread compaction_;
+	std::atomic<bool> compacting_;
+	std::exception_ptr compaction_error_;
+	// guards the journal against concurrent saves and compactions
+	std::mutex mutex_;
+};
+
+#endif
@@ -0,0 +1,272 @@
+#include "LineIndex.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+/**
+ * @file LineIndex.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the line index.
+ */
+
+namespace
+{
+	// the finalizer of splitmix64, good enough to scatter treap priorities
+	std::uint64_t mix(std::uint64_t value)
+	{
+		value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+
+		return value ^ (value >> 31);
+	}
+}
+
+std::size_t const LineIndex::run_size;
+
+LineIndex::Summary LineIndex::SlotTraits::measure(Slot const &slot)
+{
+	Summary summary;
+
+	summary.length = slot.run.length;
+	summary.newlines = slot.run.newlines;
+
+	return summary;
+}
+
+LineIndex::Summary LineIndex::SlotTraits::combine(Summary const &left, Summary const &right)
+{
+	Summary summary;
+
+	summary.length = left.length + right.length;
+	summary.newlines = left.newlines + right.newlines;
+
+	return summary;
+}
+
+std::uint64_t LineIndex::SlotTraits::priority(Slot const &slot)
+{
+	return mix(slot.seed);
+}
+
+std::pair<LineIndex::Slot, LineIndex::Slot> LineIndex::SlotTraits::split(Slot const &,
+                                                                        std::size_t)
+{
+	// the tree is only ever split at run boundaries
+	throw std::logic_error("runs can't be split");
+}
+
+LineIndex::LineIndex()
+	: next_seed_(0)
+{
+}
+
+LineIndex::LineIndex(Rope const &contents)
+	: next_seed_(0)
+{
+	root_ = build(cut(contents, 0, contents.size()));
+}
+
+LineIndex::LineIndex(std::vector<Run> const &runs)
+	: next_seed_(0)
+{
+	root_ = build(runs);
+}
+
+void LineIndex::update(Rope const &contents, std::size_t offset, std::size_t erased,
+                       std::size_t inserted)
+{
+	std::size_t const old_size = size();
+
+	if (!old_size)
+	{
+		*this = LineIndex(contents);
+		return;
+	}
+
+	// replace the runs from the one holding the edit to the one holding its last erased byte
+	std::size_t local = 0;
+	std::size_t const anchor = std::min(offset, old_size - 1);
+
+	tree::find(root_, anchor, local);
+
+	std::size_t const begin = anchor - local;
+	std::size_t const last = erased ? offset + erased - 1 : anchor;
+	tree::Node const *const node = tree::find(root_, last, local);
+	std::size_t const old_end = last - local + node->value.run.length;
+
+	std::vector<Run> const runs = cut(contents, begin, old_end - erased + inserted);
+
+	auto const head = tree::split(root_, begin);
+	auto const tail = tree::split(head.second, old_end - begin);
+
+	root_ = tree::merge(tree::merge(head.first, build(runs)), tail.second);
+}
+
+std::size_t LineIndex::line_of(Rope const &contents, std::size_t offset) const
+{
+	if (offset > size())
+	{
+		std::ostringstream strm;
+
+		strm << "offset " << offset << " exceeds the size " << size();
+
+		throw rope_errors::OutOfRangeError(strm.str());
+	}
+
+	tree::Node const *current = root_.get();
+	std::size_t position = offset;
+	std::size_t newlines = 0;
+
+	// count the newlines of everything in front of the run holding the offset
+	while (current)
+	{
+		std::size_t const left_length = tree::length(current->left);
+
+		if (position < left_length)
+		{
+			current = current->left.get();
+			continue;
+		}
+
+		newlines += tree::summary(current->left).newlines;
+		position -= left_length;
+
+		if (position < current->value.run.length)
+		{
+			break;
+		}
+
+		newlines += current->value.run.newlines;
+		position -= current->value.run.length;
+		current = current->right.get();
+	}
+
+	return newlines + count(contents, offset - position, position);
+}
+
+std::size_t LineIndex::offset_of(Rope const &contents, std::size_t line) const
+{
+	if (line >= lines())
+	{
+		std::ostringstream strm;
+
+		strm << "line " << line << " exceeds the " << lines() << " lines";
+
+		throw rope_errors::OutOfRangeError(strm.str());
+	}
+
+	if (!line)
+	{
+		return 0;
+	}
+
+	tree::Node const *current = root_.get();
+	std::size_t remaining = line;
+	std::size_t position = 0;
+
+	// find the run holding the newline ending the previous line
+	while (true)
+	{
+		std::size_t const left_newlines = tree::summary(current->left).newlines;
+
+		if (remaining <= left_newlines)
+		{
+			current = current->left.get();
+			continue;
+		}
+
+		remaining -= left_newlines;
+		position += tree::length(current->left);
+
+		if (remaining <= current->value.run.newlines)
+		{
+			break;
+		}
+
+		remaining -= current->value.run.newlines;
+		position += current->value.run.length;
+		current = current->right.get();
+	}
+
+	std::size_t found = position;
+
+	contents.for_each_span(position, current->value.run.length,
+		[&](char const *bytes, std::size_t length)
+		{
+			char const *const end = bytes + length;
+
+			for (char const *newline = bytes; remaining && newline != end; )
+			{
+				newline = std::find(newline, end, '\n');
+
+				if (newline != end)
+				{
+					found = position + (newline - bytes) + 1;
+					remaining--;
+					newline++;
+				}
+			}
+
+			position += length;
+		});
+
+	return found;
+}
+
+std::vector<LineIndex::Run> LineIndex::cut(Rope const &contents, std::size_t begin,
+                                           std::size_t end)
+{
+	std::vector<Run> runs;
+
+	for (std::size_t position = begin; position < end; position += run_size)
+	{
+		std::size_t const length = std::min(end - position, run_size);
+		Run const run = { length, count(contents, position, length) };
+
+		runs.push_back(run);
+	}
+
+	return runs;
+}
+
+std::vector<LineIndex::Run> LineIndex::runs() const
+{
+	std::vector<Run> runs;
+	auto collect = [&runs](Slot const &slot, std::size_t, std::size_t)
+	{
+		runs.push_back(slot.run);
+	};
+
+	tree::for_each(root_, 0, size(), collect);
+
+	return runs;
+}
+
+LineIndex::tree::node_ptr LineIndex::build(std::vector<Run> const &runs)
+{
+	tree::node_ptr root;
+
+	for (auto const &run: runs)
+	{
+		Slot const slot = { run, next_seed_++ };
+
+		root = tree::merge(root, tree::make(slot));
+	}
+
+	return root;
+}
+
+std::size_t LineIndex::count(Rope const &contents, std::size_t offset, std::size_t length)
+{
+	std::size_t newlines = 0;
+
+	contents.for_each_span(offset, length,
+		[&newlines](char const *bytes, std::size_t span_length)
+		{
+			newlines += std::count(bytes, bytes + span_length, '\n');
+		});
+
+	return newlines;
+}
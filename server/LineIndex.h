@@ -0,0 +1,174 @@
+#ifndef LINEINDEX_H_INCLUDED
+#define LINEINDEX_H_INCLUDED
+
+#include "PersistentTreap.h"
+#include "Rope.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * @file LineIndex.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * An index of the newlines of a document, translating between byte offsets
+ * and line numbers.
+ *
+ * The contents are cut into runs of at most run_size bytes and the number
+ * of newlines of every run is kept in a treap summing up bytes and newlines.
+ * Both translations walk down the treap and scan the bytes of a single run,
+ * so they cost O(log n). After an edit only the runs touched by the edit are
+ * cut and counted again.
+ */
+
+class LineIndex
+{
+public:
+	/**
+	 * A run of bytes and the number of newlines in it.
+	 */
+	struct Run
+	{
+		std::size_t length;
+		std::size_t newlines;
+	};
+
+	/**
+	 * The maximum number of bytes of a run, which bounds the bytes scanned
+	 * by a translation.
+	 */
+	static std::size_t const run_size = 4096;
+
+	/**
+	 * Construct the index of an empty document.
+	 */
+	LineIndex();
+
+	/**
+	 * Count the newlines of all the contents.
+	 *
+	 * @param contents The contents of the document.
+	 */
+	explicit LineIndex(Rope const &contents);
+
+	/**
+	 * Restore an index from its runs, as returned by runs().
+	 *
+	 * @param runs The runs in order.
+	 */
+	explicit LineIndex(std::vector<Run> const &runs);
+
+	/**
+	 * Obtain the number of bytes covered by the runs.
+	 */
+	std::size_t size() const
+	{
+		return tree::length(root_);
+	}
+
+	/**
+	 * Obtain the number of lines, which is one more than the number of
+	 * newlines.
+	 */
+	std::size_t lines() const
+	{
+		return tree::summary(root_).newlines + 1;
+	}
+
+	/**
+	 * Bring the index up to date after the contents were edited.
+	 *
+	 * @param contents The contents after the edit.
+	 * @param offset The offset of the edit.
+	 * @param erased The number of bytes erased at the offset.
+	 * @param inserted The number of bytes inserted at the offset.
+	 */
+	void update(Rope const &contents, std::size_t offset, std::size_t erased,
+	            std::size_t inserted);
+
+	/**
+	 * Obtain the line an offset lies in.
+	 *
+	 * @param contents The contents the index is up to date with.
+	 * @param offset The offset, may be equal to the size.
+	 * @return The number of newlines in front of the offset.
+	 * @throws rope_errors::OutOfRangeError If the offset is beyond the end.
+	 */
+	std::size_t line_of(Rope const &contents, std::size_t offset) const;
+
+	/**
+	 * Obtain the offset a line starts at.
+	 *
+	 * @param contents The contents the index is up to date with.
+	 * @param line The line, counting from 0.
+	 * @return The offset behind the newline ending the previous line.
+	 * @throws rope_errors::OutOfRangeError If there is no such line.
+	 */
+	std::size_t offset_of(Rope const &contents, std::size_t line) const;
+
+	/**
+	 * Obtain all runs in order.
+	 */
+	std::vector<Run> runs() const;
+
+private:
+	struct Slot
+	{
+		Run run;
+		// scatters the treap priorities, runs have nothing unique about them
+		std::uint64_t seed;
+	};
+
+	struct Summary
+	{
+		Summary()
+			: length(0),
+			  newlines(0)
+		{
+		}
+
+		std::size_t length;
+		std::size_t newlines;
+	};
+
+	struct SlotTraits
+	{
+		typedef Slot value_type;
+		typedef Summary summary_type;
+
+		static Summary measure(Slot const &slot);
+		static Summary combine(Summary const &left, Summary const &right);
+
+		static std::size_t length(Summary const &summary)
+		{
+			return summary.length;
+		}
+
+		static std::uint64_t priority(Slot const &slot);
+		static std::pair<Slot, Slot> split(Slot const &slot, std::size_t offset);
+	};
+
+	typedef PersistentTreap<SlotTraits> tree;
+
+	/**
+	 * Cut [begin, end) of the contents into runs and count their newlines.
+	 */
+	std::vector<Run> cut(Rope const &contents, std::size_t begin, std::size_t end);
+
+	/**
+	 * Create a tree from runs in order.
+	 */
+	tree::node_ptr build(std::vector<Run> const &runs);
+
+	/**
+	 * Count the newlines in a range of the contents.
+	 */
+	static std::size_t count(Rope const &contents, std::size_t offset, std::size_t length);
+
+	tree::node_ptr root_;
+	std::uint64_t next_seed_;
+};
+
+#endif
@@ -5,80 +5,27 @@
 **/
 
 #include "Client.h"
+#include "Document.h"
 #include "exceptions.h"
 #include "Message.h"
 
+const size_t
+	Message::FIELD_SIZE_BYTE,
+	Message::FIELD_SIZE_ID,
+	Message::FIELD_SIZE_DOC_NAME,
+	Message::FIELD_SIZE_DOC_SIZE,
+	Message::FIELD_SIZE_DOC_TIME,
+	Message::FIELD_SIZE_HASH,
+	Message::FIELD_SIZE_SIGNATURE,
+	Message::FIELD_SIZE_SIZE,
+	Message::FIELD_SIZE_STATUS,
+	Message::FIELD_SIZE_TYPE,
+	Message::FIELD_SIZE_USER_NAME;
+
 Message::Message(void):
-	length(0), id(0), position(0), source(NULL), status(STATUS_NOT_OK), type(TYPE_INVALID)
+	length(0), id(0), line(0), column(0), position(0), source(NULL), status(STATUS_NOT_OK), type(TYPE_INVALID)
 {}
 
-void Message::receive_from(ClientSptr client)
-{
-	char buffer;
-
-	// save source
-	source = client;
-
-	// get message type
-	client->receive(&buffer, FIELD_SIZE_TYPE);
-	type = static_cast<MessageType>(buffer);
-	
-	// get first data
-	switch (type)
-	{
-		case TYPE_DOC_ACTIVATE:
-		case TYPE_DOC_SAVE:
-			client->receive(&id, FIELD_SIZE_ID);
-			id = ntohl(id);
-			break;
-		case TYPE_DOC_CREATE:
-		case TYPE_DOC_DELETE:
-		case TYPE_DOC_OPEN:
-			name.resize(FIELD_SIZE_DOC_NAME);
-			client->receive(&name, FIELD_SIZE_DOC_NAME);
-			break;
-		case TYPE_SYNC_BYTE:
-			bytes.resize(FIELD_SIZE_BYTE);
-			client->receive(&bytes, FIELD_SIZE_BYTE);
-			break;
-		case TYPE_SYNC_CURSOR:
-		case TYPE_SYNC_DELETION:
-			client->receive(&position, FIELD_SIZE_SIZE);
-			position = ntohl(position);
-			break;
-		case TYPE_SYNC_MULTIBYTE:
-			client->receive(&length, FIELD_SIZE_SIZE);
-			length = ntohl(length);
-			break;
-		case TYPE_USER_LOGIN:
-			name.resize(FIELD_SIZE_USER_NAME);
-			client->receive(&name, FIELD_SIZE_USER_NAME);
-			break;
-		case TYPE_USER_LOGOUT: break;
-		default:
-			throw Exception::InvalidMessageType("invalid message type", type, client->socket);
-	}
-	
-	// get second data
-	switch (type)
-	{
-		case TYPE_DOC_ACTIVATE:
-		case TYPE_USER_LOGIN:
-			hash.resize(FIELD_SIZE_HASH);
-			client->receive(&hash, FIELD_SIZE_HASH);
-			break;
-		case TYPE_SYNC_DELETION:
-			client->receive(&length, FIELD_SIZE_SIZE);
-			length = ntohl(length);
-			break;
-		case TYPE_SYNC_MULTIBYTE:
-			bytes.resize(length);
-			client->receive(&bytes, length);
-			break;
-		default: break;
-	}
-}
-
 std::vector<char> &Message::generate_bytestream(std::vector<char> &dest) const
 {
 	// append message type
@@ -94,15 +41,21 @@ std::vector<char> &Message::generate_bytestream(std::vector<char> &dest) const
 		case TYPE_DOC_SAVE:
 		case TYPE_USER_LOGIN:
 		case TYPE_STATUS:
+		case TYPE_DOC_LIST:
+		case TYPE_DOC_CLONE:
+		case TYPE_DOC_VIEWPORT:
+		case TYPE_DOC_VIEWPORT_LINE:
 			append_bytes(dest, static_cast<char>(status));
 			break;
 		case TYPE_SYNC_BYTE:
 		case TYPE_SYNC_DELETION:
 		case TYPE_SYNC_MULTIBYTE:
+		case TYPE_SYNC_VIEWPORT_SHIFT:
 			append_bytes(dest, htonl(position));
 			break;
 		case TYPE_USER_JOIN:
 		case TYPE_USER_QUIT:
+		case TYPE_SYNC_DELTA:
 			append_bytes(dest, htonl(id));
 			break;
 		default:
@@ -115,21 +68,27 @@ std::vector<char> &Message::generate_bytestream(std::vector<char> &dest) const
 		case TYPE_DOC_ACTIVATE:
 		case TYPE_DOC_OPEN:
 		case TYPE_DOC_SAVE:
+		case TYPE_DOC_CLONE:
+		case TYPE_DOC_VIEWPORT:
+		case TYPE_DOC_VIEWPORT_LINE:
 			append_bytes(dest, htonl(id));
 			break;
 		case TYPE_DOC_CREATE:
 		case TYPE_DOC_DELETE:
-			append_bytes(dest, &name, FIELD_SIZE_DOC_NAME);
+			append_bytes(dest, name.data(), FIELD_SIZE_DOC_NAME);
 			break;
 		case TYPE_SYNC_BYTE:
-			append_bytes(dest, &bytes, FIELD_SIZE_BYTE);
+			append_bytes(dest, bytes.data(), FIELD_SIZE_BYTE);
 			break;
 		case TYPE_SYNC_DELETION:
 		case TYPE_SYNC_MULTIBYTE:
+		case TYPE_SYNC_DELTA:
+		case TYPE_DOC_LIST:
+		case TYPE_SYNC_VIEWPORT_SHIFT:
 			append_bytes(dest, htonl(length));
 			break;
 		case TYPE_USER_JOIN:
-			append_bytes(dest, &name, FIELD_SIZE_USER_NAME);
+			append_bytes(dest, name.data(), FIELD_SIZE_USER_NAME);
 			break;
 		default: break;
 	}
@@ -138,10 +97,18 @@ std::vector<char> &Message::generate_bytestream(std::vector<char> &dest) const
 	switch (type)
 	{
 		case TYPE_DOC_OPEN:
-			append_bytes(dest, &name, FIELD_SIZE_DOC_NAME);
+			append_bytes(dest, name.data(), FIELD_SIZE_DOC_NAME);
+			break;
+		case TYPE_DOC_VIEWPORT:
+		case TYPE_DOC_VIEWPORT_LINE:
+			append_bytes(dest, htonl(position));
+			append_bytes(dest, htonl(length));
 			break;
 		case TYPE_SYNC_MULTIBYTE:
-			append_bytes(dest, &bytes, length);
+		case TYPE_SYNC_DELTA:
+		case TYPE_DOC_LIST:
+			if (!bytes.empty())
+			{ append_bytes(dest, bytes.data(), bytes.size()); }
 			break;
 		default: break;
 	}
@@ -159,6 +126,16 @@ void Message::send_to(Client &client) const
 	client.send(bytestream);
 }
 
+void Message::stream_to(Client &client, const Document &document) const
+{
+	// send the header only, the payload follows without being copied
+	std::vector<char> bytestream;
+	generate_bytestream(bytestream);
+	client.send(bytestream);
+
+	client.send_contents(document, position, length);
+}
+
 void Message::send_to(ClientCollection &clients) const
 {
 	// generate bytestream to send
@@ -168,3 +145,32 @@ void Message::send_to(ClientCollection &clients) const
 	// send
 	clients.broadcast(bytestream);
 }
+
+void Message::send_to(ClientCollection &clients, uint32_t document, const Client *except) const
+{
+	// generate bytestream to send
+	std::vector<char> bytestream;
+	generate_bytestream(bytestream);
+
+	// send
+	clients.broadcast(bytestream, document, except);
+}
+
+void Message::send_edit_to(ClientCollection &clients, uint32_t document,
+	const Client *except) const
+{
+	const uint64_t erased = type == TYPE_SYNC_DELETION ? length : 0;
+	const uint64_t inserted = type == TYPE_SYNC_DELETION ? 0 : bytes.size();
+
+	// one announcement serves all moved viewports
+	Message shift;
+	shift.type = TYPE_SYNC_VIEWPORT_SHIFT;
+	shift.position = position;
+	shift.length = static_cast<int32_t>(inserted - erased);
+
+	std::vector<char> edit, moved;
+	generate_bytestream(edit);
+	shift.generate_bytestream(moved);
+
+	clients.broadcast_edit(edit, moved, document, position, erased, inserted, except);
+}
@@ -13,6 +13,7 @@
 #include "ClientCollection.h"
 
 class Client;
+class Document;
 
 class Message
 {
@@ -30,7 +31,8 @@ class Message
 			STATUS_USER_CURSOR_UNKNOWN, // user cursor position is unknown
 			STATUS_USER_CURSOR_OUT_OF_BOUNDS, // user cursor position is out of bounds
 			STATUS_USER_LENGTH_TOO_LONG, // specified length is too long
-			STATUS_NOT_OK // anything but success
+			STATUS_NOT_OK, // anything but success
+			STATUS_OK_SIGNATURES_REQUESTED // doc differs, client sends its chunk signatures
 		};
 		enum MessageType
 		{
@@ -49,14 +51,36 @@ class Message
 			TYPE_USER_LOGIN, // user sends login credentials (name, hash)
 			TYPE_USER_LOGOUT, // user logs out
 			TYPE_USER_JOIN, // server -> client only (a new user connected)
-			TYPE_USER_QUIT // server -> client only (a user disconnected)
+			TYPE_USER_QUIT, // server -> client only (a user disconnected)
+			TYPE_SYNC_SIGNATURES, // user sends chunk signatures of its doc copy (id, length,
+								  // payload)
+			TYPE_SYNC_DELTA, // server -> client only (delta rebuilding the doc from the signed
+							 // copy, see DeltaSync.h)
+			TYPE_DOC_LIST, // user lists docs (name of the last doc of the previous page, length as
+						   // page size), response (length as doc count, payload of doc entries)
+			TYPE_SYNC_CURSOR_LINE, // user sends new cursor position as line and column (line,
+								   // column), both counting from 0, the column in bytes
+			TYPE_DOC_CLONE, // user creates doc as copy of another one (name of the copy, id of the
+							// source doc), response (status, id of the copy)
+			TYPE_DOC_VIEWPORT, // user activates doc and subscribes to a window of it (id, position,
+							   // length), response (status, id, position, length) followed by the
+							   // window as multibyte message, see Viewport.h; the response is
+							   // also sent unasked to resync a client that lagged behind
+			TYPE_DOC_VIEWPORT_LINE, // like TYPE_DOC_VIEWPORT, but the window is given by lines
+									// (id, line, length as line count), the response carries the
+									// window in bytes
+			TYPE_SYNC_VIEWPORT_SHIFT // server -> client only (an edit in front of the viewport
+									 // moved it, position of the edit, length as signed distance)
 		};
 		
-		const size_t
+		static const size_t
 			FIELD_SIZE_BYTE = 1,
 			FIELD_SIZE_ID = 4,
 			FIELD_SIZE_DOC_NAME = 128,
+			FIELD_SIZE_DOC_SIZE = 8,
+			FIELD_SIZE_DOC_TIME = 8,
 			FIELD_SIZE_HASH = 20,
+			FIELD_SIZE_SIGNATURE = 24,
 			FIELD_SIZE_SIZE = 4,
 			FIELD_SIZE_STATUS = 1,
 			FIELD_SIZE_TYPE = 1,
@@ -66,6 +90,8 @@ class Message
 		std::vector<char>	hash;
 		int32_t				length;
 		int32_t				id;
+		int32_t				line;
+		int32_t				column;
 		std::vector<char>	name;
 		int32_t				position;
 		ClientSptr			source;
@@ -81,13 +107,6 @@ class Message
 			Checks whether this is an empty message.
 		**/
 		inline bool is_empty() const;
-		/**
-			Attempts to parse a bytestream sent by the given client to this Message object.
-				client
-			=#	Exception::InvalidMessageType - if the message has an invalid type
-			=#	client.receive
-		**/
-		void receive_from(ClientSptr client);
 		/**
 			Attempts to send a raw byte sequence representation of this Message to the specified
 			Client.
@@ -95,12 +114,42 @@ class Message
 			=#	Client::send(std::vector<char> &)
 		**/
 		void send_to(Client &client) const;
+		/**
+			Like send_to(Client &), but sends the range [position, position + length) of the
+			contents of the given document as payload of a TYPE_SYNC_MULTIBYTE message without
+			copying them into the bytestream, see Client::send_contents.
+				client
+				document
+		**/
+		void stream_to(Client &client, const Document &document) const;
 		/**
 			Like send_to(ClientSptr), but sends to all Clients in the given ClientCollection.
 				clients
 			=#	ClientCollection::broadcast(std::vector<char> &)
 		**/
 		void send_to(ClientCollection &clients) const;
+		/**
+			Like send_to(ClientCollection &), but only sends to the Clients that have the given
+			document active.
+				 clients
+				 document - id of the document
+				*except - client to leave out
+			=#	ClientCollection::broadcast(std::vector<char> &, uint32_t, const Client *)
+		**/
+		void send_to(ClientCollection &clients, uint32_t document, const Client *except = 0) const;
+		/**
+			Like send_to(ClientCollection &, uint32_t, const Client *) for an edit message
+			(TYPE_SYNC_BYTE, TYPE_SYNC_MULTIBYTE or TYPE_SYNC_DELETION at `position`). Only the
+			Clients whose viewport the edit overlaps receive it, those whose viewport it merely
+			moves receive a TYPE_SYNC_VIEWPORT_SHIFT instead of the payload. The viewports of all
+			Clients follow the edit, including the one of `except`.
+				 clients
+				 document - id of the document
+				*except - client to leave out
+			=#	ClientCollection::broadcast_edit
+		**/
+		void send_edit_to(ClientCollection &clients, uint32_t document,
+			const Client *except = 0) const;
 	
 	private:
 		/**
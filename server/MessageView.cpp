@@ -0,0 +1,204 @@
+/**
+	file: MessageView.cpp
+	author: Maximilian Lasser [max.lasser@online.de]
+	created: Friday, 15th June 2012
+**/
+
+#include <arpa/inet.h>
+#include <cstring> // memcpy
+#include "Client.h"
+#include "exceptions.h"
+#include "MessageView.h"
+
+/**
+	Reads the fields of a message from the bytes received so far.
+**/
+class MessageView::FrameReader
+{
+	public:
+		/// thrown when the bytes end within the message
+		struct Incomplete
+		{
+			/// number of bytes the message needs at least
+			size_t needed;
+		};
+
+		FrameReader(const char *bytes, size_t size):
+			begin(bytes), position(bytes), end(bytes + size)
+		{}
+
+		/**
+			Copies the next field, for fixed size fields.
+				destination
+				size
+			=#	Incomplete - if the bytes end within the field
+		**/
+		void read(void *destination, size_t size)
+		{
+			this->require(size);
+			std::memcpy(destination, this->position, size);
+			this->position += size;
+		}
+		/**
+			Points the given span to the next field instead of copying it.
+				destination
+				size
+			=#	Incomplete - if the bytes end within the field
+		**/
+		void read(ByteSpan &destination, size_t size)
+		{
+			this->require(size);
+			destination.data = this->position;
+			destination.size = size;
+			this->position += size;
+		}
+		/**
+			Checks that the next field has arrived completely.
+				size
+			=#	Incomplete - if the bytes end within the field
+		**/
+		void require(size_t size) const
+		{
+			if (size > static_cast<size_t>(this->end - this->position))
+			{ throw Incomplete { static_cast<size_t>(this->position - this->begin) + size }; }
+		}
+		/**
+			=>	number of bytes read so far
+		**/
+		size_t consumed(void) const
+		{ return this->position - this->begin; }
+
+	private:
+		const char	*const begin;
+		const char	*position;
+		const char	*const end;
+};
+
+const size_t MessageView::MAX_PAYLOAD_SIZE;
+
+MessageView::MessageView(void):
+	length(0), id(0), line(0), column(0), position(0), type(Message::TYPE_INVALID)
+{}
+
+size_t MessageView::parse(ClientSptr client, const char *data, size_t size, size_t &needed)
+{
+	FrameReader frame(data, size);
+	try
+	{ parse_fields(client->socket, frame); }
+	catch (const FrameReader::Incomplete &incomplete)
+	{
+		needed = incomplete.needed;
+		return 0;
+	}
+
+	// save source
+	source = client;
+	raw.data = data;
+	raw.size = frame.consumed();
+	return raw.size;
+}
+
+void MessageView::parse_fields(int socket, FrameReader &frame)
+{
+	char buffer;
+
+	// get message type
+	frame.read(&buffer, Message::FIELD_SIZE_TYPE);
+	type = static_cast<Message::MessageType>(buffer);
+
+	// get first data
+	switch (type)
+	{
+		case Message::TYPE_DOC_ACTIVATE:
+		case Message::TYPE_DOC_SAVE:
+		case Message::TYPE_SYNC_SIGNATURES:
+		case Message::TYPE_DOC_VIEWPORT:
+		case Message::TYPE_DOC_VIEWPORT_LINE:
+			frame.read(&id, Message::FIELD_SIZE_ID);
+			id = ntohl(id);
+			break;
+		case Message::TYPE_DOC_CREATE:
+		case Message::TYPE_DOC_DELETE:
+		case Message::TYPE_DOC_OPEN:
+		case Message::TYPE_DOC_LIST:
+		case Message::TYPE_DOC_CLONE:
+			frame.read(name, Message::FIELD_SIZE_DOC_NAME);
+			break;
+		case Message::TYPE_SYNC_BYTE:
+			frame.read(bytes, Message::FIELD_SIZE_BYTE);
+			break;
+		case Message::TYPE_SYNC_CURSOR:
+		case Message::TYPE_SYNC_DELETION:
+			frame.read(&position, Message::FIELD_SIZE_SIZE);
+			position = ntohl(position);
+			break;
+		case Message::TYPE_SYNC_MULTIBYTE:
+			frame.read(&length, Message::FIELD_SIZE_SIZE);
+			length = ntohl(length);
+			break;
+		case Message::TYPE_SYNC_CURSOR_LINE:
+			frame.read(&line, Message::FIELD_SIZE_SIZE);
+			line = ntohl(line);
+			break;
+		case Message::TYPE_USER_LOGIN:
+			frame.read(name, Message::FIELD_SIZE_USER_NAME);
+			break;
+		case Message::TYPE_USER_LOGOUT: break;
+		default:
+			throw Exception::InvalidMessageType("invalid message type", type, socket);
+	}
+
+	// get second data
+	switch (type)
+	{
+		case Message::TYPE_DOC_ACTIVATE:
+		case Message::TYPE_USER_LOGIN:
+			frame.read(hash, Message::FIELD_SIZE_HASH);
+			break;
+		case Message::TYPE_SYNC_DELETION:
+		case Message::TYPE_SYNC_SIGNATURES:
+		case Message::TYPE_DOC_LIST:
+			frame.read(&length, Message::FIELD_SIZE_SIZE);
+			length = ntohl(length);
+			break;
+		case Message::TYPE_SYNC_MULTIBYTE:
+			if (length < 0 || static_cast<size_t>(length) > MAX_PAYLOAD_SIZE)
+			{ throw Exception::InvalidMessageLength("invalid payload length", length, socket); }
+			frame.read(bytes, length);
+			break;
+		case Message::TYPE_SYNC_CURSOR_LINE:
+			frame.read(&column, Message::FIELD_SIZE_SIZE);
+			column = ntohl(column);
+			break;
+		case Message::TYPE_DOC_CLONE:
+			frame.read(&id, Message::FIELD_SIZE_ID);
+			id = ntohl(id);
+			break;
+		case Message::TYPE_DOC_VIEWPORT:
+			frame.read(&position, Message::FIELD_SIZE_SIZE);
+			position = ntohl(position);
+			break;
+		case Message::TYPE_DOC_VIEWPORT_LINE:
+			frame.read(&line, Message::FIELD_SIZE_SIZE);
+			line = ntohl(line);
+			break;
+		default: break;
+	}
+
+	// get third data
+	switch (type)
+	{
+		case Message::TYPE_DOC_VIEWPORT:
+		case Message::TYPE_DOC_VIEWPORT_LINE:
+			frame.read(&length, Message::FIELD_SIZE_SIZE);
+			length = ntohl(length);
+			break;
+		case Message::TYPE_SYNC_SIGNATURES:
+			// length is the amount of signatures, one per chunk of at least 2 KiB
+			if (length < 0 || length > INT32_MAX / 2048)
+			{ throw Exception::InvalidMessageLength("invalid signature count", length, socket); }
+			frame.read(bytes, length * Message::FIELD_SIZE_SIGNATURE);
+			break;
+		default: break;
+	}
+}
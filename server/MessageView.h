@@ -0,0 +1,99 @@
+/**
+	file: MessageView.h
+	author: Maximilian Lasser [max.lasser@online.de]
+	created: Friday, 15th June 2012
+**/
+
+#ifndef _MESSAGEVIEW_H_
+#define _MESSAGEVIEW_H_
+
+#include <cstddef> // size_t
+#include <cstdint> // int32_t
+#include <vector>
+
+#include "ClientCollection.h"
+#include "Message.h"
+
+/*
+	Bytes of a received message, pointing into the receive buffer of its client.
+*/
+struct ByteSpan
+{
+	const char	*data;
+	size_t		 size;
+
+	ByteSpan(void):
+		data(0), size(0)
+	{}
+
+	const char *begin(void) const
+	{ return this->data; }
+	const char *end(void) const
+	{ return this->data + this->size; }
+
+	/*
+		Copies the bytes, for handlers that keep them beyond the message.
+		=>	the bytes
+	*/
+	std::vector<char> copy(void) const
+	{ return std::vector<char>(this->begin(), this->end()); }
+};
+
+/*
+	A message received from a client, decoded in place: the fixed size fields are converted to
+	host byte order, the variable size ones (bytes, hash, name) are spans over the receive buffer
+	of the source, so decoding a message never allocates. The spans stay valid until the source
+	releases its parsed messages, see Client::release_messages.
+*/
+class MessageView
+{
+	public:
+		/// largest payload accepted from a client, larger ones are taken for garbage
+		static const size_t MAX_PAYLOAD_SIZE = 64 * 1024 * 1024;
+
+		ByteSpan				bytes;
+		ByteSpan				hash;
+		int32_t					length;
+		int32_t					id;
+		int32_t					line;
+		int32_t					column;
+		ByteSpan				name;
+		int32_t					position;
+		// the whole message as received
+		ByteSpan				raw;
+		ClientSptr				source;
+		Message::MessageType	type;
+
+		MessageView(void);
+		MessageView(const MessageView &) = delete;
+
+		MessageView operator=(const MessageView &) = delete;
+
+		/**
+			Attempts to decode the message at the beginning of the bytes received from the given
+			client. If the bytes end within the message nothing is decoded, instead the number of
+			bytes the message needs at least is reported, so decoding is only attempted again once
+			they have arrived.
+				 client
+				 data - first received byte, has to stay in place as long as this is used
+				 size - number of received bytes
+				&needed - receives the number of bytes needed, if the message is incomplete
+			=>	number of bytes the message took, 0 if it's incomplete
+			=#	Exception::InvalidMessageType - if the message has an invalid type
+			=#	Exception::InvalidMessageLength - if a length field is out of range
+		**/
+		size_t parse(ClientSptr client, const char *data, size_t size, size_t &needed);
+
+	private:
+		class FrameReader;
+
+		/**
+			Decodes the type and the fields of a message, see parse.
+				socket - socket of the source, for the exceptions
+				frame
+			=#	FrameReader::Incomplete - if the bytes end within the message
+		**/
+		void parse_fields(int socket, FrameReader &frame);
+};
+
+#endif
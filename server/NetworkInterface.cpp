@@ -4,22 +4,59 @@
 	created: Friday, 11th May 2012
 **/
 
+#include <algorithm> // min
 #include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <sstream>
 
+#include "Client.h"
 #include "exceptions.h"
+#include "MessageView.h"
 #include "NetworkInterface.h"
+#include "NetworkPool.h"
 
-NetworkInterface::NetworkInterface(int port, int backlog)
+const uint32_t NetworkInterface::client_events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+
+NetworkInterface::NetworkInterface(int port, int backlog, std::shared_ptr<Database> database):
+	catalog(database ? std::make_shared<DocumentCatalog>(database)
+		: std::shared_ptr<DocumentCatalog>()),
+	documents(saves, std::chrono::minutes(5), Document::get_directory(), catalog.get()),
+	pool(0), index(0)
+{ this->open(port, backlog); }
+
+NetworkInterface::NetworkInterface(int port, int backlog,
+	std::shared_ptr<DocumentCatalog> catalog, NetworkPool &pool, size_t index):
+	catalog(catalog),
+	documents(saves, std::chrono::minutes(5), Document::get_directory(), catalog.get()),
+	pool(&pool), index(index)
+{ this->open(port, backlog); }
+
+NetworkInterface::~NetworkInterface(void)
+{
+	close(this->arrivals_fd);
+	close(this->poller);
+	close(this->listener);
+}
+
+void NetworkInterface::open(int port, int backlog)
 {
 	// create a socket for listening
 	this->listener = socket(AF_INET, SOCK_STREAM, 0);
 	if (this->listener == -1)
 	{ throw Exception::ErrnoError("failed to create listening socket", "socket"); }
+
+	// the NetworkInterfaces of a pool share the port, the kernel spreads the connections
+	const int reuse = 1;
+	if (this->pool
+		&& setsockopt(this->listener, SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) == -1)
+	{ throw Exception::ErrnoError("failed to share listening port", "setsockopt"); }
 	
 	// generate listening socket address structure and bind
 	struct sockaddr_in socket_address =
@@ -37,6 +74,27 @@ NetworkInterface::NetworkInterface(int port, int backlog)
 	// listen
 	if (listen(this->listener, backlog) == -1)
 	{ throw Exception::ErrnoError("failed to listen", "listen"); }
+
+	// accepting must not block once all pending connections are taken
+	if (fcntl(this->listener, F_SETFL, fcntl(this->listener, F_GETFL) | O_NONBLOCK) == -1)
+	{ throw Exception::ErrnoError("failed to make listening socket non-blocking", "fcntl"); }
+
+	// watch everything but the clients level-triggered, they are drained completely anyway
+	this->poller = epoll_create1(EPOLL_CLOEXEC);
+	if (this->poller == -1)
+	{ throw Exception::ErrnoError("failed to create epoll instance", "epoll_create1"); }
+
+	// signals clients handed over by other NetworkInterfaces
+	this->arrivals_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (this->arrivals_fd == -1)
+	{ throw Exception::ErrnoError("failed to create arrival event", "eventfd"); }
+
+	this->watch(this->listener, EPOLLIN);
+	this->watch(this->saves.get_fd(), EPOLLIN);
+	this->watch(this->arrivals_fd, EPOLLIN);
+	// a shared catalog is kept up to date by the first NetworkInterface only
+	if (this->catalog && this->index == 0)
+	{ this->watch(this->catalog->get_fd(), EPOLLIN); }
 }
 
 void NetworkInterface::add_message_handler(const NetworkMessageHandler handler)
@@ -48,68 +106,237 @@ void NetworkInterface::remove_message_handler(const NetworkMessageHandler handle
 void NetworkInterface::run(int ipc_socket)
 {
 	bool ipc_required = false;
+	this->watch(ipc_socket, EPOLLIN);
 
+	std::vector<struct epoll_event> events(max_events);
 	while (!ipc_required)
 	{
-		// generate fd_set
-		fd_set set;
-		FD_ZERO(&set);
-		FD_SET(this->listener, &set);
-		FD_SET(ipc_socket, &set);
-
-		int end = std::max(this->listener, this->clients.fill_fd_set(&set));
-		end = std::max(end, ipc_socket);
-		end += 1;
-
-		// select
-		int selected_amount = select(end, &set, 0, 0, 0);
-		if (selected_amount == -1)
+		// wait for activity only, waking up regularly to hibernate idle documents
+		int ready = epoll_wait(this->poller, events.data(), events.size(),
+			hibernation_interval * 1000);
+		if (ready == -1)
 		{
-			throw Exception::ErrnoError("select failed", "select");
+			if (errno == EINTR)
+			{ continue; }
+			throw Exception::ErrnoError("epoll_wait failed", "epoll_wait");
 		}
 
-		// check for incoming client connections
-		if (selected_amount == 0)
-		{ continue; }
+		this->documents.hibernate();
 
-		if (FD_ISSET(this->listener, &set))
-		{
-			this->clients.accept_client(this->listener);
-			--selected_amount;
-			/* Daniel -> Max:
-			 * I added this here, because obviously you don't
-			 * want to check for messages on the listening socket
-			 * right?
-			 */
-			FD_CLR(this->listener, &set);
-		}
+		MessageList messages;
+		MessageList::iterator tail = messages.before_begin();
+		std::vector<ClientSptr> disconnected;
+		std::vector<ClientSptr> lagging;
 
-		if (FD_ISSET(ipc_socket, &set))
+		for (int i = 0; i < ready; ++i)
 		{
-			/* the ipc socket doesn't care about messages, hence reduce
-			 * the amount of messages required
-			 * also clear it from the set so it won't be accessed
-			 * by the message things below
-			 */
-			--selected_amount;
-			FD_CLR(ipc_socket, &set);
-			ipc_required = true;
+			const int fd = events[i].data.fd;
+
+			if (fd == this->listener)
+			{ this->accept_clients(); }
+			// clients handed over, their messages are still in their receive buffers
+			else if (fd == this->arrivals_fd)
+			{ this->admit_clients(messages, tail, disconnected); }
+			else if (fd == ipc_socket)
+			{ ipc_required = true; }
+			// finished saves aren't messages, report them to whoever requested them
+			else if (fd == this->saves.get_fd())
+			{ this->saves.dispatch(); }
+			// directory changes only mark documents as stale, listing them reads them again
+			else if (this->catalog && fd == this->catalog->get_fd())
+			{ this->catalog->process_events(); }
+			// receive messages and send what waited for the socket to become writable
+			else
+			{
+				if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+				{
+					this->clients.receive_messages(fd,
+						events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR), messages, tail,
+						disconnected);
+				}
+				if (events[i].events & EPOLLOUT)
+				{ this->clients.flush(fd, lagging); }
+			}
 		}
 
-		// receive messages
-		MessageList messages(selected_amount);
-		this->clients.get_messages_by_fd_set(&set, end, messages);
+		// clients that caught up after lagging behind get the edits they missed at once
+		for (const ClientSptr &client: lagging)
+		{ this->resync(*client); }
 
 		// process received messages
-		for (const Message &message: messages)
+		for (const MessageView &message: messages)
 		{
-			// skip if message is empty or invalid
-			if (message.is_empty() || message.type == Message::TYPE_INVALID)
+			// the rest is handled by the NetworkInterface the client is handed to
+			if (this->is_departing(*message.source))
 			{ continue; }
 
 			// trigger events for all event handlers
 			for (const NetworkMessageHandler &handler: message_handlers)
-			{ handler(message); }
+			{ handler(*this, message); }
 		}
+
+		// the handlers copied what they keep, the receive buffers may move on
+		for (const MessageView &message: messages)
+		{
+			if (!this->is_departing(*message.source))
+			{ message.source->release_messages(); }
+		}
+
+		// the messages of disconnected clients are handled, forget their documents
+		for (const ClientSptr &client: disconnected)
+		{ this->leave_document(*client); }
+
+		this->depart();
 	}
+
+	epoll_ctl(this->poller, EPOLL_CTL_DEL, ipc_socket, 0);
+}
+
+void NetworkInterface::accept_clients(void)
+{
+	// the listener doesn't block, take all pending connections at once
+	while (true)
+	{
+		try
+		{
+			Client &client = this->clients.accept_client(this->listener);
+			this->watch(client.socket, client_events);
+		}
+		catch (const Exception::ErrnoError &error)
+		{
+			if (error.error == EAGAIN || error.error == EWOULDBLOCK)
+			{ return; }
+			if (error.error == EINTR || error.error == ECONNABORTED)
+			{ continue; }
+			throw;
+		}
+	}
+}
+
+void NetworkInterface::watch(int fd, uint32_t events)
+{
+	struct epoll_event event = {};
+	event.events = events;
+	event.data.fd = fd;
+	if (epoll_ctl(this->poller, EPOLL_CTL_ADD, fd, &event) == -1)
+	{ throw Exception::ErrnoError("failed to watch descriptor", "epoll_ctl"); }
+}
+
+void NetworkInterface::hand_over(const MessageView &message, size_t owner)
+{
+	if (!this->is_departing(*message.source))
+	{ this->departures.push_back(Departure { message.source, &message, owner }); }
+}
+
+void NetworkInterface::admit(ClientSptr client)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->arrivals_mutex);
+		this->arrivals.push_back(client);
+	}
+
+	const uint64_t arrived = 1;
+	if (write(this->arrivals_fd, &arrived, sizeof(arrived)) == -1 && errno != EAGAIN)
+	{ throw Exception::ErrnoError("failed to signal arrival", "write"); }
+}
+
+void NetworkInterface::admit_clients(MessageList &messages, MessageList::iterator &tail,
+	std::vector<ClientSptr> &disconnected)
+{
+	uint64_t arrived;
+	if (read(this->arrivals_fd, &arrived, sizeof(arrived)) == -1 && errno != EAGAIN)
+	{ throw Exception::ErrnoError("failed to read arrival event", "read"); }
+
+	std::vector<ClientSptr> admitted;
+	{
+		std::lock_guard<std::mutex> lock(this->arrivals_mutex);
+		admitted.swap(this->arrivals);
+	}
+
+	for (const ClientSptr &client: admitted)
+	{
+		this->clients.add_client(client);
+		this->watch(client->socket, client_events);
+		this->clients.receive_messages(client->socket, false, messages, tail, disconnected);
+	}
+}
+
+bool NetworkInterface::is_departing(const Client &client) const
+{
+	for (const Departure &departure: this->departures)
+	{
+		if (departure.client.get() == &client)
+		{ return true; }
+	}
+
+	return false;
+}
+
+void NetworkInterface::depart(void)
+{
+	for (const Departure &departure: this->departures)
+	{
+		// clients that disconnected meanwhile aren't worth handing over
+		if (!this->clients.contains(*departure.client))
+		{ continue; }
+
+		this->clients.remove_client(departure.client->socket);
+		epoll_ctl(this->poller, EPOLL_CTL_DEL, departure.client->socket, 0);
+		this->leave_document(*departure.client);
+
+		// decode the message that asked for the other NetworkInterface once more over there
+		departure.client->rewind(*departure.message);
+		departure.client->release_messages();
+		this->pool->get_interface(departure.owner).admit(departure.client);
+	}
+
+	this->departures.clear();
+}
+
+void NetworkInterface::leave_document(Client &client)
+{
+	try
+	{
+		DocumentManager::document_ptr document = this->documents.find(client.active_document);
+		if (document)
+		{ document->get_cursors().remove(client.socket); }
+	}
+	catch (const document_errors::DocumentError &)
+	{}
+
+	this->documents.release(client.active_document);
+	client.active_document = 0;
+	client.viewport = Viewport();
+}
+
+void NetworkInterface::resync(Client &client)
+{
+	DocumentManager::document_ptr document;
+	try
+	{ document = this->documents.find(client.active_document); }
+	catch (const document_errors::DocumentError &)
+	{}
+
+	if (!document)
+	{ return; }
+
+	// the viewport followed all edits, only its contents are behind
+	const size_t size = document->size();
+	Message response;
+	response.type = Message::TYPE_DOC_VIEWPORT;
+	response.id = client.active_document;
+	response.position = std::min(client.viewport.begin(), size);
+	response.length = std::min(client.viewport.end(), size) - response.position;
+	response.status = response.length ? Message::STATUS_OK_CONTENTS_FOLLOWING
+		: Message::STATUS_OK;
+	response.send_to(client);
+
+	if (!response.length)
+	{ return; }
+
+	Message contents;
+	contents.type = Message::TYPE_SYNC_MULTIBYTE;
+	contents.position = response.position;
+	contents.length = response.length;
+	contents.stream_to(client, *document);
 }
@@ -7,12 +7,24 @@
 #ifndef _NETWORKINTERFACE_H_
 #define _NETWORKINTERFACE_H_
 
+#include <cstddef> // size_t
+#include <cstdint> // uint32_t
 #include <forward_list>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include "ClientCollection.h"
+#include "Database.h"
+#include "DocumentCatalog.h"
+#include "DocumentManager.h"
+#include "SaveQueue.h"
 
-typedef void (*NetworkMessageHandler)(const Message &);
+class NetworkInterface;
+class NetworkPool;
+
+/// the message is only valid during the call, see MessageView
+typedef void (*NetworkMessageHandler)(NetworkInterface &, const MessageView &);
 
 class NetworkInterface
 {
@@ -22,16 +34,36 @@ class NetworkInterface
 			Creates and binds a listening socket and sets it to listening state.
 				 port - port to bind on
 				*backlog -> <sys/socket.h> listen(backlog)
+				*database - database to keep the document catalog in, none for no catalog
 			=#	Exception::ErrnoError - listening socket creation failed
 			=#	Exception::ErrnoError - network address structure generation failed
 			=#	Exception::ErrnoError - listening socket binding failed
 			=#	Exception::ErrnoError - listening failed
+			=#	Exception::ErrnoError - epoll instance creation or registration failed
+			=#	DocumentCatalog::DocumentCatalog
+		**/
+		NetworkInterface(int port, int backlog = 4,
+			std::shared_ptr<Database> database = std::shared_ptr<Database>());
+		/**
+			Constructor for a member of a NetworkPool, which listens on a port shared with the
+			other members.
+				port - port to bind on
+				backlog -> <sys/socket.h> listen(backlog)
+				catalog - catalog shared by the pool, null for no catalog
+				pool
+				index - index within the pool
+			=#	NetworkInterface::NetworkInterface(int, int, std::shared_ptr<Database>)
 		**/
-		NetworkInterface(int port, int backlog = 4);
+		NetworkInterface(int port, int backlog, std::shared_ptr<DocumentCatalog> catalog,
+			NetworkPool &pool, size_t index);
+		/**
+			Closes the listening socket, the epoll instance and the arrival event.
+		**/
+		~NetworkInterface(void);
 		
 		/**
 			Adds a message handler to this NetworkInterface. Each added handler will get called for
-			each received Message.
+			each received MessageView.
 			The given handler will be added to the list regardless of whether it's already there or
 			not.
 			The invocation order is the addition order reversed, i.e. the first added handler will
@@ -44,18 +76,154 @@ class NetworkInterface
 				handler
 		**/
 		void remove_message_handler(const NetworkMessageHandler handler);		
+		/**
+			Returns the queue saving documents off this' thread. Its completions are dispatched by
+			run, so they may safely send messages to the clients.
+			=>	the save queue
+		**/
+		SaveQueue &get_save_queue()
+		{ return saves; }
+		/**
+			Returns the table of open documents shared by all clients. Idle documents are
+			hibernated by run.
+			=>	the document table
+		**/
+		DocumentManager &get_documents()
+		{ return documents; }
+		/**
+			Returns the catalog of all documents, which is kept up to date by run.
+			=>	the document catalog, null if this was constructed without a database
+		**/
+		DocumentCatalog *get_catalog()
+		{ return catalog.get(); }
+		/**
+			Returns the connected clients.
+			=>	the client collection
+		**/
+		ClientCollection &get_clients()
+		{ return clients; }
+		/**
+			Returns the pool this belongs to.
+			=>	the pool, null if this was constructed on its own
+		**/
+		NetworkPool *get_pool()
+		{ return pool; }
+		/**
+			Returns the index of this within its pool.
+			=>	the index, 0 if this was constructed on its own
+		**/
+		size_t get_index() const
+		{ return index; }
+		/**
+			Hands the source of a message to another NetworkInterface of the pool, which handles
+			the message and the ones received behind it instead of this. The source leaves its
+			active document. Takes effect once the messages received so far are handled.
+				message
+				owner - index of the other NetworkInterface
+		**/
+		void hand_over(const MessageView &message, size_t owner);
+		/**
+			Takes over a Client handed over by another NetworkInterface of the pool. Safe to call
+			from any thread.
+				client - a Client no other NetworkInterface knows anymore
+			=#	Exception::ErrnoError - if this can't be woken up
+		**/
+		void admit(ClientSptr client);
 		/**
 			Main routine that looks for incoming client connections and messages and processes the
-			latter as necessary.
-			=#	Exception::ErrnoError - select failed
-			=#	ClientCollection::add_client
+			latter as necessary. Also dispatches the completions of finished document saves,
+			hibernates idle documents and passes changes of the document directory to the catalog.
+			Client sockets are watched edge-triggered with epoll, so a wakeup only costs as much as
+			the clients that actually sent something or became writable, however many are
+			connected. Sending never blocks, the queues of lagging clients are drained whenever
+			their sockets become writable, see Client::send.
+				ipc_socket - socket that ends the routine once it becomes readable
+			=#	Exception::ErrnoError - epoll_wait failed
+			=#	NetworkInterface::accept_clients
 		**/
 		void run(int ipc_socket);
 	
 	private:
+		/// seconds between checks for idle documents
+		static const int hibernation_interval = 10;
+		/// most events handled per wakeup, the remaining ones are reported by the next one
+		static const int max_events = 256;
+		/// events of client sockets, writability drains the queues of lagging clients
+		static const uint32_t client_events;
+
+		/**
+			Accepts all pending client connections and watches their sockets.
+			=#	ClientCollection::accept_client - unless no connection is pending anymore
+			=#	NetworkInterface::watch
+		**/
+		void accept_clients(void);
+		/**
+			Adds a descriptor to the epoll instance.
+				fd
+				events -> <sys/epoll.h> epoll_event::events
+			=#	Exception::ErrnoError - if epoll_ctl fails
+		**/
+		void watch(int fd, uint32_t events);
+
+		/// a client leaving for another NetworkInterface, see hand_over
+		struct Departure
+		{
+			ClientSptr			 client;
+			const MessageView	*message;
+			size_t				 owner;
+		};
+
+		/**
+			Creates, binds and watches the listening socket and sets up the epoll instance.
+				port
+				backlog
+			=#	see NetworkInterface::NetworkInterface
+		**/
+		void open(int port, int backlog);
+		/**
+			Adds the Clients handed over by other NetworkInterfaces and decodes the messages they
+			brought along, see ClientCollection::receive_messages.
+			=#	Exception::ErrnoError - if the arrival event can't be read
+			=#	NetworkInterface::watch
+		**/
+		void admit_clients(MessageList &messages, MessageList::iterator &tail,
+			std::vector<ClientSptr> &disconnected);
+		/**
+			Checks whether a client is about to be handed over.
+				client
+		**/
+		bool is_departing(const Client &client) const;
+		/**
+			Hands the clients over that asked for it, see hand_over.
+			=#	NetworkInterface::admit
+		**/
+		void depart(void);
+		/**
+			Removes the cursor of a client from its active document and lets the document table
+			know the client stopped working on it, e.g. after it disconnected.
+				client
+		**/
+		void leave_document(Client &client);
+		/**
+			Sends a client that lagged behind its window of the active document anew, as the
+			response to a TYPE_DOC_VIEWPORT message followed by the contents.
+				client
+		**/
+		void resync(Client &client);
+
 		ClientCollection							clients;
 		int											listener;
+		int											poller;
+		int											arrivals_fd;
 		std::forward_list<NetworkMessageHandler>	message_handlers;
+		SaveQueue									saves;
+		std::shared_ptr<DocumentCatalog>			catalog;
+		DocumentManager								documents;
+		NetworkPool									*pool;
+		size_t										index;
+		std::vector<Departure>						departures;
+		std::mutex									arrivals_mutex;
+		std::vector<ClientSptr>						arrivals;
 };
 
 #endif
@@ -0,0 +1,109 @@
+/**
+	file: NetworkPool.cpp
+	author: Maximilian Lasser [max.lasser@online.de]
+	created: Saturday, 16th June 2012
+**/
+
+#include <algorithm> // max
+#include <exception>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+
+#include "exceptions.h"
+#include "NetworkPool.h"
+
+NetworkPool::NetworkPool(int port, size_t size, int backlog, std::shared_ptr<Database> database):
+	catalog(database ? std::make_shared<DocumentCatalog>(database)
+		: std::shared_ptr<DocumentCatalog>())
+{
+	for (size_t index = 0; index < std::max<size_t>(size, 1); ++index)
+	{
+		this->interfaces.push_back(std::unique_ptr<NetworkInterface>(
+			new NetworkInterface(port, backlog, this->catalog, *this, index)));
+	}
+}
+
+void NetworkPool::add_message_handler(const NetworkMessageHandler handler)
+{
+	for (const std::unique_ptr<NetworkInterface> &interface: this->interfaces)
+	{ interface->add_message_handler(handler); }
+}
+
+void NetworkPool::run(int ipc_socket)
+{
+	// stays readable once written, which ends the loops of all NetworkInterfaces
+	const int stop = eventfd(0, EFD_CLOEXEC);
+	if (stop == -1)
+	{ throw Exception::ErrnoError("failed to create stop event", "eventfd"); }
+
+	std::vector<std::exception_ptr> errors(this->interfaces.size());
+	std::vector<std::thread> threads;
+	for (size_t index = 0; index < this->interfaces.size(); ++index)
+	{
+		threads.push_back(std::thread([this, index, stop, &errors]()
+			{
+				try
+				{ this->interfaces[index]->run(stop); }
+				catch (...)
+				{
+					// take the others down as well
+					errors[index] = std::current_exception();
+					const uint64_t failed = 1;
+					if (write(stop, &failed, sizeof(failed)) == -1)
+					{ std::terminate(); }
+				}
+			}));
+	}
+
+	// wait for the quit request or a failed NetworkInterface
+	struct pollfd descriptors[] = { { ipc_socket, POLLIN, 0 }, { stop, POLLIN, 0 } };
+	while (poll(descriptors, 2, -1) == -1 && errno == EINTR)
+	{}
+
+	const uint64_t quit = 1;
+	if (write(stop, &quit, sizeof(quit)) == -1)
+	{ std::terminate(); }
+
+	for (std::thread &thread: threads)
+	{ thread.join(); }
+	close(stop);
+
+	for (const std::exception_ptr &error: errors)
+	{
+		if (error)
+		{ std::rethrow_exception(error); }
+	}
+}
+
+size_t NetworkPool::owner_of(int32_t id, size_t asking)
+{
+	std::lock_guard<std::mutex> lock(this->owners_mutex);
+
+	std::unordered_map<int32_t, size_t>::const_iterator owner = this->owners_by_id.find(id);
+	return owner == this->owners_by_id.end() ? asking : owner->second;
+}
+
+bool NetworkPool::claim(const std::string &name, size_t claiming, size_t &owner)
+{
+	std::lock_guard<std::mutex> lock(this->owners_mutex);
+
+	std::pair<std::unordered_map<std::string, size_t>::iterator, bool> claimed =
+		this->owners_by_name.insert(std::make_pair(name, claiming));
+	owner = claimed.first->second;
+
+	return claimed.second;
+}
+
+void NetworkPool::assign(int32_t id, size_t owner)
+{
+	std::lock_guard<std::mutex> lock(this->owners_mutex);
+	this->owners_by_id[id] = owner;
+}
+
+void NetworkPool::forget(const std::string &name)
+{
+	std::lock_guard<std::mutex> lock(this->owners_mutex);
+	this->owners_by_name.erase(name);
+}
@@ -0,0 +1,111 @@
+/**
+	file: NetworkPool.h
+	author: Maximilian Lasser [max.lasser@online.de]
+	created: Saturday, 16th June 2012
+**/
+
+#ifndef _NETWORKPOOL_H_
+#define _NETWORKPOOL_H_
+
+#include <cstddef> // size_t
+#include <cstdint> // int32_t
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Database.h"
+#include "DocumentCatalog.h"
+#include "NetworkInterface.h"
+
+/*
+	A pool of NetworkInterfaces, each running its own event loop in a thread of its own. All of
+	them listen on the same port with SO_REUSEPORT, so the kernel spreads the connections.
+	Every document is owned by exactly one NetworkInterface: the one that first opened, created
+	or cloned it. A client asking for a document of another NetworkInterface is handed over to
+	that one, so a document and all clients working on it are only touched by a single thread
+	and editing needs no locks. Only the table of owners below and the shared catalog are
+	locked, which opening documents needs, but editing doesn't.
+*/
+class NetworkPool
+{
+	public:
+		/**
+			Creates the NetworkInterfaces.
+				 port - port all of them listen on
+				 size - number of NetworkInterfaces, at least 1
+				*backlog -> <sys/socket.h> listen(backlog)
+				*database - database to keep the document catalog in, none for no catalog
+			=#	NetworkInterface::NetworkInterface
+			=#	DocumentCatalog::DocumentCatalog
+		**/
+		NetworkPool(int port, size_t size, int backlog = 4,
+			std::shared_ptr<Database> database = std::shared_ptr<Database>());
+
+		/**
+			Adds a message handler to all NetworkInterfaces, see
+			NetworkInterface::add_message_handler. The handler gets called from several threads at
+			once, each with the NetworkInterface it's called for.
+				handler
+		**/
+		void add_message_handler(const NetworkMessageHandler handler);
+		/**
+			Runs the event loops of all NetworkInterfaces, each in a thread of its own, until the
+			given socket becomes readable or one of them fails.
+				ipc_socket
+			=#	the exception of the NetworkInterface that failed
+			=#	Exception::ErrnoError - if the threads can't be stopped
+		**/
+		void run(int ipc_socket);
+
+		/**
+			=>	number of NetworkInterfaces
+		**/
+		size_t size(void) const
+		{ return this->interfaces.size(); }
+		/**
+			=>	the NetworkInterface with the given index
+		**/
+		NetworkInterface &get_interface(size_t index)
+		{ return *this->interfaces[index]; }
+
+		/**
+			Looks up the owner of a document by id. Unknown ids stay with the asking
+			NetworkInterface, which will report them missing.
+				id
+				asking - index of the asking NetworkInterface
+			=>	index of the owner
+		**/
+		size_t owner_of(int32_t id, size_t asking);
+		/**
+			Makes a NetworkInterface the owner of a document by name, unless it's owned already.
+			Claims are made before opening a document, so two threads never open the same one.
+				 name
+				 claiming - index of the claiming NetworkInterface
+				&owner - receives the index of the owner
+			=>	true if the claim is new, it should be dropped if opening the document fails
+		**/
+		bool claim(const std::string &name, size_t claiming, size_t &owner);
+		/**
+			Records the id of a document once it's known.
+				id
+				owner - index of the owning NetworkInterface
+		**/
+		void assign(int32_t id, size_t owner);
+		/**
+			Drops the claim of a document, e.g. after removing it.
+				name
+		**/
+		void forget(const std::string &name);
+
+	private:
+		// outlives the NetworkInterfaces, their document tables use it when being destroyed
+		std::shared_ptr<DocumentCatalog>				catalog;
+		std::vector<std::unique_ptr<NetworkInterface>>	interfaces;
+		std::mutex										owners_mutex;
+		std::unordered_map<std::string, size_t>			owners_by_name;
+		std::unordered_map<int32_t, size_t>				owners_by_id;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef PERSISTENTTREAP_H_INCLUDED
+#define PERSISTENTTREAP_H_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+/**
+ * @file PersistentTreap.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * A persistent (immutable, structurally shared) treap which is indexed
+ * by the accumulated length of its values instead of by keys.
+ *
+ * Every modifying operation copies only the path to the modified node,
+ * so a root pointer is a cheap snapshot of the whole sequence.
+ *
+ * On equal priorities the left value becomes the ancestor. Unless values
+ * are split or modified, the shape of a tree therefore only depends on
+ * the sequence of values and their priorities, not on the operations
+ * which produced it.
+ *
+ * The Traits type has to provide:
+ *
+ *   typedef ... value_type;
+ *   typedef ... summary_type; // default constructed: the empty summary
+ *   static summary_type measure(value_type const &);
+ *   static summary_type combine(summary_type const &, summary_type const &);
+ *   static std::size_t length(summary_type const &);
+ *   static std::uint64_t priority(value_type const &);
+ *   static std::pair<value_type, value_type> split(value_type const &, std::size_t);
+ */
+
+template <class Traits>
+class PersistentTreap
+{
+public:
+	typedef typename Traits::value_type value_type;
+	typedef typename Traits::summary_type summary_type;
+
+	struct Node;
+	typedef std::shared_ptr<Node const> node_ptr;
+
+	struct Node
+	{
+		Node(value_type const &value, std::uint64_t priority,
+		     node_ptr const &left, node_ptr const &right);
+
+		value_type const value;
+		std::uint64_t const priority;
+		node_ptr const left;
+		node_ptr const right;
+		summary_type const summary;
+	};
+
+	/**
+	 * Obtain the summary of a (possibly empty) tree.
+	 */
+	static summary_type summary(node_ptr const &node);
+
+	/**
+	 * Obtain the accumulated length of a (possibly empty) tree.
+	 */
+	static std::size_t length(node_ptr const &node);
+
+	/**
+	 * Create a tree holding exactly one value.
+	 */
+	static node_ptr make(value_type const &value);
+
+	/**
+	 * Concatenate two trees.
+	 */
+	static node_ptr merge(node_ptr const &left, node_ptr const &right);
+
+	/**
+	 * Split a tree at an offset. A value straddling the offset is split
+	 * with Traits::split.
+	 *
+	 * @return The trees holding [0, offset) and [offset, length).
+	 */
+	static std::pair<node_ptr, node_ptr> split(node_ptr const &node, std::size_t offset);
+
+	/**
+	 * Replace the value containing the offset.
+	 *
+	 * @param f Called as f(value, offset_in_value), returns the new value.
+	 * @return The new root.
+	 */
+	template <class F>
+	static node_ptr modify(node_ptr const &node, std::size_t offset, F f);
+
+	/**
+	 * Find the value containing an offset.
+	 *
+	 * @param local Receives the offset relative to the start of the value.
+	 * @return The node or 0 if the offset is out of range.
+	 */
+	static Node const *find(node_ptr const &node, std::size_t offset, std::size_t &local);
+
+	/**
+	 * Visit all values intersecting [begin, end) in order.
+	 *
+	 * @param f Called as f(value, local_begin, local_end) for every value,
+	 *          where the local range is the intersecting part of the value.
+	 */
+	template <class F>
+	static void for_each(node_ptr const &node, std::size_t begin, std::size_t end, F &f);
+
+private:
+	static node_ptr copy_with(Node const &node, node_ptr const &left, node_ptr const &right);
+};
+
+#include "PersistentTreap.tcc"
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef PERSISTENTTREAP_TCC_INCLUDED
+#define PERSISTENTTREAP_TCC_INCLUDED
+
+#include "PersistentTreap.h"
+
+#include <algorithm>
+
+template <class Traits>
+PersistentTreap<Traits>::Node::Node(value_type const &value, std::uint64_t priority,
+                                    node_ptr const &left, node_ptr const &right)
+	: value(value),
+	  priority(priority),
+	  left(left),
+	  right(right),
+	  summary(Traits::combine(
+		  Traits::combine(PersistentTreap::summary(left), Traits::measure(value)),
+		  PersistentTreap::summary(right)))
+{
+}
+
+template <class Traits>
+typename PersistentTreap<Traits>::summary_type PersistentTreap<Traits>::summary(
+	node_ptr const &node)
+{
+	return node ? node->summary : summary_type();
+}
+
+template <class Traits>
+std::size_t PersistentTreap<Traits>::length(node_ptr const &node)
+{
+	return node ? Traits::length(node->summary) : 0;
+}
+
+template <class Traits>
+typename PersistentTreap<Traits>::node_ptr PersistentTreap<Traits>::make(
+	value_type const &value)
+{
+	return std::make_shared<Node const>(value, Traits::priority(value), node_ptr(), node_ptr());
+}
+
+template <class Traits>
+typename PersistentTreap<Traits>::node_ptr PersistentTreap<Traits>::merge(
+	node_ptr const &left, node_ptr const &right)
+{
+	if (!left)
+	{
+		return right;
+	}
+
+	if (!right)
+	{
+		return left;
+	}
+
+	if (left->priority >= right->priority)
+	{
+		return copy_with(*left, left->left, merge(left->right, right));
+	}
+
+	return copy_with(*right, merge(left, right->left), right->right);
+}
+
+template <class Traits>
+std::pair<typename PersistentTreap<Traits>::node_ptr, typename PersistentTreap<Traits>::node_ptr>
+PersistentTreap<Traits>::split(node_ptr const &node, std::size_t offset)
+{
+	if (!node)
+	{
+		return std::make_pair(node_ptr(), node_ptr());
+	}
+
+	std::size_t const left_length = length(node->left);
+	std::size_t const own_length = Traits::length(Traits::measure(node->value));
+
+	if (offset <= left_length)
+	{
+		auto const parts = split(node->left, offset);
+
+		return std::make_pair(parts.first, copy_with(*node, parts.second, node->right));
+	}
+
+	if (offset >= left_length + own_length)
+	{
+		auto const parts = split(node->right, offset - left_length - own_length);
+
+		return std::make_pair(copy_with(*node, node->left, parts.first), parts.second);
+	}
+
+	// the offset is inside of this value, the left half keeps the position in the heap
+	auto const values = Traits::split(node->value, offset - left_length);
+
+	return std::make_pair(
+		std::make_shared<Node const>(values.first, node->priority, node->left, node_ptr()),
+		merge(make(values.second), node->right));
+}
+
+template <class Traits>
+template <class F>
+typename PersistentTreap<Traits>::node_ptr PersistentTreap<Traits>::modify(
+	node_ptr const &node, std::size_t offset, F f)
+{
+	if (!node)
+	{
+		return node;
+	}
+
+	std::size_t const left_length = length(node->left);
+	std::size_t const own_length = Traits::length(Traits::measure(node->value));
+
+	if (offset < left_length)
+	{
+		return copy_with(*node, modify(node->left, offset, f), node->right);
+	}
+
+	if (offset >= left_length + own_length)
+	{
+		return copy_with(*node, node->left,
+			modify(node->right, offset - left_length - own_length, f));
+	}
+
+	return std::make_shared<Node const>(
+		f(node->value, offset - left_length), node->priority, node->left, node->right);
+}
+
+template <class Traits>
+typename PersistentTreap<Traits>::Node const *PersistentTreap<Traits>::find(
+	node_ptr const &node, std::size_t offset, std::size_t &local)
+{
+	Node const *current = node.get();
+
+	while (current)
+	{
+		std::size_t const left_length = length(current->left);
+		std::size_t const own_length = Traits::length(Traits::measure(current->value));
+
+		if (offset < left_length)
+		{
+			current = current->left.get();
+		}
+		else if (offset < left_length + own_length)
+		{
+			local = offset - left_length;
+			return current;
+		}
+		else
+		{
+			offset -= left_length + own_length;
+			current = current->right.get();
+		}
+	}
+
+	return 0;
+}
+
+template <class Traits>
+template <class F>
+void PersistentTreap<Traits>::for_each(node_ptr const &node, std::size_t begin,
+                                       std::size_t end, F &f)
+{
+	if (!node || begin >= end)
+	{
+		return;
+	}
+
+	std::size_t const left_length = length(node->left);
+	std::size_t const own_end = left_length + Traits::length(Traits::measure(node->value));
+
+	if (begin < left_length)
+	{
+		for_each(node->left, begin, std::min(end, left_length), f);
+	}
+
+	std::size_t const local_begin = std::max(begin, left_length);
+	std::size_t const local_end = std::min(end, own_end);
+
+	if (local_begin < local_end)
+	{
+		f(node->value, local_begin - left_length, local_end - left_length);
+	}
+
+	if (end > own_end)
+	{
+		for_each(node->right, std::max(begin, own_end) - own_end, end - own_end, f);
+	}
+}
+
+template <class Traits>
+typename PersistentTreap<Traits>::node_ptr PersistentTreap<Traits>::copy_with(
+	Node const &node, node_ptr const &left, node_ptr const &right)
+{
+	return std::make_shared<Node const>(node.value, node.priority, left, right);
+}
+
+#endif
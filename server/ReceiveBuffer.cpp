@@ -0,0 +1,81 @@
+/**
+	file: ReceiveBuffer.cpp
+	author: Maximilian Lasser [max.lasser@online.de]
+	created: Thursday, 14th June 2012
+**/
+
+#include <algorithm> // max
+#include <cerrno>
+#include <cstring> // memmove
+#include <sys/socket.h>
+#include "exceptions.h"
+#include "ReceiveBuffer.h"
+
+const size_t ReceiveBuffer::RECEIVE_CHUNK_SIZE;
+
+ReceiveBuffer::ReceiveBuffer(void):
+	capacity(0), begin(0), end(0)
+{}
+
+bool ReceiveBuffer::fill(int socket)
+{
+	while (true)
+	{
+		this->reserve();
+
+		const size_t space = this->capacity - this->end;
+		ssize_t received = recv(socket, this->bytes.get() + this->end, space, MSG_DONTWAIT);
+		if (received == -1)
+		{
+			if (errno == EINTR)
+			{ continue; }
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{ return true; }
+			throw Exception::ErrnoError("message reception failed", "recv");
+		}
+		if (received == 0)
+		{ return false; }
+
+		this->end += received;
+
+		// a short read means the socket is drained, spare the call that would tell so
+		if (static_cast<size_t>(received) < space)
+		{ return true; }
+	}
+}
+
+void ReceiveBuffer::consume(size_t size)
+{
+	this->begin += size;
+
+	if (this->begin == this->end)
+	{
+		this->bytes.reset();
+		this->capacity = this->begin = this->end = 0;
+	}
+}
+
+void ReceiveBuffer::reserve(void)
+{
+	if (this->capacity - this->end >= RECEIVE_CHUNK_SIZE)
+	{ return; }
+
+	const size_t unparsed = this->size();
+
+	// move the unparsed bytes to the front if that makes enough room, grow otherwise
+	if (this->capacity - unparsed >= RECEIVE_CHUNK_SIZE)
+	{ std::memmove(this->bytes.get(), this->data(), unparsed); }
+	else
+	{
+		const size_t capacity = std::max(2 * this->capacity, unparsed + RECEIVE_CHUNK_SIZE);
+		std::unique_ptr<char[]> bytes(new char[capacity]);
+		if (unparsed)
+		{ std::memcpy(bytes.get(), this->data(), unparsed); }
+
+		this->bytes = std::move(bytes);
+		this->capacity = capacity;
+	}
+
+	this->begin = 0;
+	this->end = unparsed;
+}
@@ -0,0 +1,64 @@
+/**
+	file: ReceiveBuffer.h
+	author: Maximilian Lasser [max.lasser@online.de]
+	created: Thursday, 14th June 2012
+**/
+
+#ifndef _RECEIVEBUFFER_H_
+#define _RECEIVEBUFFER_H_
+
+#include <cstddef> // size_t
+#include <memory>
+
+/*
+	Bytes received from a socket but not parsed yet. The bytes are kept contiguous, so a message
+	can be parsed straight from the buffer: consumed bytes are only moved out of the way when the
+	free space behind the unparsed ones runs short, and the memory is released as soon as
+	everything was consumed, so idle connections hold no buffer at all.
+*/
+class ReceiveBuffer
+{
+	public:
+		/// free space offered to a single recv call at least
+		static const size_t RECEIVE_CHUNK_SIZE = 64 * 1024;
+
+		ReceiveBuffer(void);
+
+		/*
+			Receives everything the socket has available without blocking, in recv calls of at
+			least RECEIVE_CHUNK_SIZE bytes.
+				socket
+			=>	false if the peer closed the connection
+			=#	Exception::ErrnoError - if recv fails
+		*/
+		bool fill(int socket);
+		/*
+			Drops bytes from the front after they have been parsed.
+				size - number of bytes, at most size()
+		*/
+		void consume(size_t size);
+
+		/*
+			=>	the first unparsed byte
+		*/
+		const char *data(void) const
+		{ return this->bytes.get() + this->begin; }
+		/*
+			=>	number of unparsed bytes
+		*/
+		size_t size(void) const
+		{ return this->end - this->begin; }
+
+	private:
+		/*
+			Makes room for at least RECEIVE_CHUNK_SIZE bytes behind the unparsed ones.
+		*/
+		void reserve(void);
+
+		std::unique_ptr<char[]>	bytes;
+		size_t					capacity;
+		size_t					begin;
+		size_t					end;
+};
+
+#endif
@@ -0,0 +1,291 @@
+#include "Rope.h"
+
+#include <cstring>
+#include <sstream>
+
+/**
+ * @file Rope.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the rope.
+ */
+
+namespace
+{
+	// size of the buffers insertions are appended to
+	std::size_t const g_append_buffer_size = 64 * 1024;
+
+	class HeapBuffer
+		: public Rope::Buffer
+	{
+	public:
+		explicit HeapBuffer(std::vector<char> bytes)
+			: bytes_(std::move(bytes))
+		{
+		}
+
+		char const *data() const
+		{
+			return bytes_.data();
+		}
+
+		std::size_t size() const
+		{
+			return bytes_.size();
+		}
+
+	private:
+		std::vector<char> const bytes_;
+	};
+
+	// the finalizer of splitmix64, good enough to scatter treap priorities
+	std::uint64_t mix(std::uint64_t value)
+	{
+		value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+
+		return value ^ (value >> 31);
+	}
+}
+
+namespace rope_errors
+{
+	OutOfRangeError::OutOfRangeError(std::string const &message)
+		: std::out_of_range(message)
+	{
+	}
+}
+
+using namespace rope_errors;
+
+/**
+ * A buffer of fixed capacity which is only ever appended to. Bytes
+ * which were handed out to pieces are never touched again, so it's
+ * safe to share them with copies of the rope.
+ */
+class Rope::AppendBuffer
+	: public Rope::Buffer
+{
+public:
+	explicit AppendBuffer(std::size_t capacity)
+		: bytes_(new char[capacity]),
+		  capacity_(capacity),
+		  used_(0)
+	{
+	}
+
+	char const *data() const
+	{
+		return bytes_.get();
+	}
+
+	std::size_t size() const
+	{
+		return used_;
+	}
+
+	bool fits(std::size_t length) const
+	{
+		return capacity_ - used_ >= length;
+	}
+
+	std::size_t append(char const *bytes, std::size_t length)
+	{
+		std::size_t const offset = used_;
+
+		std::memcpy(bytes_.get() + used_, bytes, length);
+		used_ += length;
+
+		return offset;
+	}
+
+private:
+	std::unique_ptr<char[]> const bytes_;
+	std::size_t const capacity_;
+	std::size_t used_;
+};
+
+Rope::Buffer::~Buffer()
+{
+}
+
+Rope::buffer_ptr Rope::make_buffer(std::vector<char> bytes)
+{
+	return std::make_shared<HeapBuffer>(std::move(bytes));
+}
+
+std::uint64_t Rope::PieceTraits::priority(Piece const &piece)
+{
+	// derived from the position of the piece instead of a shared random generator
+	return mix(reinterpret_cast<std::uintptr_t>(piece.buffer.get()) ^ mix(piece.offset));
+}
+
+std::pair<Rope::Piece, Rope::Piece> Rope::PieceTraits::split(Piece const &piece,
+                                                               std::size_t offset)
+{
+	Piece const left = { piece.buffer, piece.offset, offset };
+	Piece const right = { piece.buffer, piece.offset + offset, piece.length - offset };
+
+	return std::make_pair(left, right);
+}
+
+Rope::Rope()
+{
+}
+
+Rope::Rope(buffer_ptr const &buffer)
+{
+	if (buffer->size())
+	{
+		Piece const piece = { buffer, 0, buffer->size() };
+
+		root_ = tree::make(piece);
+	}
+}
+
+Rope::Rope(std::vector<buffer_ptr> const &buffers)
+{
+	for (auto const &buffer: buffers)
+	{
+		if (buffer->size())
+		{
+			Piece const piece = { buffer, 0, buffer->size() };
+
+			root_ = tree::merge(root_, tree::make(piece));
+		}
+	}
+}
+
+Rope::Rope(Rope const &other)
+	: root_(other.root_)
+{
+}
+
+Rope &Rope::operator=(Rope const &other)
+{
+	root_ = other.root_;
+	append_.reset();
+
+	return *this;
+}
+
+Rope::Rope(Rope &&other)
+	: root_(std::move(other.root_)),
+	  append_(std::move(other.append_))
+{
+}
+
+Rope &Rope::operator=(Rope &&other)
+{
+	root_ = std::move(other.root_);
+	append_ = std::move(other.append_);
+
+	return *this;
+}
+
+Rope::~Rope()
+{
+}
+
+void Rope::insert(std::size_t offset, char const *bytes, std::size_t length)
+{
+	check_range(offset, 0);
+
+	if (!length)
+	{
+		return;
+	}
+
+	// continue the piece which ends at the offset if it was the last one appended
+	if (offset && append_ && append_->fits(length))
+	{
+		std::size_t local;
+		tree::Node const *node = tree::find(root_, offset - 1, local);
+
+		if (node->value.buffer == append_ &&
+		    local + 1 == node->value.length &&
+		    node->value.offset + node->value.length == append_->size())
+		{
+			append_->append(bytes, length);
+
+			root_ = tree::modify(root_, offset - 1,
+				[length](Piece const &piece, std::size_t)
+				{
+					Piece const grown = { piece.buffer, piece.offset, piece.length + length };
+
+					return grown;
+				});
+
+			return;
+		}
+	}
+
+	Piece piece;
+
+	if (length > g_append_buffer_size)
+	{
+		piece.buffer = make_buffer(std::vector<char>(bytes, bytes + length));
+		piece.offset = 0;
+	}
+	else
+	{
+		if (!append_ || !append_->fits(length))
+		{
+			append_ = std::make_shared<AppendBuffer>(g_append_buffer_size);
+		}
+
+		piece.buffer = append_;
+		piece.offset = append_->append(bytes, length);
+	}
+
+	piece.length = length;
+
+	auto const parts = tree::split(root_, offset);
+
+	root_ = tree::merge(tree::merge(parts.first, tree::make(piece)), parts.second);
+}
+
+void Rope::erase(std::size_t offset, std::size_t length)
+{
+	check_range(offset, length);
+
+	if (!length)
+	{
+		return;
+	}
+
+	auto const head = tree::split(root_, offset);
+	auto const tail = tree::split(head.second, length);
+
+	root_ = tree::merge(head.first, tail.second);
+}
+
+std::vector<char> Rope::read(std::size_t offset, std::size_t length) const
+{
+	std::vector<char> bytes;
+
+	bytes.reserve(length);
+
+	for_each_span(offset, length,
+		[&bytes](char const *span, std::size_t span_length)
+		{
+			bytes.insert(bytes.end(), span, span + span_length);
+		});
+
+	return bytes;
+}
+
+void Rope::check_range(std::size_t offset, std::size_t length) const
+{
+	std::size_t const end = size();
+
+	if (offset > end || length > end - offset)
+	{
+		std::ostringstream strm;
+
+		strm << "range [" << offset << ", " << offset << " + " << length
+		     << ") exceeds the size " << end;
+
+		throw OutOfRangeError(strm.str());
+	}
+}
@@ -0,0 +1,253 @@
+#ifndef ROPE_H_INCLUDED
+#define ROPE_H_INCLUDED
+
+#include "PersistentTreap.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @file Rope.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * The text store behind a document.
+ *
+ * A rope is a sequence of pieces, each referring to a range of an immutable
+ * buffer. The pieces are kept in a persistent treap, so inserting and deleting
+ * at an arbitrary offset costs O(log n) and never moves the bytes behind the
+ * edit. Inserted bytes are appended to a private buffer, typing at the end of
+ * the last insertion only grows the piece that was created for it.
+ *
+ * Copying a rope is cheap, the copy shares all pieces with the original.
+ */
+
+namespace rope_errors
+{
+	struct OutOfRangeError
+		: std::out_of_range
+	{
+		OutOfRangeError(std::string const &message);
+	};
+}
+
+class Rope
+{
+public:
+	/**
+	 * An immutable block of bytes pieces can refer to.
+	 */
+	class Buffer
+	{
+	public:
+		virtual ~Buffer();
+
+		/**
+		 * Obtain the bytes of the buffer.
+		 *
+		 * @return A pointer to the first byte.
+		 */
+		virtual char const *data() const = 0;
+
+		/**
+		 * Obtain the number of bytes available in the buffer.
+		 */
+		virtual std::size_t size() const = 0;
+	};
+
+	typedef std::shared_ptr<Buffer const> buffer_ptr;
+
+	/**
+	 * Create a buffer which holds the bytes on the heap.
+	 *
+	 * @param bytes The bytes to take over.
+	 * @return The buffer.
+	 */
+	static buffer_ptr make_buffer(std::vector<char> bytes);
+
+	/**
+	 * Construct an empty rope.
+	 */
+	Rope();
+
+	/**
+	 * Construct a rope holding the whole buffer.
+	 *
+	 * @param buffer The initial contents.
+	 */
+	explicit Rope(buffer_ptr const &buffer);
+
+	/**
+	 * Construct a rope holding the buffers one after another.
+	 *
+	 * @param buffers The initial contents in order.
+	 */
+	explicit Rope(std::vector<buffer_ptr> const &buffers);
+
+	/**
+	 * Copy a rope. The copy shares all pieces with the original, but
+	 * appends its own insertions to a buffer of its own.
+	 */
+	Rope(Rope const &other);
+	Rope &operator=(Rope const &other);
+
+	Rope(Rope &&other);
+	Rope &operator=(Rope &&other);
+
+	~Rope();
+
+	/**
+	 * Obtain the number of bytes.
+	 */
+	std::size_t size() const
+	{
+		return tree::length(root_);
+	}
+
+	/**
+	 * Check if the rope holds no bytes at all.
+	 */
+	bool empty() const
+	{
+		return !root_;
+	}
+
+	/**
+	 * Insert bytes at an offset.
+	 *
+	 * @param offset The offset to insert at, may be equal to size().
+	 * @param bytes The first byte to insert.
+	 * @param length The number of bytes to insert.
+	 * @throws rope_errors::OutOfRangeError If the offset is beyond the end.
+	 */
+	void insert(std::size_t offset, char const *bytes, std::size_t length);
+
+	void insert(std::size_t offset, std::vector<char> const &bytes)
+	{
+		insert(offset, bytes.data(), bytes.size());
+	}
+
+	/**
+	 * Erase a range of bytes.
+	 *
+	 * @param offset The first byte to erase.
+	 * @param length The number of bytes to erase.
+	 * @throws rope_errors::OutOfRangeError If the range exceeds the end.
+	 */
+	void erase(std::size_t offset, std::size_t length);
+
+	/**
+	 * Copy a range of bytes out of the rope.
+	 *
+	 * @throws rope_errors::OutOfRangeError If the range exceeds the end.
+	 */
+	std::vector<char> read(std::size_t offset, std::size_t length) const;
+
+	/**
+	 * Copy all bytes out of the rope.
+	 */
+	std::vector<char> flatten() const
+	{
+		return read(0, size());
+	}
+
+	/**
+	 * Walk a range of the rope as a sequence of contiguous spans.
+	 *
+	 * @param f Called as f(char const *bytes, std::size_t length) for each span
+	 *          in order.
+	 * @throws rope_errors::OutOfRangeError If the range exceeds the end.
+	 */
+	template <class F>
+	void for_each_span(std::size_t offset, std::size_t length, F f) const;
+
+	template <class F>
+	void for_each_span(F f) const
+	{
+		for_each_span(0, size(), f);
+	}
+
+	/**
+	 * Walk all pieces of the rope without touching their bytes, which lets
+	 * storages recognize buffers they handed out.
+	 *
+	 * @param f Called as f(buffer_ptr const &buffer, std::size_t offset,
+	 *          std::size_t length) for each piece in order.
+	 */
+	template <class F>
+	void for_each_piece(F f) const;
+
+private:
+	class AppendBuffer;
+
+	struct Piece
+	{
+		buffer_ptr buffer;
+		std::size_t offset;
+		std::size_t length;
+	};
+
+	struct PieceTraits
+	{
+		typedef Piece value_type;
+		typedef std::size_t summary_type;
+
+		static summary_type measure(Piece const &piece)
+		{
+			return piece.length;
+		}
+
+		static summary_type combine(summary_type left, summary_type right)
+		{
+			return left + right;
+		}
+
+		static std::size_t length(summary_type summary)
+		{
+			return summary;
+		}
+
+		static std::uint64_t priority(Piece const &piece);
+		static std::pair<Piece, Piece> split(Piece const &piece, std::size_t offset);
+	};
+
+	typedef PersistentTreap<PieceTraits> tree;
+
+	/**
+	 * Throw if [offset, offset + length) is not inside of the rope.
+	 */
+	void check_range(std::size_t offset, std::size_t length) const;
+
+	tree::node_ptr root_;
+	std::shared_ptr<AppendBuffer> append_;
+};
+
+template <class F>
+void Rope::for_each_span(std::size_t offset, std::size_t length, F f) const
+{
+	check_range(offset, length);
+
+	auto visitor = [&f](Piece const &piece, std::size_t begin, std::size_t end)
+	{
+		f(piece.buffer->data() + piece.offset + begin, end - begin);
+	};
+
+	tree::for_each(root_, offset, offset + length, visitor);
+}
+
+template <class F>
+void Rope::for_each_piece(F f) const
+{
+	auto visitor = [&f](Piece const &piece, std::size_t, std::size_t)
+	{
+		f(piece.buffer, piece.offset, piece.length);
+	};
+
+	tree::for_each(root_, 0, size(), visitor);
+}
+
+#endif
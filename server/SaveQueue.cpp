@@ -0,0 +1,139 @@
+#include "SaveQueue.h"
+#include "Document.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @file SaveQueue.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the save queue.
+ */
+
+SaveQueue::SaveQueue()
+	: stopping_(false)
+{
+	if (::pipe2(pipe_, O_CLOEXEC | O_NONBLOCK))
+	{
+		throw document_errors::DocumentError(
+			std::string("unable to create save queue: ") + std::strerror(errno));
+	}
+
+	thread_ = std::thread(&SaveQueue::work, this);
+}
+
+SaveQueue::~SaveQueue()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		stopping_ = true;
+	}
+
+	wakeup_.notify_one();
+	thread_.join();
+
+	::close(pipe_[0]);
+	::close(pipe_[1]);
+}
+
+std::shared_future<void> SaveQueue::enqueue(std::function<void()> job, Completion completion)
+{
+	Entry entry;
+
+	entry.job = std::move(job);
+	entry.completion = std::move(completion);
+
+	std::shared_future<void> done = entry.done.get_future().share();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		queue_.push_back(std::move(entry));
+	}
+
+	wakeup_.notify_one();
+
+	return done;
+}
+
+void SaveQueue::dispatch()
+{
+	char buffer[64];
+
+	// the pipe only wakes up the caller, drain it
+	while (::read(pipe_[0], buffer, sizeof(buffer)) > 0)
+	{
+	}
+
+	std::vector<std::pair<Completion, std::exception_ptr>> finished;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		finished.swap(finished_);
+	}
+
+	for (auto const &result: finished)
+	{
+		if (result.first)
+		{
+			result.first(result.second);
+		}
+	}
+}
+
+void SaveQueue::work()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	while (true)
+	{
+		wakeup_.wait(lock,
+			[this]()
+			{
+				return stopping_ || !queue_.empty();
+			});
+
+		if (queue_.empty())
+		{
+			return;
+		}
+
+		Entry entry = std::move(queue_.front());
+		std::exception_ptr error;
+
+		queue_.pop_front();
+		lock.unlock();
+
+		try
+		{
+			entry.job();
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+
+		lock.lock();
+		finished_.push_back(std::make_pair(std::move(entry.completion), error));
+
+		// a full pipe wakes up the owner as well, so failing doesn't matter
+		ssize_t const written = ::write(pipe_[1], "", 1);
+
+		static_cast<void>(written);
+
+		if (error)
+		{
+			entry.done.set_exception(error);
+		}
+		else
+		{
+			entry.done.set_value();
+		}
+	}
+}
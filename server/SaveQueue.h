@@ -0,0 +1,105 @@
+#ifndef SAVEQUEUE_H_INCLUDED
+#define SAVEQUEUE_H_INCLUDED
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * @file SaveQueue.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * A thread running save jobs one after another, so writing and syncing
+ * documents doesn't block the thread serving the clients.
+ *
+ * Completions are reported back through a pipe: the owning thread waits for
+ * get_fd() to become readable (e.g. in its select loop) and calls dispatch(),
+ * which runs the completion handlers of all finished jobs on that thread.
+ */
+
+class SaveQueue
+{
+public:
+	/**
+	 * Called by dispatch() once a job finished.
+	 *
+	 * The parameter is the exception the job failed with or a null pointer
+	 * if it succeeded.
+	 */
+	typedef std::function<void(std::exception_ptr)> Completion;
+
+	/**
+	 * Create the completion pipe and start the thread.
+	 *
+	 * @throws document_errors::DocumentError If the pipe can't be created.
+	 */
+	SaveQueue();
+
+	/**
+	 * Run all queued jobs and stop the thread. Completions which weren't
+	 * dispatched yet are dropped.
+	 */
+	~SaveQueue();
+
+	/**
+	 * Delete the default copy constructor, making copying a queue impossible.
+	 */
+	SaveQueue(SaveQueue const &) = delete;
+
+	/**
+	 * Delete the default assignment operator, making assigning a queue
+	 * impossible.
+	 */
+	SaveQueue &operator=(SaveQueue const &) = delete;
+
+	/**
+	 * Queue a job.
+	 *
+	 * @param job The job, run on the thread of the queue.
+	 * @param completion Called by dispatch() once the job finished.
+	 * @return A future becoming ready once the job finished.
+	 */
+	std::shared_future<void> enqueue(std::function<void()> job, Completion completion);
+
+	/**
+	 * Obtain the descriptor which becomes readable when jobs finished.
+	 */
+	int get_fd() const
+	{
+		return pipe_[0];
+	}
+
+	/**
+	 * Run the completions of all finished jobs on the calling thread.
+	 */
+	void dispatch();
+
+private:
+	struct Entry
+	{
+		std::function<void()> job;
+		Completion completion;
+		std::promise<void> done;
+	};
+
+	/**
+	 * The loop of the thread.
+	 */
+	void work();
+
+	int pipe_[2];
+	std::deque<Entry> queue_;
+	std::vector<std::pair<Completion, std::exception_ptr>> finished_;
+	bool stopping_;
+	std::mutex mutex_;
+	std::condition_variable wakeup_;
+	std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,327 @@
+/**
+	file: SendQueue.cpp
+	author: Maximilian Lasser [max.lasser@online.de]
+	created: Sunday, 17th June 2012
+**/
+
+#include <algorithm> // min
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring> // memcpy
+#include <limits>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "exceptions.h"
+#include "Message.h"
+#include "SendQueue.h"
+
+namespace
+{
+	// type and position, the fields every edit frame starts with
+	const size_t EDIT_HEADER_SIZE = Message::FIELD_SIZE_TYPE + Message::FIELD_SIZE_SIZE;
+
+	/// the fields of an edit frame
+	struct Edit
+	{
+		Message::MessageType	 type;
+		uint32_t				 position;
+		int32_t					 length;
+		const char				*payload;
+
+		bool is_insertion(void) const
+		{ return this->type == Message::TYPE_SYNC_BYTE || this->type == Message::TYPE_SYNC_MULTIBYTE; }
+	};
+
+	uint32_t load_uint32(const char *bytes)
+	{
+		uint32_t value;
+		std::memcpy(&value, bytes, sizeof(value));
+		return ntohl(value);
+	}
+
+	void store_uint32(std::vector<char> &bytes, size_t position, uint32_t value)
+	{
+		value = htonl(value);
+		std::memcpy(bytes.data() + position, &value, sizeof(value));
+	}
+
+	/**
+		Decodes an edit frame.
+			 bytes
+			 size
+			&edit
+		=>	false if the bytes aren't a single edit frame
+	**/
+	bool decode(const char *bytes, size_t size, Edit &edit)
+	{
+		if (size < EDIT_HEADER_SIZE)
+		{ return false; }
+
+		edit.type = static_cast<Message::MessageType>(bytes[0]);
+		edit.position = load_uint32(bytes + Message::FIELD_SIZE_TYPE);
+		edit.payload = bytes + EDIT_HEADER_SIZE + Message::FIELD_SIZE_SIZE;
+
+		switch (edit.type)
+		{
+			case Message::TYPE_SYNC_BYTE:
+				edit.length = Message::FIELD_SIZE_BYTE;
+				edit.payload = bytes + EDIT_HEADER_SIZE;
+				return size == EDIT_HEADER_SIZE + Message::FIELD_SIZE_BYTE;
+			case Message::TYPE_SYNC_MULTIBYTE:
+				if (size < EDIT_HEADER_SIZE + Message::FIELD_SIZE_SIZE)
+				{ return false; }
+				edit.length = load_uint32(bytes + EDIT_HEADER_SIZE);
+				return edit.length >= 0
+					&& size == EDIT_HEADER_SIZE + Message::FIELD_SIZE_SIZE + edit.length;
+			case Message::TYPE_SYNC_DELETION:
+			case Message::TYPE_SYNC_VIEWPORT_SHIFT:
+				if (size != EDIT_HEADER_SIZE + Message::FIELD_SIZE_SIZE)
+				{ return false; }
+				edit.length = load_uint32(bytes + EDIT_HEADER_SIZE);
+				return true;
+			default:
+				return false;
+		}
+	}
+}
+
+const uint64_t SendQueue::TRANSFER_CHUNK_SIZE;
+const size_t SendQueue::max_spans;
+
+SendQueue::SendQueue(void):
+	sent(0), frame_bytes(0), content_ranges(0)
+{}
+
+void SendQueue::write(int socket, const char *bytes, size_t size, bool edit)
+{
+	// bytes may only go out right away if nothing waits in front of them
+	if (this->segments.empty())
+	{
+		const size_t whole = size;
+		while (size)
+		{
+			// MSG_NOSIGNAL: a vanished peer is reported by EPIPE instead of killing the server
+			ssize_t sent = ::send(socket, bytes, std::min<uint64_t>(size, TRANSFER_CHUNK_SIZE),
+				MSG_DONTWAIT | MSG_NOSIGNAL);
+			if (sent == -1)
+			{
+				if (errno == EINTR)
+				{ continue; }
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+				{ break; }
+				throw Exception::ErrnoError("message transmission failed", "send");
+			}
+
+			bytes += sent;
+			size -= sent;
+		}
+
+		if (!size)
+		{ return; }
+
+		// the rest of a frame that started to leave has to follow as it is
+		edit = edit && size == whole;
+	}
+	else if (edit && this->coalesce(bytes, size))
+	{ return; }
+
+	Segment segment;
+	segment.bytes.assign(bytes, bytes + size);
+	segment.edit = edit;
+	segment.position = segment.length = 0;
+	this->segments.push_back(std::move(segment));
+	this->frame_bytes += size;
+}
+
+void SendQueue::write(int socket, const Document &document, uint64_t position, uint64_t length)
+{
+	const bool first = this->segments.empty();
+
+	size_t offset;
+	const int fd = first ? document.get_contents_file(offset) : -1;
+	if (fd != -1)
+	{
+		off_t file_position = offset + position;
+		while (length)
+		{
+			ssize_t sent = sendfile(socket, fd, &file_position,
+				std::min(length, TRANSFER_CHUNK_SIZE));
+			if (sent == -1)
+			{
+				if (errno == EINTR)
+				{ continue; }
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+				{ break; }
+				throw Exception::ErrnoError("file transmission failed", "sendfile");
+			}
+			if (sent == 0)
+			{ throw Exception::ErrnoError("file ended before the transmitted range", EIO, "sendfile"); }
+
+			position += sent;
+			length -= sent;
+		}
+	}
+
+	if (!length)
+	{ return; }
+
+	// the pinned version stays intact even if the document is edited meanwhile
+	Segment segment;
+	segment.edit = false;
+	segment.version = document.pin();
+	segment.position = position;
+	segment.length = length;
+	this->segments.push_back(std::move(segment));
+	++this->content_ranges;
+
+	// contents that aren't in their file go out from the version right away
+	if (first && fd == -1)
+	{ this->flush(socket); }
+}
+
+bool SendQueue::flush(int socket)
+{
+	while (!this->segments.empty())
+	{
+		ssize_t sent = this->send_front(socket);
+		if (sent == -1)
+		{
+			if (errno == EINTR)
+			{ continue; }
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{ return false; }
+			throw Exception::ErrnoError("message transmission failed", "send");
+		}
+
+		this->sent += sent;
+
+		const Segment &front = this->segments.front();
+		if (this->sent == (front.version ? front.length : front.bytes.size()))
+		{ this->pop_front(); }
+	}
+
+	return true;
+}
+
+void SendQueue::drop_edits(void)
+{
+	std::deque<Segment>::iterator segment = this->segments.begin();
+	if (this->sent)
+	{ ++segment; }
+
+	while (segment != this->segments.end())
+	{
+		if (segment->edit)
+		{
+			this->frame_bytes -= segment->bytes.size();
+			segment = this->segments.erase(segment);
+		}
+		else
+		{ ++segment; }
+	}
+}
+
+void SendQueue::clear(void)
+{
+	this->segments.clear();
+	this->sent = this->frame_bytes = this->content_ranges = 0;
+}
+
+bool SendQueue::coalesce(const char *bytes, size_t size)
+{
+	if (this->segments.empty())
+	{ return false; }
+
+	Segment &last = this->segments.back();
+	if (!last.edit || (this->segments.size() == 1 && this->sent))
+	{ return false; }
+
+	Edit queued, next;
+	if (!decode(last.bytes.data(), last.bytes.size(), queued) || !decode(bytes, size, next))
+	{ return false; }
+
+	const size_t before = last.bytes.size();
+	if (queued.is_insertion() && next.is_insertion())
+	{
+		// the next insertion has to land within or right behind the queued one
+		if (next.position < queued.position
+			|| next.position - queued.position > static_cast<uint32_t>(queued.length)
+			|| next.length > std::numeric_limits<int32_t>::max() - queued.length)
+		{ return false; }
+
+		if (queued.type == Message::TYPE_SYNC_BYTE)
+		{
+			last.bytes[0] = Message::TYPE_SYNC_MULTIBYTE;
+			last.bytes.insert(last.bytes.begin() + EDIT_HEADER_SIZE, Message::FIELD_SIZE_SIZE, 0);
+		}
+
+		last.bytes.insert(last.bytes.begin() + EDIT_HEADER_SIZE + Message::FIELD_SIZE_SIZE
+			+ (next.position - queued.position), next.payload, next.payload + next.length);
+		store_uint32(last.bytes, EDIT_HEADER_SIZE, queued.length + next.length);
+	}
+	else if (queued.type == Message::TYPE_SYNC_DELETION
+		&& next.type == Message::TYPE_SYNC_DELETION)
+	{
+		// deleting forwards keeps the position, deleting backwards ends at it
+		if (next.position != queued.position && next.position + next.length != queued.position)
+		{ return false; }
+
+		store_uint32(last.bytes, Message::FIELD_SIZE_TYPE, next.position);
+		store_uint32(last.bytes, EDIT_HEADER_SIZE, queued.length + next.length);
+	}
+	else if (queued.type == Message::TYPE_SYNC_VIEWPORT_SHIFT
+		&& next.type == Message::TYPE_SYNC_VIEWPORT_SHIFT)
+	{
+		store_uint32(last.bytes, Message::FIELD_SIZE_TYPE, std::min(queued.position, next.position));
+		store_uint32(last.bytes, EDIT_HEADER_SIZE, queued.length + next.length);
+	}
+	else
+	{ return false; }
+
+	this->frame_bytes += last.bytes.size() - before;
+	return true;
+}
+
+ssize_t SendQueue::send_front(int socket)
+{
+	const Segment &front = this->segments.front();
+	if (!front.version)
+	{
+		return ::send(socket, front.bytes.data() + this->sent,
+			std::min<uint64_t>(front.bytes.size() - this->sent, TRANSFER_CHUNK_SIZE),
+			MSG_DONTWAIT | MSG_NOSIGNAL);
+	}
+
+	// gather the spans of the next chunk, the ones beyond max_spans follow with the next call
+	struct iovec spans[max_spans];
+	size_t count = 0;
+	front.version->get_contents().for_each_span(front.position + this->sent,
+		std::min(front.length - this->sent, TRANSFER_CHUNK_SIZE),
+		[&spans, &count](const char *bytes, size_t size)
+		{
+			if (count < max_spans)
+			{
+				spans[count].iov_base = const_cast<char *>(bytes);
+				spans[count].iov_len = size;
+				++count;
+			}
+		});
+
+	struct msghdr message = {};
+	message.msg_iov = spans;
+	message.msg_iovlen = count;
+	return sendmsg(socket, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+void SendQueue::pop_front(void)
+{
+	const Segment &front = this->segments.front();
+	if (front.version)
+	{ --this->content_ranges; }
+	else
+	{ this->frame_bytes -= front.bytes.size(); }
+
+	this->segments.pop_front();
+	this->sent = 0;
+}
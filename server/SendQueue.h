@@ -0,0 +1,131 @@
+/**
+	file: SendQueue.h
+	author: Maximilian Lasser [max.lasser@online.de]
+	created: Sunday, 17th June 2012
+**/
+
+#ifndef _SENDQUEUE_H_
+#define _SENDQUEUE_H_
+
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t
+#include <deque>
+#include <sys/types.h> // ssize_t
+#include <vector>
+
+#include "Document.h"
+
+/*
+	Bytes waiting to be sent to a socket that didn't take them right away. Nothing is queued as
+	long as the socket keeps up, the bytes go out straight from where they are. Frames that have
+	to wait are copied, contents of documents are kept as pinned versions and sent from them
+	once the socket takes more, so a lagging client holds no copy of the contents it's behind.
+	Edit frames waiting behind each other are coalesced where one continues the other: typing
+	becomes a single multibyte insertion, deleting forwards or backwards a single deletion and
+	consecutive viewport shifts a single shift.
+*/
+class SendQueue
+{
+	public:
+		/// upper bound of the bytes handed to a single send, sendmsg or sendfile call
+		static const uint64_t TRANSFER_CHUNK_SIZE = 1024 * 1024;
+
+		SendQueue(void);
+
+		/*
+			Sends as many of the given bytes as the socket takes without blocking, unless bytes
+			are queued already, and queues the rest.
+				socket
+				bytes - pointer to the first byte
+				size - number of bytes
+				edit - whether the bytes are an edit frame (TYPE_SYNC_BYTE, TYPE_SYNC_MULTIBYTE,
+					TYPE_SYNC_DELETION or TYPE_SYNC_VIEWPORT_SHIFT), which may be coalesced or
+					dropped while it waits, see drop_edits
+			=#	Exception::ErrnoError - if send fails
+		*/
+		void write(int socket, const char *bytes, size_t size, bool edit);
+		/*
+			Sends a range of the contents of a document like write(int, const char *, size_t,
+			bool). Unchanged contents are sent straight from their file with sendfile, the rest
+			of the range is queued as the current version of the document.
+				socket
+				document
+				position - offset of the range in the document
+				length - number of bytes
+			=#	Exception::ErrnoError - if sendfile fails or the file ends before the range
+		*/
+		void write(int socket, const Document &document, uint64_t position, uint64_t length);
+		/*
+			Sends as much of the queue as the socket takes without blocking.
+				socket
+			=>	true if the queue is empty afterwards
+			=#	Exception::ErrnoError - if send or sendmsg fails
+		*/
+		bool flush(int socket);
+		/*
+			Drops the queued edit frames, except one that is partially sent already.
+		*/
+		void drop_edits(void);
+		/*
+			Drops everything queued.
+		*/
+		void clear(void);
+
+		/*
+			=>	number of queued frame bytes, contents of documents aren't counted as they are
+				shared with the document
+		*/
+		size_t size(void) const
+		{ return this->frame_bytes; }
+		/*
+			=>	number of queued ranges of contents
+		*/
+		size_t contents(void) const
+		{ return this->content_ranges; }
+		/*
+			=>	whether nothing is queued
+		*/
+		bool empty(void) const
+		{ return this->segments.empty(); }
+
+	private:
+		/// most spans of a rope gathered into a single sendmsg call
+		static const size_t max_spans = 64;
+
+		/// a frame or a range of contents, whichever `version` says
+		struct Segment
+		{
+			std::vector<char>		bytes;
+			bool					edit;
+			Document::version_ptr	version;
+			uint64_t				position;
+			uint64_t				length;
+		};
+
+		/*
+			Appends an edit frame to the last queued one if that's an edit frame nothing of which
+			was sent yet and the new one continues it.
+				bytes
+				size
+			=>	true if the frame was coalesced
+		*/
+		bool coalesce(const char *bytes, size_t size);
+		/*
+			Sends the next part of the first segment.
+				socket
+			=>	number of bytes sent, -1 if the call failed
+		*/
+		ssize_t send_front(int socket);
+		/*
+			Removes the first segment after it was sent.
+		*/
+		void pop_front(void);
+
+		std::deque<Segment>	segments;
+		// number of bytes of the first segment that are sent already
+		uint64_t			sent;
+		size_t				frame_bytes;
+		size_t				content_ranges;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "Viewport.h"
+
+/**
+ * @file Viewport.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Implementation file for the window of a document.
+ */
+
+Viewport::Viewport()
+	: begin_(0),
+	  end_(std::numeric_limits<std::size_t>::max())
+{
+}
+
+Viewport::Viewport(std::size_t begin, std::size_t end)
+	: begin_(begin),
+	  end_(end < begin ? begin : end)
+{
+}
+
+Viewport::Effect Viewport::apply(std::size_t offset, std::size_t erased, std::size_t inserted)
+{
+	Effect effect = Effect::none;
+
+	if (offset < end_ && (offset >= begin_ || erased > begin_ - offset))
+	{
+		effect = Effect::overlap;
+	}
+	else if (offset < begin_ && erased != inserted)
+	{
+		effect = Effect::shift;
+	}
+
+	// the whole document stays whole
+	if (!is_whole())
+	{
+		begin_ = follow(begin_, offset, erased, inserted);
+		end_ = follow(end_, offset, erased, inserted);
+	}
+
+	return effect;
+}
+
+std::size_t Viewport::follow(std::size_t position, std::size_t offset, std::size_t erased,
+                             std::size_t inserted)
+{
+	// a window open towards the end stays open
+	if (position <= offset || position == std::numeric_limits<std::size_t>::max())
+	{
+		return position;
+	}
+
+	if (position - offset < erased)
+	{
+		return offset;
+	}
+
+	return position - erased + inserted;
+}
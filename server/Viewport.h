@@ -0,0 +1,92 @@
+#ifndef VIEWPORT_H_INCLUDED
+#define VIEWPORT_H_INCLUDED
+
+#include <cstddef>
+#include <limits>
+
+/**
+ * @file Viewport.h
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * The window of a document a client is looking at, the byte range
+ * [begin, end). Clients only receive the edits touching their window, the
+ * window follows the edits in front of it.
+ *
+ * An edit at offset erasing some bytes and inserting others moves every
+ * position of the window the same way: positions up to the offset stay,
+ * positions behind the erased bytes move by the difference and positions
+ * within the erased bytes move to the offset. So text inserted right at
+ * the beginning of the window belongs to it, text inserted right at its
+ * end doesn't.
+ */
+
+class Viewport
+{
+public:
+	/**
+	 * What an edit means to a window.
+	 */
+	enum class Effect
+	{
+		// the edit lies behind the window
+		none,
+		// the edit lies in front of the window and only moves it
+		shift,
+		// the edit changes bytes within the window
+		overlap
+	};
+
+	/**
+	 * Construct the window of the whole document, which every edit overlaps.
+	 */
+	Viewport();
+
+	/**
+	 * Construct a window, which may reach beyond the end of the document.
+	 *
+	 * @param begin The first byte of the window.
+	 * @param end The byte behind the window, not less than begin. The
+	 *            largest size_t keeps the window open towards the end.
+	 */
+	Viewport(std::size_t begin, std::size_t end);
+
+	std::size_t begin() const
+	{
+		return begin_;
+	}
+
+	std::size_t end() const
+	{
+		return end_;
+	}
+
+	/**
+	 * Check if the window covers every document.
+	 */
+	bool is_whole() const
+	{
+		return begin_ == 0 && end_ == std::numeric_limits<std::size_t>::max();
+	}
+
+	/**
+	 * Let the window follow an edit.
+	 *
+	 * @param offset The offset of the edit.
+	 * @param erased The number of bytes erased at the offset.
+	 * @param inserted The number of bytes inserted at the offset afterwards.
+	 * @return What the edit meant to the window before it followed.
+	 */
+	Effect apply(std::size_t offset, std::size_t erased, std::size_t inserted);
+
+private:
+	/**
+	 * Move a position the way the edit moves it.
+	 */
+	static std::size_t follow(std::size_t position, std::size_t offset, std::size_t erased,
+	                          std::size_t inserted);
+
+	std::size_t begin_;
+	std::size_t end_;
+};
+
+#endif
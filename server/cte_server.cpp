@@ -7,7 +7,7 @@
 // TODO write getters and setters for Message data
 
 #include "CommandProcessor.h"
-#include "NetworkInterface.h"
+#include "NetworkPool.h"
 #include "NCursesUserInterface.h"
 #include "SQLiteDatabase.h"
 #include "UserDatabase.h"
@@ -16,6 +16,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <iostream>
@@ -23,12 +24,25 @@
 #include <thread>
 
 class Message;
-extern void main_network_message_handler(const Message &);
+extern void main_network_message_handler(NetworkInterface &, const MessageView &);
 
 namespace
 {
 	// this function is called as soon as the user interface is initialized
 	int main_ui(int argc, char **argv, UserInterface &ui);
+
+	// number of network threads, CTE_NETWORK_THREADS or one per core
+	std::size_t network_thread_count()
+	{
+		char const *configured = std::getenv("CTE_NETWORK_THREADS");
+
+		if (configured && std::atoi(configured) > 0)
+		{
+			return std::atoi(configured);
+		}
+
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
 }
 
 int main(int argc, char **argv)
@@ -50,11 +64,14 @@ int main(int argc, char **argv)
 	{
 		try
 		{
-			NetworkInterface network_interface(1337);
-
-			network_interface.add_message_handler(&main_network_message_handler);
-			network_interface.run(ipc_sockets[1]);
-			ui.printf("network thread finished\n");
+			// the network threads share a connection of their own for the document catalog
+			auto const documents_db =
+				std::make_shared<SQLiteDatabase>(SQLiteDatabase::from_path("./documents.sql"));
+			NetworkPool network_pool(1337, network_thread_count(), 4, documents_db);
+
+			network_pool.add_message_handler(&main_network_message_handler);
+			network_pool.run(ipc_sockets[1]);
+			ui.printf("network threads finished\n");
 			return;
 		}
 		catch (std::exception const &exception)
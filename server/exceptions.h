@@ -36,6 +36,14 @@ namespace Exception
 		template <class T>
 		InvalidMessageType(T msg, Message::MessageType type, int socket);
 	};
+
+	struct InvalidMessageLength : std::runtime_error
+	{
+		const int		socket;
+		const int32_t	length;
+		template <class T>
+		InvalidMessageLength(T msg, int32_t length, int socket);
+	};
 };
 
 #include "exceptions.tcc"
@@ -29,4 +29,9 @@ Exception::InvalidMessageType::InvalidMessageType(T msg, Message::MessageType ty
 	std::runtime_error(msg), socket(socket), type(type)
 {}
 
+template<typename T>
+Exception::InvalidMessageLength::InvalidMessageLength(T msg, int32_t length, int socket):
+	std::runtime_error(msg), socket(socket), length(length)
+{}
+
 #endif
@@ -4,131 +4,660 @@
 	created: Monday, 11th June 2012
 **/
 
+#include <algorithm>
+#include <limits>
+#include <string>
+
 #include "Client.h"
+#include "DeltaSync.h"
 #include "Message.h"
+#include "MessageView.h"
+#include "NetworkInterface.h"
+#include "NetworkPool.h"
+
+namespace
+{
+	/// most catalog entries sent in response to a single list request
+	const int32_t doc_list_page_size = 256;
+
+	/**
+		Extracts a document name from a zero padded name field.
+			field
+		=>	the name
+	**/
+	std::string document_name(const ByteSpan &field)
+	{ return std::string(field.begin(), std::find(field.begin(), field.end(), '\0')); }
+
+	/**
+		Sends a response of the request's type to the requesting client.
+			request
+			status
+			*id - document id, if the response carries one
+	**/
+	void respond(const MessageView &request, Message::MessageStatus status, int32_t id = 0)
+	{
+		Message response;
+		response.type = request.type;
+		response.status = status;
+		response.id = id;
+		response.name = request.name.copy();
+		response.send_to(*request.source);
+	}
+
+	/**
+		Sends a general status announcement to a client.
+			client
+			status
+	**/
+	void announce(Client &client, Message::MessageStatus status)
+	{
+		Message announcement;
+		announcement.type = Message::TYPE_STATUS;
+		announcement.status = status;
+		announcement.send_to(client);
+	}
+
+	/**
+		Looks up a document by id, treating documents that can't be opened anymore as missing.
+			documents
+			id
+		=>	the document or a null pointer
+	**/
+	DocumentManager::document_ptr find_document(DocumentManager &documents, int32_t id)
+	{
+		try
+		{ return documents.find(id); }
+		catch (const document_errors::DocumentError &)
+		{ return DocumentManager::document_ptr(); }
+	}
+
+	/**
+		Hands the source of a message to the NetworkInterface owning the document the message is
+		about, unless that's this one.
+			network
+			message
+			owner - index of the owning NetworkInterface
+		=>	true if the message is handled by the owner
+	**/
+	bool handed_over(NetworkInterface &network, const MessageView &message, size_t owner)
+	{
+		if (owner == network.get_index())
+		{ return false; }
+
+		network.hand_over(message, owner);
+		return true;
+	}
+
+	/**
+		Looks up the NetworkInterface owning a document by id.
+			network
+			id
+		=>	index of the owner
+	**/
+	size_t owner_of(NetworkInterface &network, int32_t id)
+	{
+		NetworkPool *pool = network.get_pool();
+		return pool ? pool->owner_of(id, network.get_index()) : network.get_index();
+	}
+
+	/**
+		Claims a document for this NetworkInterface before it's opened, created or removed, see
+		NetworkPool::claim.
+			 network
+			 name
+			&owner - receives the index of the owner
+		=>	true if the claim is new
+	**/
+	bool claim(NetworkInterface &network, const std::string &name, size_t &owner)
+	{
+		owner = network.get_index();
+		NetworkPool *pool = network.get_pool();
+		return pool && pool->claim(name, network.get_index(), owner);
+	}
+
+	/**
+		Lets the pool know the id of a document this NetworkInterface owns.
+			network
+			document
+	**/
+	void assign(NetworkInterface &network, const Document &document)
+	{
+		if (network.get_pool())
+		{ network.get_pool()->assign(document.get_id(), network.get_index()); }
+	}
+
+	/**
+		Drops the claim of a document that couldn't be opened or was removed.
+			network
+			name
+	**/
+	void forget(NetworkInterface &network, const std::string &name)
+	{
+		if (network.get_pool())
+		{ network.get_pool()->forget(name); }
+	}
+
+	/**
+		Makes the given document the client's active one, so the document table knows which
+		documents are in use. Switching documents drops the viewport and moves the client's
+		cursor to the beginning of the new document.
+			documents
+			client
+			id
+	**/
+	void activate(DocumentManager &documents, Client &client, int32_t id)
+	{
+		if (client.active_document == static_cast<uint32_t>(id))
+		{ return; }
+
+		DocumentManager::document_ptr previous = find_document(documents, client.active_document);
+		if (previous)
+		{ previous->get_cursors().remove(client.socket); }
 
-void main_network_message_handler(const Message &message)
+		documents.release(client.active_document);
+		documents.acquire(id);
+		client.active_document = id;
+		client.viewport = Viewport();
+
+		DocumentManager::document_ptr document = find_document(documents, id);
+		if (document)
+		{ document->get_cursors().set(client.socket, 0); }
+	}
+
+	/**
+		Translates the window requested by a viewport message to bytes. Windows reaching
+		beyond the last line stay open towards the end of the document.
+			message - TYPE_DOC_VIEWPORT or TYPE_DOC_VIEWPORT_LINE
+			document
+		=>	the window
+		=#	rope_errors::OutOfRangeError - if the window starts outside of the document
+	**/
+	Viewport requested_viewport(const MessageView &message, const Document &document)
+	{
+		if (message.length < 0)
+		{ throw rope_errors::OutOfRangeError("negative viewport length"); }
+
+		if (message.type == Message::TYPE_DOC_VIEWPORT)
+		{
+			if (message.position < 0 || static_cast<size_t>(message.position) > document.size())
+			{ throw rope_errors::OutOfRangeError("viewport starts outside of the document"); }
+			return Viewport(message.position, static_cast<size_t>(message.position)
+				+ message.length);
+		}
+
+		if (message.line < 0)
+		{ throw rope_errors::OutOfRangeError("negative viewport line"); }
+
+		const size_t last = static_cast<size_t>(message.line) + message.length;
+		return Viewport(document.offset_of(message.line, 0), last < document.lines()
+			? document.offset_of(last, 0) : std::numeric_limits<size_t>::max());
+	}
+
+	/**
+		Appends an unsigned integer in network byte order.
+			dest
+			value
+			size - number of bytes, the most significant ones are dropped
+	**/
+	void append_big_endian(std::vector<char> &dest, uint64_t value, size_t size)
+	{
+		for (size_t shift = size * 8; shift; shift -= 8)
+		{ dest.push_back(static_cast<char>(value >> (shift - 8))); }
+	}
+
+	/**
+		Encodes catalog entries as the payload of a list response. Each entry consists of id,
+		size, modification time (nanoseconds since the epoch), hash and zero padded name.
+			message - the response, determines the field sizes
+			entries
+		=>	the payload
+	**/
+	std::vector<char> encode_catalog_page(const Message &message,
+		const std::vector<DocumentCatalog::Entry> &entries)
+	{
+		std::vector<char> payload;
+		for (const DocumentCatalog::Entry &entry: entries)
+		{
+			append_big_endian(payload, static_cast<uint32_t>(entry.id), message.FIELD_SIZE_ID);
+			append_big_endian(payload, entry.size, message.FIELD_SIZE_DOC_SIZE);
+			append_big_endian(payload, entry.mtime, message.FIELD_SIZE_DOC_TIME);
+			payload.insert(payload.end(), entry.hash.begin(), entry.hash.end());
+
+			std::string name = entry.name.substr(0, message.FIELD_SIZE_DOC_NAME);
+			name.resize(message.FIELD_SIZE_DOC_NAME, '\0');
+			payload.insert(payload.end(), name.begin(), name.end());
+		}
+		return payload;
+	}
+}
+
+void main_network_message_handler(NetworkInterface &network, const MessageView &message)
 {
+	DocumentManager &documents = network.get_documents();
+
+	// a document and the clients working on it are only touched by the thread owning it
 	switch (message.type)
 	{
 		case Message::TYPE_DOC_ACTIVATE:
-			/* TODO
-				if doc not exists
-					respond: not existing
-					return
-				
-				get current doc hash
-				compare hash to received hash
+		case Message::TYPE_DOC_CLONE:
+		case Message::TYPE_DOC_SAVE:
+		case Message::TYPE_DOC_VIEWPORT:
+		case Message::TYPE_DOC_VIEWPORT_LINE:
+		case Message::TYPE_SYNC_SIGNATURES:
+			if (handed_over(network, message, owner_of(network, message.id)))
+			{ return; }
+			break;
+		default: break;
+	}
 
-				if hashs not equal
-					respond: ok, contents following
-					send contents via multibyte package
-					return
+	switch (message.type)
+	{
+		case Message::TYPE_DOC_ACTIVATE:
+		{
+			DocumentManager::document_ptr document = find_document(documents, message.id);
+			if (!document)
+			{
+				respond(message, Message::STATUS_DOC_NOT_EXIST, message.id);
+				break;
+			}
 
-				respond ok
-			*/
+			activate(documents, *message.source, message.id);
+
+			// the client's copy differs, let it send its chunk signatures
+			const Hash::hash_t hash = document->hash();
+			if (message.hash.size != hash.size()
+				|| !std::equal(hash.begin(), hash.end(), message.hash.begin()))
+			{
+				respond(message, Message::STATUS_OK_SIGNATURES_REQUESTED, message.id);
+				break;
+			}
+
+			respond(message, Message::STATUS_OK, message.id);
 			break;
+		}
+
+		case Message::TYPE_SYNC_SIGNATURES:
+		{
+			DocumentManager::document_ptr document = find_document(documents, message.id);
+			if (!document)
+			{
+				announce(*message.source, Message::STATUS_DOC_NOT_EXIST);
+				break;
+			}
+
+			std::vector<ChunkTree::Chunk> signatures;
+			try
+			{ signatures = DeltaSync::decode_signatures(message.bytes.data, message.bytes.size); }
+			catch (const deltasync_errors::InvalidDeltaError &)
+			{
+				announce(*message.source, Message::STATUS_NOT_OK);
+				break;
+			}
+
+			Message delta;
+			delta.type = Message::TYPE_SYNC_DELTA;
+			delta.id = message.id;
+			delta.bytes = DeltaSync::make_delta(document->get_contents(), document->get_chunks(),
+				signatures);
+			delta.length = delta.bytes.size();
+			delta.send_to(*message.source);
+			break;
+		}
 		
 		case Message::TYPE_DOC_CREATE:
-			/* TODO
-				if doc already exists
-					respond: already existing
-					return
+		{
+			// created where the client is, unless another thread has it open
+			const std::string name = document_name(message.name);
+			size_t owner;
+			const bool claimed = claim(network, name, owner);
+			if (owner != network.get_index())
+			{
+				respond(message, Message::STATUS_DOC_ALREADY_EXIST);
+				break;
+			}
 
-				create doc
-				respond ok
-			*/
+			try
+			{
+				assign(network, *documents.create(name));
+				respond(message, Message::STATUS_OK);
+				break;
+			}
+			catch (const document_errors::DocumentAlreadyExistsError &)
+			{ respond(message, Message::STATUS_DOC_ALREADY_EXIST); }
+			catch (const document_errors::DocumentError &)
+			{ respond(message, Message::STATUS_NOT_OK); }
+
+			if (claimed)
+			{ forget(network, name); }
+			break;
+		}
+
+		case Message::TYPE_DOC_CLONE:
+		{
+			DocumentManager::document_ptr source = find_document(documents, message.id);
+			if (!source)
+			{
+				respond(message, Message::STATUS_DOC_NOT_EXIST);
+				break;
+			}
+
+			// the clone stays with the thread owning the source
+			const std::string name = document_name(message.name);
+			size_t owner;
+			const bool claimed = claim(network, name, owner);
+			if (owner != network.get_index())
+			{
+				respond(message, Message::STATUS_DOC_ALREADY_EXIST);
+				break;
+			}
+
+			try
+			{
+				DocumentManager::document_ptr document = documents.clone(*source, name);
+				assign(network, *document);
+				respond(message, Message::STATUS_OK, document->get_id());
+				break;
+			}
+			catch (const document_errors::DocumentAlreadyExistsError &)
+			{ respond(message, Message::STATUS_DOC_ALREADY_EXIST); }
+			catch (const document_errors::DocumentError &)
+			{ respond(message, Message::STATUS_NOT_OK); }
+
+			if (claimed)
+			{ forget(network, name); }
 			break;
+		}
 
 		case Message::TYPE_DOC_DELETE:
-			/* TODO
-				if doc not exists
-					respond: not existing
-					return
+		{
+			// claimed meanwhile, so no other thread opens it while it's removed
+			const std::string name = document_name(message.name);
+			size_t owner;
+			const bool claimed = claim(network, name, owner);
+			if (handed_over(network, message, owner))
+			{ break; }
 
-				delete doc
-				respond ok
-			*/
+			try
+			{
+				documents.remove(name);
+				respond(message, Message::STATUS_OK);
+				forget(network, name);
+				break;
+			}
+			catch (const document_errors::DocumentDoesntExistError &)
+			{ respond(message, Message::STATUS_DOC_NOT_EXIST); }
+			catch (const document_errors::DocumentError &)
+			{ respond(message, Message::STATUS_NOT_OK); }
+
+			if (claimed)
+			{ forget(network, name); }
 			break;
+		}
 
 		case Message::TYPE_DOC_OPEN:
-			/* TODO
-				if doc not exists
-					respond: not existing
-					return
+		{
+			// another thread may have opened it meanwhile
+			const std::string name = document_name(message.name);
+			size_t owner;
+			const bool claimed = claim(network, name, owner);
+			if (handed_over(network, message, owner))
+			{ break; }
 
-				if doc not empty
-					respond: ok, contents following
-					return
+			DocumentManager::document_ptr document;
+			try
+			{ document = documents.open(name); }
+			catch (const document_errors::DocumentDoesntExistError &)
+			{ respond(message, Message::STATUS_DOC_NOT_EXIST); }
+			catch (const document_errors::DocumentError &)
+			{ respond(message, Message::STATUS_NOT_OK); }
 
-				respond: ok
-			*/
+			if (!document)
+			{
+				if (claimed)
+				{ forget(network, name); }
+				break;
+			}
+			assign(network, *document);
+
+			activate(documents, *message.source, document->get_id());
+			message.source->viewport = Viewport();
+
+			if (document->size() == 0)
+			{
+				respond(message, Message::STATUS_OK, document->get_id());
+				break;
+			}
+
+			respond(message, Message::STATUS_OK_CONTENTS_FOLLOWING, document->get_id());
+
+			// stream the contents, copying them would double the memory of large documents
+			Message contents;
+			contents.type = Message::TYPE_SYNC_MULTIBYTE;
+			contents.position = 0;
+			contents.length = document->size();
+			contents.stream_to(*message.source, *document);
+			break;
+		}
+
+		case Message::TYPE_DOC_VIEWPORT:
+		case Message::TYPE_DOC_VIEWPORT_LINE:
+		{
+			DocumentManager::document_ptr document = find_document(documents, message.id);
+			if (!document)
+			{
+				respond(message, Message::STATUS_DOC_NOT_EXIST, message.id);
+				break;
+			}
+
+			Viewport viewport;
+			try
+			{ viewport = requested_viewport(message, *document); }
+			catch (const rope_errors::OutOfRangeError &)
+			{
+				respond(message, Message::STATUS_USER_CURSOR_OUT_OF_BOUNDS, message.id);
+				break;
+			}
+
+			activate(documents, *message.source, message.id);
+			message.source->viewport = viewport;
+
+			// only the part of the window the document already covers is sent
+			Message response;
+			response.type = message.type;
+			response.id = message.id;
+			response.position = viewport.begin();
+			response.length = std::min(viewport.end(), document->size()) - viewport.begin();
+			response.status = response.length ? Message::STATUS_OK_CONTENTS_FOLLOWING
+				: Message::STATUS_OK;
+			response.send_to(*message.source);
+
+			if (!response.length)
+			{ break; }
+
+			Message contents;
+			contents.type = Message::TYPE_SYNC_MULTIBYTE;
+			contents.position = response.position;
+			contents.length = response.length;
+			contents.stream_to(*message.source, *document);
 			break;
+		}
 
 		case Message::TYPE_DOC_SAVE:
-			/* TODO
-				if doc not exists
-					respond: not existing
-					return
-				
-				save doc
-				respond: ok
-				UNCLEAR: add new general message type so all clients get the information that the
-					doc has been saved?
-			*/
+		{
+			DocumentManager::document_ptr document = find_document(documents, message.id);
+			if (!document)
+			{
+				respond(message, Message::STATUS_DOC_NOT_EXIST, message.id);
+				break;
+			}
+
+			// save on the save queue, the loop goes on serving the clients meanwhile
+			const ClientSptr source = message.source;
+			const int32_t id = message.id;
+			try
+			{
+				document->save(network.get_save_queue(),
+					[&network, source, id](std::exception_ptr error)
+					{
+						// unless the client moved on to another thread meanwhile
+						Message response;
+						response.type = Message::TYPE_DOC_SAVE;
+						response.status = error ? Message::STATUS_NOT_OK : Message::STATUS_OK;
+						response.id = id;
+						if (network.get_clients().contains(*source))
+						{ response.send_to(*source); }
+
+						if (error)
+						{ return; }
+
+						Message saved;
+						saved.type = Message::TYPE_DOC_SAVE;
+						saved.status = Message::STATUS_DOC_SAVED;
+						saved.id = id;
+						saved.send_to(network.get_clients(), id, source.get());
+					});
+			}
+			catch (const document_errors::DocumentError &)
+			{ respond(message, Message::STATUS_NOT_OK, message.id); }
+			break;
+		}
+
+		case Message::TYPE_DOC_LIST:
+		{
+			DocumentCatalog *catalog = network.get_catalog();
+			if (!catalog || message.length <= 0)
+			{
+				respond(message, Message::STATUS_NOT_OK);
+				break;
+			}
+
+			Message page;
+			page.type = Message::TYPE_DOC_LIST;
+			try
+			{
+				const std::vector<DocumentCatalog::Entry> entries = catalog->list(
+					document_name(message.name), std::min(message.length, doc_list_page_size));
+				page.bytes = encode_catalog_page(page, entries);
+				page.length = entries.size();
+				page.status = Message::STATUS_OK;
+			}
+			catch (const std::exception &)
+			{ page.status = Message::STATUS_NOT_OK; }
+			page.send_to(*message.source);
 			break;
+		}
 
 		case Message::TYPE_SYNC_BYTE:
-			/* TODO
-				if client has no active remote doc
-					discard (UNCLEAR: add new message type for general errors so the client gets an
-						error message saying they have no document activated?)
-					return
+		case Message::TYPE_SYNC_MULTIBYTE:
+		{
+			Client &client = *message.source;
+			DocumentManager::document_ptr document = find_document(documents,
+				client.active_document);
+			if (!document)
+			{
+				announce(client, Message::STATUS_USER_NO_ACTIVE_DOC);
+				break;
+			}
 
-				if client cursor position unclear/unknown (if that's even possible)
-					discard (see above)
-					return
+			CursorIndex &cursors = document->get_cursors();
+			if (!cursors.contains(client.socket))
+			{
+				announce(client, Message::STATUS_USER_CURSOR_UNKNOWN);
+				break;
+			}
 
-				if client cursor position out of bounds
-					discard (see above)
-					return
+			// the cursors of all clients follow the edit, the writer's stays in front of it
+			const size_t cursor = cursors.offset_of(client.socket);
+			document->insert(cursor, message.bytes.data, message.bytes.size);
+			cursors.set(client.socket, cursor + message.bytes.size);
 
-				add byte at current client cursor position in current client active doc
-				sync byte to all clients that have this doc active
-			*/
+			Message edit;
+			edit.type = message.type;
+			edit.position = cursor;
+			edit.length = message.bytes.size;
+			edit.bytes = message.bytes.copy();
+
+			// clients looking elsewhere only learn how far their window moved
+			edit.send_edit_to(network.get_clients(), client.active_document, &client);
 			break;
+		}
 
 		case Message::TYPE_SYNC_CURSOR:
-			message.source->cursor = message.position;
+		{
+			DocumentManager::document_ptr document = find_document(documents,
+				message.source->active_document);
+			if (!document)
+			{
+				announce(*message.source, Message::STATUS_USER_NO_ACTIVE_DOC);
+				break;
+			}
+
+			if (message.position < 0 || static_cast<size_t>(message.position) > document->size())
+			{
+				announce(*message.source, Message::STATUS_USER_CURSOR_OUT_OF_BOUNDS);
+				break;
+			}
+
+			document->get_cursors().set(message.source->socket, message.position);
+			break;
+		}
+
+		case Message::TYPE_SYNC_CURSOR_LINE:
+		{
+			DocumentManager::document_ptr document = find_document(documents,
+				message.source->active_document);
+			if (!document)
+			{
+				announce(*message.source, Message::STATUS_USER_NO_ACTIVE_DOC);
+				break;
+			}
+
+			// the index translates in O(log n), clients needn't scan the text themselves
+			try
+			{
+				if (message.line < 0 || message.column < 0)
+				{ throw rope_errors::OutOfRangeError("negative line or column"); }
+				document->get_cursors().set(message.source->socket,
+					document->offset_of(message.line, message.column));
+			}
+			catch (const rope_errors::OutOfRangeError &)
+			{ announce(*message.source, Message::STATUS_USER_CURSOR_OUT_OF_BOUNDS); }
 			break;
+		}
 
 		case Message::TYPE_SYNC_DELETION:
-			/* TODO
-				if client has no active remote doc
-					discard (see first UNCLEAR in byte sync)
-					return
+		{
+			Client &client = *message.source;
+			DocumentManager::document_ptr document = find_document(documents,
+				client.active_document);
+			if (!document)
+			{
+				announce(client, Message::STATUS_USER_NO_ACTIVE_DOC);
+				break;
+			}
 
-				if start is out of bounds
-					discard (see above)
-					return
-				
-				if length too big
-					discard (see above)
-					return
+			if (message.position < 0 || static_cast<size_t>(message.position) > document->size())
+			{
+				announce(client, Message::STATUS_USER_CURSOR_OUT_OF_BOUNDS);
+				break;
+			}
 
-				delete specified area in client active doc
-				sync deletion to all clients that have this doc active
-			*/
-			break;
+			if (message.length < 0
+				|| static_cast<size_t>(message.length) > document->size() - message.position)
+			{
+				announce(client, Message::STATUS_USER_LENGTH_TOO_LONG);
+				break;
+			}
 
-		case Message::TYPE_SYNC_MULTIBYTE:
-			/* TODO
-				[same first three checks as in byte sync]
+			document->erase(message.position, message.length);
 
-				add byted to current client cursor position in current client active doc
-				sync bytes to all clients that have this doc active
-			*/
+			Message edit;
+			edit.type = Message::TYPE_SYNC_DELETION;
+			edit.position = message.position;
+			edit.length = message.length;
+			edit.send_edit_to(network.get_clients(), client.active_document, &client);
 			break;
+		}
 
 		case Message::TYPE_USER_LOGIN:
 			/* TODO
@@ -149,6 +678,7 @@ void main_network_message_handler(const Message &message)
 		case Message::TYPE_USER_LOGOUT:
 			/* TODO
 				clear userdata
+				release active doc (DocumentManager::release)
 				close connection
 				sync user quit to all users
 			*/
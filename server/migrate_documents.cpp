@@ -0,0 +1,125 @@
+#include "Document.h"
+#include "DocumentLayout.h"
+#include "JournalStorage.h"
+
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+/**
+ * @file migrate_documents.cpp
+ * @author Daniel Mierswa <daniel.mierswa@student.hs-rm.de>
+ *
+ * Offline tool moving the documents of a directory using the old flat layout
+ * into their shards (see DocumentLayout.h). Journals move along with their
+ * documents; they keep working as renaming keeps the inode they refer to.
+ * Files left behind by interrupted saves are left alone.
+ *
+ * Usage: MigrateDocuments [directory]
+ *
+ * Don't run it while the server is running. Running it again continues an
+ * interrupted migration.
+ */
+
+namespace
+{
+	bool ends_with(std::string const &name, std::string const &suffix)
+	{
+		return name.size() >= suffix.size()
+			&& name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	/**
+	 * Obtain the name of the document a file of the flat layout belongs to.
+	 *
+	 * @return The name or an empty string if the file doesn't belong to a
+	 *         document.
+	 */
+	std::string document_of(std::string const &name)
+	{
+		std::string const journal_suffix = JournalStorage::journal_name("");
+		std::string document = name;
+
+		if (ends_with(document, journal_suffix))
+		{
+			document.erase(document.size() - journal_suffix.size());
+		}
+
+		if (document.empty() || document[0] == '.' || Document::is_auxiliary(document))
+		{
+			return std::string();
+		}
+
+		return document;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	std::string directory = argc > 1 ? argv[1] : Document::get_directory();
+	std::size_t moved = 0;
+	std::size_t failed = 0;
+
+	if (argc > 2)
+	{
+		std::cerr << "usage: " << argv[0] << " [directory]" << std::endl;
+		return 2;
+	}
+
+	if (directory.empty() || directory[directory.size() - 1] != '/')
+	{
+		directory += '/';
+	}
+
+	try
+	{
+		for (auto const &name: DocumentLayout::read_directory(directory, false))
+		{
+			std::string const document = document_of(name);
+
+			if (document.empty())
+			{
+				std::cout << "skipping <" << name << ">" << std::endl;
+				continue;
+			}
+
+			std::string const source = directory + name;
+			std::string const target = DocumentLayout::path_of(directory, document)
+				+ name.substr(document.size());
+
+			// rename would replace it silently
+			if (::access(target.c_str(), F_OK) == 0)
+			{
+				std::cerr << "not moving <" << source << ">: <" << target << "> exists"
+				          << std::endl;
+				failed++;
+				continue;
+			}
+
+			DocumentLayout::make_shard(target);
+
+			if (::rename(source.c_str(), target.c_str()))
+			{
+				std::cerr << "unable to move <" << source << "> to <" << target << ">: "
+				          << std::strerror(errno) << std::endl;
+				failed++;
+				continue;
+			}
+
+			moved++;
+		}
+	}
+	catch (std::exception const &exception)
+	{
+		std::cerr << "migration failed: " << exception.what() << std::endl;
+		return 1;
+	}
+
+	std::cout << "moved " << moved << " files, " << failed << " failed" << std::endl;
+
+	return failed ? 1 : 0;
+}
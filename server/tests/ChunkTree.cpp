@@ -0,0 +1,101 @@
+#include "ChunkTree.h"
+#include "Chunker.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+BOOST_AUTO_TEST_SUITE(ChunkTreeSuite)
+
+namespace
+{
+	std::vector<char> random_bytes(std::size_t size, unsigned int &seed)
+	{
+		std::vector<char> bytes(size);
+
+		for (auto &byte: bytes)
+		{
+			seed = seed * 1103515245 + 12345;
+			byte = static_cast<char>(seed >> 16);
+		}
+
+		return bytes;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(small_contents)
+{
+	BOOST_CHECK(ChunkTree().root() == Hash::hash_bytes(std::vector<char>()));
+
+	std::vector<char> const bytes { 'f', 'o', 'o' };
+	ChunkTree const tree((Rope(Rope::make_buffer(bytes))));
+
+	// a single chunk hashes like the plain contents
+	BOOST_CHECK_EQUAL(tree.count(), 1u);
+	BOOST_CHECK(tree.root() == Hash::hash_bytes(bytes));
+}
+
+BOOST_AUTO_TEST_CASE(chunk_sizes)
+{
+	unsigned int seed = 1;
+	Rope const rope(Rope::make_buffer(random_bytes(512 * 1024, seed)));
+	std::vector<ChunkTree::Chunk> const chunks = ChunkTree(rope).chunks();
+	std::size_t total = 0;
+
+	BOOST_REQUIRE(chunks.size() > 1);
+
+	for (std::size_t i = 0; i < chunks.size(); i++)
+	{
+		BOOST_CHECK(chunks[i].length <= Chunker::max_size);
+
+		if (i + 1 < chunks.size())
+		{
+			BOOST_CHECK(chunks[i].length >= Chunker::min_size);
+		}
+
+		total += chunks[i].length;
+	}
+
+	BOOST_CHECK_EQUAL(total, rope.size());
+}
+
+BOOST_AUTO_TEST_CASE(incremental_updates)
+{
+	unsigned int seed = 7;
+	Rope rope(Rope::make_buffer(random_bytes(256 * 1024, seed)));
+	ChunkTree tree(rope);
+
+	for (int i = 0; i < 200; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+
+		std::size_t const offset = seed % (rope.size() + 1);
+
+		if (seed & 0x10000)
+		{
+			std::vector<char> const bytes = random_bytes(1 + seed % 3000, seed);
+
+			rope.insert(offset, bytes);
+			tree.update(rope, offset, 0, bytes.size());
+		}
+		else
+		{
+			std::size_t const length = std::min<std::size_t>(seed % 5000, rope.size() - offset);
+
+			rope.erase(offset, length);
+			tree.update(rope, offset, length, 0);
+		}
+
+		// the incrementally updated tree must not differ from a fresh one
+		ChunkTree const fresh(rope);
+
+		BOOST_REQUIRE_EQUAL(tree.count(), fresh.count());
+		BOOST_REQUIRE(tree.root() == fresh.root());
+	}
+
+	rope.erase(0, rope.size());
+	tree.update(rope, 0, tree.size(), 0);
+	BOOST_CHECK(tree.root() == ChunkTree().root());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
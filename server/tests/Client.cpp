@@ -0,0 +1,173 @@
+#include "Client.h"
+#include "Loopback.h"
+#include "MessageView.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <arpa/inet.h>
+
+#include <string>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(ClientSuite)
+
+namespace
+{
+	std::string multibyte(std::string const &bytes)
+	{
+		std::uint32_t const length = htonl(bytes.size());
+
+		return std::string(1, static_cast<char>(Message::TYPE_SYNC_MULTIBYTE))
+			+ std::string(reinterpret_cast<char const *>(&length), sizeof(length)) + bytes;
+	}
+
+	std::vector<std::string> payloads(MessageList const &messages)
+	{
+		std::vector<std::string> result;
+
+		for (MessageView const &message: messages)
+		{
+			result.push_back(std::string(message.bytes.begin(), message.bytes.end()));
+		}
+
+		return result;
+	}
+
+	// keeps the Client's socket from taking more than a little at once
+	void narrow(Loopback const &loopback)
+	{
+		int const size = 4096;
+		::setsockopt(loopback.client->socket, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+	}
+
+	bool readable(int socket)
+	{
+		::pollfd descriptor = { socket, POLLIN, 0 };
+		return ::poll(&descriptor, 1, 10000) == 1;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(split_frames)
+{
+	Loopback loopback;
+	std::string const frame = multibyte("hello");
+	MessageList messages;
+	MessageList::iterator tail = messages.before_begin();
+
+	// the frame ends within the header, then within the payload
+	loopback.send(frame.substr(0, 3));
+	BOOST_CHECK(loopback.client->receive(messages, tail));
+	BOOST_CHECK(messages.empty());
+
+	loopback.send(frame.substr(3, 4));
+	BOOST_CHECK(loopback.client->receive(messages, tail));
+	BOOST_CHECK(messages.empty());
+
+	loopback.send(frame.substr(7));
+	BOOST_CHECK(loopback.client->receive(messages, tail));
+	BOOST_CHECK(payloads(messages) == std::vector<std::string> { "hello" });
+	BOOST_CHECK(messages.front().source == loopback.client);
+}
+
+BOOST_AUTO_TEST_CASE(several_frames_per_receive)
+{
+	Loopback loopback;
+	MessageList messages;
+	MessageList::iterator tail = messages.before_begin();
+
+	// the last frame is incomplete and waits for the rest
+	std::string const last = multibyte("three");
+	loopback.send(multibyte("one") + multibyte("two") + last.substr(0, 6));
+	BOOST_CHECK(loopback.client->receive(messages, tail));
+	BOOST_CHECK((payloads(messages) == std::vector<std::string> { "one", "two" }));
+
+	// released messages aren't decoded again
+	loopback.client->release_messages();
+	messages.clear();
+	tail = messages.before_begin();
+
+	loopback.send(last.substr(6) + multibyte("four"));
+	BOOST_CHECK(loopback.client->receive(messages, tail));
+	BOOST_CHECK((payloads(messages) == std::vector<std::string> { "three", "four" }));
+}
+
+BOOST_AUTO_TEST_CASE(closed_connections)
+{
+	Loopback loopback;
+	MessageList messages;
+	MessageList::iterator tail = messages.before_begin();
+
+	loopback.send(multibyte("bye"));
+	::shutdown(loopback.peer, SHUT_WR);
+
+	// the messages sent before closing are decoded nonetheless
+	::pollfd descriptor = { loopback.client->socket, POLLRDHUP, 0 };
+	BOOST_REQUIRE_EQUAL(::poll(&descriptor, 1, 10000), 1);
+	loopback.client->receive(messages, tail);
+	BOOST_CHECK(payloads(messages) == std::vector<std::string> { "bye" });
+
+	loopback.client->release_messages();
+	BOOST_CHECK(!loopback.client->receive(messages, tail));
+}
+
+BOOST_AUTO_TEST_CASE(lagging_behind)
+{
+	Loopback loopback(4096);
+	narrow(loopback);
+
+	std::string const frame(4 * 1024 * 1024, 'f');
+	loopback.client->send(frame.data(), frame.size());
+
+	// edits beyond the high watermark are dropped, the client is due for a resync
+	std::string const edit = multibyte(std::string(Client::HIGH_WATERMARK, 'e'));
+	loopback.client->send_edit(std::vector<char>(edit.begin(), edit.end()));
+	loopback.client->send_edit(std::vector<char>(edit.begin(), edit.begin() + 6));
+
+	// the resync is reported once, as soon as the queue is back below the low watermark
+	std::string received;
+	int resyncs = 0;
+	while (received.size() < frame.size())
+	{
+		resyncs += loopback.client->flush();
+		BOOST_REQUIRE(readable(loopback.peer));
+		received += loopback.receive();
+	}
+
+	BOOST_CHECK_EQUAL(resyncs, 1);
+	BOOST_CHECK(received == frame);
+	BOOST_CHECK(loopback.receive().empty());
+
+	// edits are sent again after the resync
+	std::string const typed = multibyte("a");
+	loopback.client->send_edit(std::vector<char>(typed.begin(), typed.end()));
+	BOOST_CHECK(!loopback.client->flush());
+	BOOST_REQUIRE(readable(loopback.peer));
+	BOOST_CHECK(loopback.receive() == typed);
+}
+
+BOOST_AUTO_TEST_CASE(hanging_up)
+{
+	Loopback loopback(4096);
+	narrow(loopback);
+
+	// beyond the limit the client is hung up on instead of queueing on
+	std::vector<char> const frame(Client::DISCONNECT_LIMIT + Client::HIGH_WATERMARK, 'f');
+	loopback.client->send(frame);
+	loopback.client->send(frame);
+	BOOST_CHECK(!loopback.client->flush());
+
+	// the peer gets what left before, then the end of the connection
+	size_t received = 0;
+	char bytes[65536];
+	ssize_t size = -1;
+	while (readable(loopback.peer)
+		&& (size = ::recv(loopback.peer, bytes, sizeof(bytes), 0)) > 0)
+	{
+		received += size;
+	}
+
+	BOOST_CHECK_EQUAL(size, 0);
+	BOOST_CHECK_LT(received, frame.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,102 @@
+#include "ClientCollection.h"
+#include "Loopback.h"
+#include "MessageView.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <iterator>
+#include <string>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(ClientCollectionSuite)
+
+namespace
+{
+	std::string byte_frame(char byte)
+	{
+		return std::string(1, static_cast<char>(Message::TYPE_SYNC_BYTE)) + byte;
+	}
+
+	std::ptrdiff_t count(MessageList const &messages)
+	{
+		return std::distance(messages.begin(), messages.end());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(draining_sockets)
+{
+	Loopback loopback;
+	ClientCollection clients;
+	MessageList messages;
+	MessageList::iterator tail = messages.before_begin();
+	std::vector<ClientSptr> disconnected;
+
+	clients.add_client(loopback.client);
+	BOOST_CHECK(clients.contains(*loopback.client));
+
+	// an edge-triggered wakeup is reported once, everything is received at once
+	loopback.send(byte_frame('a') + byte_frame('b') + byte_frame('c'));
+	clients.receive_messages(loopback.client->socket, false, messages, tail, disconnected);
+	BOOST_CHECK_EQUAL(count(messages), 3);
+	BOOST_CHECK(disconnected.empty());
+
+	// sockets of no client are ignored
+	clients.receive_messages(loopback.peer, false, messages, tail, disconnected);
+	BOOST_CHECK_EQUAL(count(messages), 3);
+	BOOST_CHECK(disconnected.empty());
+}
+
+BOOST_AUTO_TEST_CASE(hangups)
+{
+	Loopback loopback;
+	ClientCollection clients;
+	MessageList messages;
+	MessageList::iterator tail = messages.before_begin();
+	std::vector<ClientSptr> disconnected;
+
+	clients.add_client(loopback.client);
+
+	// what arrived along with the hangup is kept
+	loopback.send(byte_frame('a'));
+	clients.receive_messages(loopback.client->socket, true, messages, tail, disconnected);
+	BOOST_CHECK_EQUAL(count(messages), 1);
+	BOOST_REQUIRE_EQUAL(disconnected.size(), 1u);
+	BOOST_CHECK(disconnected.front() == loopback.client);
+	BOOST_CHECK(!clients.contains(*loopback.client));
+}
+
+BOOST_AUTO_TEST_CASE(malformed_messages)
+{
+	Loopback loopback;
+	ClientCollection clients;
+	MessageList messages;
+	MessageList::iterator tail = messages.before_begin();
+	std::vector<ClientSptr> disconnected;
+
+	clients.add_client(loopback.client);
+
+	// a malformed message only costs its own client
+	loopback.send(byte_frame('a') + "\x7f");
+	clients.receive_messages(loopback.client->socket, false, messages, tail, disconnected);
+	BOOST_CHECK_EQUAL(count(messages), 1);
+	BOOST_CHECK_EQUAL(disconnected.size(), 1u);
+	BOOST_CHECK(!clients.contains(*loopback.client));
+
+	for (MessageView const &message: messages)
+	{
+		BOOST_CHECK(message.source == loopback.client);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(removing_clients)
+{
+	Loopback loopback;
+	ClientCollection clients;
+
+	clients.add_client(loopback.client);
+	BOOST_CHECK(clients.remove_client(loopback.client->socket) == loopback.client);
+	BOOST_CHECK(!clients.contains(*loopback.client));
+	BOOST_CHECK(!clients.remove_client(loopback.client->socket));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
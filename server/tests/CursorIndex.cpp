@@ -0,0 +1,167 @@
+#include "CursorIndex.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+BOOST_AUTO_TEST_SUITE(CursorIndexSuite)
+
+namespace
+{
+	std::size_t follow(std::size_t position, std::size_t offset, std::size_t erased,
+	                   std::size_t inserted)
+	{
+		if (position <= offset)
+		{
+			return position;
+		}
+
+		return position - offset < erased ? offset : position - erased + inserted;
+	}
+
+	void check_cursors(CursorIndex const &index, std::map<int, std::size_t> const &expected)
+	{
+		BOOST_REQUIRE_EQUAL(index.size(), expected.size());
+
+		for (auto const &cursor: expected)
+		{
+			BOOST_REQUIRE_EQUAL(index.offset_of(cursor.first), cursor.second);
+		}
+
+		std::vector<CursorIndex::Cursor> const all = index.in_range(0, 1000000);
+
+		BOOST_REQUIRE_EQUAL(all.size(), expected.size());
+
+		for (std::size_t i = 1; i < all.size(); i++)
+		{
+			BOOST_REQUIRE(all[i - 1].offset <= all[i].offset);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(following_edits)
+{
+	CursorIndex index;
+
+	index.set(1, 0);
+	index.set(2, 5);
+	index.set(3, 10);
+	index.set(4, 10);
+
+	// cursors at an insertion stay in front of it
+	index.apply(5, 0, 3);
+	BOOST_CHECK_EQUAL(index.offset_of(1), 0u);
+	BOOST_CHECK_EQUAL(index.offset_of(2), 5u);
+	BOOST_CHECK_EQUAL(index.offset_of(3), 13u);
+
+	// cursors within erased bytes move to the edit
+	index.apply(4, 5, 0);
+	BOOST_CHECK_EQUAL(index.offset_of(2), 4u);
+	BOOST_CHECK_EQUAL(index.offset_of(4), 8u);
+
+	// replacing bytes by as many still collects the cursors within them
+	index.apply(6, 4, 4);
+	BOOST_CHECK_EQUAL(index.offset_of(3), 6u);
+
+	index.set(2, 7);
+	index.remove(1);
+	index.remove(42);
+	BOOST_CHECK(!index.contains(1));
+	BOOST_CHECK_THROW(index.offset_of(1), std::out_of_range);
+
+	std::vector<CursorIndex::Cursor> const range = index.in_range(6, 7);
+
+	BOOST_REQUIRE_EQUAL(range.size(), 2u);
+	BOOST_CHECK_EQUAL(range[0].offset, 6u);
+	BOOST_CHECK_EQUAL(range[1].offset, 6u);
+	BOOST_CHECK(index.in_range(8, 100).empty());
+}
+
+BOOST_AUTO_TEST_CASE(against_map)
+{
+	CursorIndex index;
+	std::map<int, std::size_t> expected;
+	std::size_t size = 10000;
+	unsigned int seed = 7;
+
+	auto const random = [&seed](std::size_t bound)
+	{
+		seed = seed * 1103515245 + 12345;
+
+		return (seed >> 8) % bound;
+	};
+
+	for (int step = 0; step < 3000; step++)
+	{
+		switch (random(4))
+		{
+		case 0:
+		{
+			int const id = random(200);
+			std::size_t const offset = random(size + 1);
+
+			index.set(id, offset);
+			expected[id] = offset;
+			break;
+		}
+
+		case 1:
+		{
+			int const id = random(200);
+
+			index.remove(id);
+			expected.erase(id);
+			break;
+		}
+
+		default:
+		{
+			std::size_t const offset = random(size + 1);
+			std::size_t const erased = std::min(random(50), size - offset);
+			std::size_t const inserted = random(50);
+
+			index.apply(offset, erased, inserted);
+
+			for (auto &cursor: expected)
+			{
+				cursor.second = follow(cursor.second, offset, erased, inserted);
+			}
+
+			size += inserted - erased;
+			break;
+		}
+		}
+
+		if (step % 100 == 0)
+		{
+			check_cursors(index, expected);
+		}
+	}
+
+	check_cursors(index, expected);
+
+	// ranges hold exactly the cursors within them
+	for (std::size_t begin = 0; begin < size; begin += 997)
+	{
+		std::size_t const end = begin + 1500;
+		std::size_t count = 0;
+
+		for (auto const &cursor: expected)
+		{
+			count += cursor.second >= begin && cursor.second < end;
+		}
+
+		std::vector<CursorIndex::Cursor> const range = index.in_range(begin, end);
+
+		BOOST_REQUIRE_EQUAL(range.size(), count);
+
+		for (auto const &cursor: range)
+		{
+			BOOST_REQUIRE_EQUAL(expected.at(cursor.id), cursor.offset);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
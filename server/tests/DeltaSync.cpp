@@ -0,0 +1,72 @@
+#include "DeltaSync.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(DeltaSyncSuite)
+
+namespace
+{
+	std::vector<char> random_bytes(std::size_t size, unsigned int &seed)
+	{
+		std::vector<char> bytes(size);
+
+		for (auto &byte: bytes)
+		{
+			seed = seed * 1103515245 + 12345;
+			byte = static_cast<char>(seed >> 16);
+		}
+
+		return bytes;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(signatures)
+{
+	unsigned int seed = 3;
+	Rope const rope(Rope::make_buffer(random_bytes(100 * 1024, seed)));
+	std::vector<ChunkTree::Chunk> const chunks = ChunkTree(rope).chunks();
+	std::vector<char> const bytes = DeltaSync::encode_signatures(chunks);
+	std::vector<ChunkTree::Chunk> const decoded = DeltaSync::decode_signatures(bytes);
+
+	BOOST_CHECK_EQUAL(bytes.size(), chunks.size() * DeltaSync::signature_size);
+	BOOST_REQUIRE_EQUAL(decoded.size(), chunks.size());
+
+	for (std::size_t i = 0; i < chunks.size(); i++)
+	{
+		BOOST_CHECK_EQUAL(decoded[i].length, chunks[i].length);
+		BOOST_CHECK(decoded[i].hash == chunks[i].hash);
+	}
+
+	BOOST_CHECK_THROW(
+		DeltaSync::decode_signatures(std::vector<char>(5)),
+		deltasync_errors::InvalidDeltaError);
+}
+
+BOOST_AUTO_TEST_CASE(resynchronisation)
+{
+	unsigned int seed = 5;
+	std::vector<char> const outdated = random_bytes(1024 * 1024, seed);
+	Rope contents(Rope::make_buffer(outdated));
+
+	// a few edits spread over the document
+	contents.erase(100 * 1024, 300);
+	contents.insert(500 * 1024, random_bytes(4000, seed));
+	contents.insert(0, random_bytes(10, seed));
+
+	ChunkTree const chunks(contents);
+	std::vector<char> const delta = DeltaSync::make_delta(contents, chunks,
+		ChunkTree(Rope(Rope::make_buffer(outdated))).chunks());
+
+	BOOST_CHECK(DeltaSync::apply_delta(outdated, delta) == contents.flatten());
+
+	// only the chunks around the edits are sent
+	BOOST_CHECK(delta.size() < 100 * 1024);
+
+	// an empty copy gets everything
+	std::vector<char> const full = DeltaSync::make_delta(contents, chunks,
+		std::vector<ChunkTree::Chunk>());
+
+	BOOST_CHECK(DeltaSync::apply_delta(std::vector<char>(), full) == contents.flatten());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
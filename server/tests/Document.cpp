@@ -0,0 +1,773 @@
+#include "ChunkStorage.h"
+#include "CompressedStorage.h"
+#include "Document.h"
+#include "InPlaceStorage.h"
+#include "JournalStorage.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+
+BOOST_AUTO_TEST_SUITE(DocumentSuite)
+
+namespace
+{
+	std::string const g_document_name = "./document_test.txt";
+
+	std::string to_string(Document const &document)
+	{
+		std::vector<char> const bytes = document.get_contents().flatten();
+
+		return std::string(bytes.begin(), bytes.end());
+	}
+
+	std::string file_contents(std::string const &name)
+	{
+		std::ifstream file(name.c_str(), std::ios::binary);
+
+		return std::string(std::istreambuf_iterator<char>(file),
+		                   std::istreambuf_iterator<char>());
+	}
+
+	void remove_document(std::string const &name)
+	{
+		std::remove(name.c_str());
+		std::remove(JournalStorage::journal_name(name).c_str());
+	}
+
+	void write_file(std::string const &name, std::string const &contents)
+	{
+		std::ofstream file(name.c_str(), std::ios::binary | std::ios::trunc);
+
+		file << contents;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(open_modes)
+{
+	write_file(g_document_name, "hello world");
+
+	for (auto const mode: { Document::OpenMode::read, Document::OpenMode::mapped })
+	{
+		Document document = Document::open(g_document_name, mode);
+
+		BOOST_CHECK_EQUAL(to_string(document), "hello world");
+		BOOST_CHECK(!Document::is_empty(g_document_name));
+	}
+
+	remove_document(g_document_name);
+}
+
+BOOST_AUTO_TEST_CASE(save_and_reopen)
+{
+	write_file(g_document_name, "hello world");
+
+	{
+		Document document = Document::open(g_document_name, Document::OpenMode::mapped,
+		                                   Document::StorageMode::rewrite);
+		Hash::hash_t const before = document.hash();
+
+		document.erase(5, 6);
+		document.insert(0, std::vector<char> { '>', ' ' });
+		BOOST_CHECK(document.hash() != before);
+
+		// a shrinking document must not keep stale bytes
+		document.save();
+		BOOST_CHECK_EQUAL(file_contents(g_document_name), "> hello");
+		BOOST_CHECK_EQUAL(to_string(document), "> hello");
+	}
+
+	Document document = Document::open(g_document_name);
+
+	BOOST_CHECK_EQUAL(to_string(document), "> hello");
+
+	remove_document(g_document_name);
+}
+
+BOOST_AUTO_TEST_CASE(in_place_saves)
+{
+	for (auto const mode: { Document::OpenMode::read, Document::OpenMode::mapped })
+	{
+		write_file(g_document_name, "hello world");
+
+		{
+			Document document = Document::open(g_document_name, mode,
+			                                   Document::StorageMode::in_place);
+			Rope const stored = document.get_contents();
+
+			// replacing bytes keeps the tail in place
+			document.erase(6, 5);
+			document.insert(6, std::vector<char> { 't', 'h', 'e', 'r', 'e' });
+
+			auto const ranges = InPlaceStorage::dirty_ranges(document.get_contents(), stored);
+
+			BOOST_REQUIRE_EQUAL(ranges.size(), 1);
+			BOOST_CHECK_EQUAL(ranges[0].offset, 6);
+			BOOST_CHECK_EQUAL(ranges[0].length, 5);
+
+			document.save();
+			BOOST_CHECK_EQUAL(file_contents(g_document_name), "hello there");
+
+			// a shrinking document is truncated
+			document.erase(0, 6);
+			document.save();
+			BOOST_CHECK_EQUAL(file_contents(g_document_name), "there");
+			BOOST_CHECK_EQUAL(to_string(document), "there");
+
+			document.insert(5, std::vector<char> { '!' });
+			document.save();
+		}
+
+		Document document = Document::open(g_document_name, mode);
+
+		BOOST_CHECK_EQUAL(to_string(document), "there!");
+	}
+
+	// versions pinned before a save keep their contents, however the file changes
+	for (auto const mode: { Document::OpenMode::read, Document::OpenMode::mapped })
+	{
+		write_file(g_document_name, std::string(64 * 1024, 'x') + "tail");
+
+		Document document = Document::open(g_document_name, mode,
+		                                   Document::StorageMode::in_place);
+		Document::version_ptr const pinned = document.pin();
+
+		document.erase(0, 64 * 1024);
+		document.insert(0, std::vector<char> { 'y' });
+		document.save();
+		BOOST_CHECK_EQUAL(file_contents(g_document_name), "ytail");
+
+		std::vector<char> const contents = pinned->get_contents().flatten();
+		BOOST_CHECK_EQUAL(std::string(contents.begin(), contents.end()),
+		                  std::string(64 * 1024, 'x') + "tail");
+	}
+
+	// saves in the background don't write again what the one before wrote
+	{
+		SaveQueue queue;
+		auto const save = [&queue](Document &document)
+		{
+			bool saved = false;
+
+			document.save(queue,
+				[&saved](std::exception_ptr error)
+				{
+					saved = !error;
+				});
+
+			::pollfd descriptor = { queue.get_fd(), POLLIN, 0 };
+
+			BOOST_REQUIRE_EQUAL(::poll(&descriptor, 1, 10000), 1);
+			queue.dispatch();
+			BOOST_CHECK(saved);
+		};
+
+		write_file(g_document_name, "hello world");
+
+		Document document = Document::open(g_document_name, Document::OpenMode::read,
+		                                   Document::StorageMode::in_place);
+
+		document.erase(0, 1);
+		document.insert(0, std::vector<char> { 'j' });
+		save(document);
+		BOOST_CHECK_EQUAL(file_contents(g_document_name), "jello world");
+
+		// a byte changed behind the document's back shows what gets written
+		std::fstream(g_document_name.c_str(), std::ios::binary | std::ios::in | std::ios::out)
+			<< 'Z';
+
+		document.insert(11, std::vector<char> { '!' });
+		save(document);
+		BOOST_CHECK_EQUAL(file_contents(g_document_name), "Zello world!");
+	}
+
+	remove_document(g_document_name);
+}
+
+BOOST_AUTO_TEST_CASE(journal_replay)
+{
+	std::string const journal_name = JournalStorage::journal_name(g_document_name);
+
+	write_file(g_document_name, "hello world");
+
+	{
+		Document document = Document::open(g_document_name);
+
+		document.erase(5, 6);
+		document.insert(0, std::vector<char> { '>', ' ' });
+		document.save();
+		// saving keeps the edits, the document file doesn't hold them
+		BOOST_CHECK_EQUAL(to_string(document), "> hello");
+		document.insert(7, std::vector<char> { '!' });
+		document.save();
+		BOOST_CHECK_EQUAL(to_string(document), "> hello!");
+
+		// only the journal was written
+		BOOST_CHECK_EQUAL(file_contents(g_document_name), "hello world");
+
+		// never saved
+		document.erase(0, 2);
+	}
+
+	// a record cut off by an interrupted save is dropped
+	std::ofstream(journal_name.c_str(), std::ios::binary | std::ios::app) << "I\0\0";
+
+	for (auto const mode: { Document::OpenMode::read, Document::OpenMode::mapped })
+	{
+		Document document = Document::open(g_document_name, mode,
+		                                   Document::StorageMode::rewrite);
+
+		BOOST_CHECK_EQUAL(to_string(document), "> hello!");
+		BOOST_CHECK(!Document::is_empty(g_document_name));
+	}
+
+	// the next save cuts it off even without edits, nothing may follow it
+	std::size_t const torn_size = file_contents(journal_name).size();
+
+	Document::open(g_document_name).save();
+	BOOST_CHECK_EQUAL(file_contents(journal_name).size(), torn_size - 1);
+
+	Document::open(g_document_name).remove();
+	BOOST_CHECK_THROW(Document::open(journal_name), document_errors::DocumentDoesntExistError);
+}
+
+BOOST_AUTO_TEST_CASE(journal_compaction)
+{
+	std::string const journal_name = JournalStorage::journal_name(g_document_name);
+	std::vector<char> const block(JournalStorage::compaction_threshold / 4, 'x');
+	std::string expected;
+
+	{
+		Document document = Document::create(g_document_name, true);
+
+		for (int i = 0; i < 5; i++)
+		{
+			document.insert(document.size(), block);
+			document.save();
+			expected.append(block.begin(), block.end());
+		}
+
+		// saved while the compaction may be running
+		document.insert(0, std::vector<char> { 'a' });
+		document.save();
+		expected.insert(0, "a");
+	}
+
+	BOOST_CHECK(file_contents(journal_name).size() < JournalStorage::compaction_threshold);
+	BOOST_CHECK(file_contents(g_document_name).size() >= 4 * block.size());
+
+	{
+		Document document = Document::open(g_document_name);
+
+		BOOST_CHECK(to_string(document) == expected);
+		document.remove();
+	}
+}
+
+BOOST_AUTO_TEST_CASE(background_saves)
+{
+	SaveQueue queue;
+
+	for (auto const storage: { Document::StorageMode::rewrite, Document::StorageMode::journal,
+	                           Document::StorageMode::in_place,
+	                           Document::StorageMode::container,
+	                           Document::StorageMode::deduplicated,
+	                           Document::StorageMode::compressed })
+	{
+		write_file(g_document_name, "hello world");
+
+		{
+			Document document = Document::open(g_document_name,
+			                                   Document::OpenMode::mapped, storage);
+			bool saved = false;
+
+			document.erase(0, 6);
+			document.save(queue,
+				[&saved](std::exception_ptr error)
+				{
+					saved = !error;
+				});
+
+			// editing goes on while the snapshot is written
+			document.insert(5, std::vector<char> { '!' });
+
+			::pollfd descriptor = { queue.get_fd(), POLLIN, 0 };
+
+			BOOST_REQUIRE_EQUAL(::poll(&descriptor, 1, 10000), 1);
+			queue.dispatch();
+			BOOST_CHECK(saved);
+			BOOST_CHECK_EQUAL(to_string(document), "world!");
+		}
+
+		Document document = Document::open(g_document_name);
+
+		BOOST_CHECK_EQUAL(to_string(document), "world");
+		remove_document(g_document_name);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(line_addressing)
+{
+	write_file(g_document_name, "one\ntwo\n");
+
+	{
+		Document document = Document::open(g_document_name);
+
+		BOOST_CHECK_EQUAL(document.lines(), 3u);
+		BOOST_CHECK_EQUAL(document.offset_of(1, 2), 6u);
+		BOOST_CHECK(document.position_of(6) == std::make_pair(std::size_t(1), std::size_t(2)));
+		BOOST_CHECK_THROW(document.offset_of(1, 4), rope_errors::OutOfRangeError);
+
+		// the index follows the edits
+		document.insert(0, std::vector<char> { 'z', 'e', 'r', 'o', '\n' });
+		document.erase(9, 4);
+		BOOST_CHECK_EQUAL(to_string(document), "zero\none\n");
+		BOOST_CHECK_EQUAL(document.lines(), 3u);
+		BOOST_CHECK_EQUAL(document.offset_of(2, 0), 9u);
+	}
+
+	remove_document(g_document_name);
+}
+
+BOOST_AUTO_TEST_CASE(container_format)
+{
+	using document_errors::DocumentError;
+
+	std::string const text = "one\ntwo\n";
+
+	for (auto const mode: { Document::OpenMode::read, Document::OpenMode::mapped })
+	{
+		write_file(g_document_name, text);
+
+		Document document = Document::open(g_document_name, mode,
+		                                   Document::StorageMode::container);
+
+		BOOST_CHECK_EQUAL(to_string(document), text);
+
+		// the plain file only becomes a container with the first save
+		BOOST_CHECK_EQUAL(file_contents(g_document_name), text);
+		document.insert(0, std::vector<char> { '>' });
+		document.save();
+		BOOST_CHECK_EQUAL(to_string(document), ">" + text);
+		document.erase(0, 1);
+		document.save();
+		BOOST_CHECK(file_contents(g_document_name) != text);
+	}
+
+	{
+		// containers are recognized whatever mode is asked for
+		Document document = Document::open(g_document_name);
+
+		BOOST_CHECK_EQUAL(to_string(document), text);
+		BOOST_CHECK_EQUAL(document.lines(), 3u);
+		BOOST_CHECK_EQUAL(document.offset_of(1, 0), 4u);
+		BOOST_CHECK(document.hash() == Hash::hash_bytes(text.data(), text.size()));
+		BOOST_CHECK(!Document::is_empty(g_document_name));
+	}
+
+	std::string stored = file_contents(g_document_name);
+
+	// the hash comes from the header, the fixed fields, one run and the chunk length precede it
+	stored[36 + 8 + 4] ^= 1;
+	write_file(g_document_name, stored);
+	BOOST_CHECK(Document::open(g_document_name).hash()
+		!= Hash::hash_bytes(text.data(), text.size()));
+
+	// a header not matching the file is refused
+	write_file(g_document_name, stored + "trailing");
+	BOOST_CHECK_THROW(Document::open(g_document_name), DocumentError);
+
+	remove_document(g_document_name);
+}
+
+BOOST_AUTO_TEST_CASE(deduplicated_storage)
+{
+	using document_errors::DocumentError;
+
+	std::string const copy_name = g_document_name + ".copy";
+	std::string const store = ChunkStorage::store_of(g_document_name);
+	std::string text;
+
+	// big enough to be cut into many chunks
+	for (int i = 0; i < 20000; i++)
+	{
+		text += "line " + std::to_string(i * 7919 % 10007) + "\n";
+	}
+
+	auto const count_files = [&store](std::string const &pattern)
+	{
+		std::string const command = "find " + store + " -type f -name '" + pattern + "' | wc -l";
+		FILE *pipe = ::popen(command.c_str(), "r");
+		int count = 0;
+
+		BOOST_REQUIRE(pipe);
+		BOOST_REQUIRE_EQUAL(std::fscanf(pipe, "%d", &count), 1);
+		::pclose(pipe);
+
+		return count;
+	};
+
+	write_file(g_document_name, text);
+
+	{
+		Document document = Document::open(g_document_name, Document::OpenMode::mapped,
+		                                   Document::StorageMode::deduplicated);
+
+		document.insert(0, std::vector<char> { '>' });
+		document.save();
+	}
+
+	BOOST_CHECK(file_contents(g_document_name).size() < text.size() / 10);
+
+	int const chunks = count_files("*");
+
+	BOOST_CHECK(chunks > 1);
+
+	{
+		// a second document with nearly the same contents only adds a few chunks
+		write_file(copy_name, text + "tail\n");
+
+		Document copy = Document::open(copy_name, Document::OpenMode::read,
+		                               Document::StorageMode::deduplicated);
+
+		copy.save();
+		BOOST_CHECK(count_files("*") - chunks <= 2);
+	}
+
+	// documents saved on several threads at once may store the same new chunks
+	for (int round = 0; round < 5; round++)
+	{
+		std::string twin_text;
+
+		for (int i = 0; i < 5000; i++)
+		{
+			twin_text += "twin " + std::to_string(i * (7919 + round) % 10007) + "\n";
+		}
+
+		std::vector<std::thread> threads;
+		int failures[2] = { 0, 0 };
+
+		for (int twin = 0; twin < 2; twin++)
+		{
+			std::string const name = copy_name + std::to_string(twin);
+
+			write_file(name, twin_text);
+			threads.push_back(std::thread([name, twin, &failures]()
+				{
+					try
+					{
+						Document::open(name, Document::OpenMode::read,
+						               Document::StorageMode::deduplicated).save();
+					}
+					catch (DocumentError const &)
+					{
+						failures[twin]++;
+					}
+				}));
+		}
+
+		for (auto &thread: threads)
+		{
+			thread.join();
+		}
+
+		BOOST_CHECK_EQUAL(failures[0] + failures[1], 0);
+
+		for (int twin = 0; twin < 2; twin++)
+		{
+			std::string const name = copy_name + std::to_string(twin);
+
+			BOOST_CHECK_EQUAL(to_string(Document::open(name)), twin_text);
+			remove_document(name);
+		}
+	}
+
+	// no temporary file of a chunk is left behind
+	BOOST_CHECK_EQUAL(count_files("*.*"), 0);
+
+	{
+		// manifests are recognized whatever mode is asked for
+		Document document = Document::open(g_document_name);
+
+		BOOST_CHECK_EQUAL(to_string(document), ">" + text);
+		// the hash comes from the manifest
+		BOOST_CHECK(document.hash() == ChunkTree(document.get_contents()).root());
+		BOOST_CHECK_EQUAL(to_string(Document::open(copy_name)), text + "tail\n");
+		BOOST_CHECK(!Document::is_empty(g_document_name));
+	}
+
+	{
+		// chunks only the replaced manifest referred to are deleted
+		Document document = Document::open(g_document_name);
+
+		document.insert(text.size() / 2, std::vector<char> { '#' });
+		document.save();
+
+		int const edited = count_files("*");
+
+		for (int i = 0; i < 5; i++)
+		{
+			document.insert(text.size() / 2, std::vector<char> { '#' });
+			document.save();
+		}
+
+		BOOST_CHECK(count_files("*") <= edited + 1);
+	}
+
+	{
+		// removing a manifest deletes the chunks no other one refers to
+		int const both = count_files("*");
+
+		Document::open(copy_name).remove();
+		BOOST_CHECK(count_files("*") < both);
+		BOOST_CHECK_EQUAL(to_string(Document::open(g_document_name)).size(), text.size() + 7);
+	}
+
+	// a chunk missing in the store is reported
+	BOOST_REQUIRE_EQUAL(std::system(("find " + store + " -type f -delete").c_str()), 0);
+	BOOST_CHECK_THROW(Document::open(g_document_name), DocumentError);
+
+	BOOST_REQUIRE_EQUAL(std::system(("rm -rf " + store).c_str()), 0);
+	remove_document(copy_name);
+	remove_document(g_document_name);
+}
+
+BOOST_AUTO_TEST_CASE(compressed_storage)
+{
+	using document_errors::DocumentError;
+
+	std::string text;
+
+	// several blocks of well compressible text
+	for (int i = 0; i < 30000; i++)
+	{
+		text += "line " + std::to_string(i % 100) + "\n";
+	}
+
+	for (auto const mode: { Document::OpenMode::read, Document::OpenMode::mapped })
+	{
+		write_file(g_document_name, text);
+
+		Document document = Document::open(g_document_name, mode,
+		                                   Document::StorageMode::compressed);
+
+		document.save();
+		BOOST_CHECK(file_contents(g_document_name).size() < text.size() / 4);
+		BOOST_CHECK_EQUAL(to_string(document), text);
+	}
+
+	{
+		// compressed files are recognized whatever mode is asked for
+		Document document = Document::open(g_document_name);
+		std::size_t offset;
+
+		BOOST_CHECK_EQUAL(document.lines(), 30001u);
+		BOOST_CHECK(document.hash() == ChunkTree(Rope(Rope::make_buffer(
+			std::vector<char>(text.begin(), text.end())))).root());
+		BOOST_CHECK_EQUAL(document.get_contents_file(offset), -1);
+
+		// an edit in the middle only deflates its block again
+		document.insert(CompressedStorage::block_size + 1, std::vector<char> { '!' });
+		document.erase(0, 5);
+		document.save();
+		text.insert(CompressedStorage::block_size + 1, "!");
+		text.erase(0, 5);
+		BOOST_CHECK_EQUAL(to_string(document), text);
+		BOOST_CHECK_EQUAL(to_string(Document::open(g_document_name)), text);
+		BOOST_CHECK(!Document::is_empty(g_document_name));
+	}
+
+	std::string stored = file_contents(g_document_name);
+
+	// a damaged block is noticed once it is inflated
+	stored[stored.size() - 10] ^= 0x55;
+	write_file(g_document_name, stored);
+
+	{
+		Document document = Document::open(g_document_name);
+
+		BOOST_CHECK_THROW(to_string(document), DocumentError);
+	}
+
+	// a header not matching the file is refused
+	write_file(g_document_name, stored + "trailing");
+	BOOST_CHECK_THROW(Document::open(g_document_name), DocumentError);
+
+	remove_document(g_document_name);
+}
+
+BOOST_AUTO_TEST_CASE(contents_files)
+{
+	for (auto const storage: { Document::StorageMode::rewrite, Document::StorageMode::journal,
+	                           Document::StorageMode::in_place,
+	                           Document::StorageMode::container })
+	{
+		write_file(g_document_name, "hello world");
+
+		Document document = Document::open(g_document_name, Document::OpenMode::mapped,
+		                                   storage);
+		std::size_t offset = 1;
+
+		BOOST_CHECK(document.get_contents_file(offset) >= 0);
+		BOOST_CHECK_EQUAL(offset, 0u);
+
+		// edits are only in memory until saved
+		document.insert(0, std::vector<char> { '>' });
+		BOOST_CHECK_EQUAL(document.get_contents_file(offset), -1);
+		document.save();
+
+		int const fd = document.get_contents_file(offset);
+		char bytes[12];
+
+		if (storage == Document::StorageMode::journal)
+		{
+			// the edit went to the journal, not into the document file
+			BOOST_CHECK_EQUAL(fd, -1);
+		}
+		else
+		{
+			BOOST_REQUIRE(fd >= 0);
+			BOOST_REQUIRE_EQUAL(::pread(fd, bytes, sizeof(bytes), offset), 12);
+			BOOST_CHECK_EQUAL(std::string(bytes, sizeof(bytes)), ">hello world");
+		}
+
+		document.close();
+		remove_document(g_document_name);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(versions)
+{
+	write_file(g_document_name, "hello world");
+
+	{
+		Document document = Document::open(g_document_name, Document::OpenMode::mapped);
+		Document::version_ptr const first = document.pin();
+		Hash::hash_t const hash = document.hash();
+
+		BOOST_CHECK_EQUAL(first->get_number(), document.get_version());
+
+		bool unchanged = true;
+
+		// a reader hashes the pinned version while the document is edited
+		std::thread reader(
+			[first, hash, &unchanged]()
+			{
+				for (int i = 0; i < 100; i++)
+				{
+					unchanged = unchanged && first->hash() == hash;
+				}
+			});
+
+		for (int i = 0; i < 100; i++)
+		{
+			document.insert(document.size(), std::vector<char> { '!' });
+		}
+
+		reader.join();
+		BOOST_CHECK(unchanged);
+
+		Document::version_ptr const last = document.pin();
+
+		BOOST_CHECK_EQUAL(last->get_number(), first->get_number() + 100);
+		BOOST_CHECK_EQUAL(first->get_contents().size(), 11u);
+		BOOST_CHECK_EQUAL(last->get_contents().size(), 111u);
+		BOOST_CHECK(last->hash() == document.hash());
+
+		// past versions can be materialised from the history
+		std::vector<char> const past = document.get_history().at(first->get_number() + 1).flatten();
+
+		BOOST_CHECK_EQUAL(std::string(past.begin(), past.end()), "hello world!");
+
+		// saving doesn't change the contents, the version stays
+		document.save();
+		BOOST_CHECK_EQUAL(document.pin()->get_number(), last->get_number());
+	}
+
+	remove_document(g_document_name);
+}
+
+BOOST_AUTO_TEST_CASE(cloning)
+{
+	using document_errors::DocumentAlreadyExistsError;
+
+	std::string const clone_name = g_document_name + ".clone";
+
+	for (auto const storage: { Document::StorageMode::rewrite, Document::StorageMode::container })
+	{
+		write_file(g_document_name, "template");
+
+		Document source = Document::open(g_document_name, Document::OpenMode::mapped, storage);
+
+		// the source file holds the contents, so it is copied by the kernel
+		source.save();
+
+		{
+			Document clone = Document::clone(source, clone_name);
+
+			BOOST_CHECK_EQUAL(to_string(clone), "template");
+			BOOST_CHECK(clone.hash() == source.hash());
+			BOOST_CHECK(clone.get_id() != source.get_id());
+			BOOST_CHECK_EQUAL(to_string(Document::open(clone_name)), "template");
+
+			// both go their own ways from now on
+			clone.insert(0, std::vector<char> { '!' });
+			BOOST_CHECK_EQUAL(to_string(source), "template");
+		}
+
+		BOOST_CHECK_THROW(Document::clone(source, clone_name), DocumentAlreadyExistsError);
+
+		// an edited source is written from its contents
+		source.erase(0, 4);
+
+		Document clone = Document::clone(source, clone_name, true,
+		                                 Document::StorageMode::rewrite);
+
+		BOOST_CHECK_EQUAL(file_contents(clone_name), "late");
+		BOOST_CHECK_EQUAL(to_string(clone), "late");
+
+		remove_document(clone_name);
+		remove_document(g_document_name);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(cursors_follow_edits)
+{
+	write_file(g_document_name, "hello world");
+
+	Document document = Document::open(g_document_name);
+	CursorIndex &cursors = document.get_cursors();
+
+	cursors.set(1, 0);
+	cursors.set(2, 6);
+	cursors.set(3, 11);
+	document.insert(6, std::vector<char> { 'b', 'i', 'g', ' ' });
+	BOOST_CHECK_EQUAL(cursors.offset_of(1), 0u);
+	BOOST_CHECK_EQUAL(cursors.offset_of(2), 6u);
+	BOOST_CHECK_EQUAL(cursors.offset_of(3), 15u);
+
+	document.erase(0, 8);
+	BOOST_CHECK_EQUAL(cursors.offset_of(1), 0u);
+	BOOST_CHECK_EQUAL(cursors.offset_of(2), 0u);
+	BOOST_CHECK_EQUAL(cursors.offset_of(3), 7u);
+	BOOST_CHECK_EQUAL(cursors.in_range(0, 1).size(), 2u);
+
+	remove_document(g_document_name);
+}
+
+BOOST_AUTO_TEST_CASE(missing_documents)
+{
+	using document_errors::DocumentDoesntExistError;
+
+	BOOST_CHECK_THROW(Document::open("./does_not_exist"), DocumentDoesntExistError);
+	BOOST_CHECK_THROW(Document::is_empty("./does_not_exist"), DocumentDoesntExistError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,120 @@
+#include "DocumentCatalog.h"
+#include "DocumentLayout.h"
+#include "SQLiteDatabase.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+
+BOOST_AUTO_TEST_SUITE(DocumentCatalogSuite)
+
+namespace
+{
+	std::string const g_directory = "./catalog_test/";
+
+	std::string path_of(std::string const &name)
+	{
+		return DocumentLayout::path_of(g_directory, name);
+	}
+
+	void write_file(std::string const &name, std::string const &contents)
+	{
+		DocumentLayout::make_shard(path_of(name));
+
+		std::ofstream file(path_of(name).c_str(), std::ios::binary | std::ios::trunc);
+
+		file << contents;
+	}
+
+	void remove_file(std::string const &name)
+	{
+		std::remove(path_of(name).c_str());
+		DocumentLayout::prune_shard(path_of(name));
+	}
+
+	void process_events(DocumentCatalog &catalog)
+	{
+		::pollfd descriptor = { catalog.get_fd(), POLLIN, 0 };
+
+		BOOST_REQUIRE_EQUAL(::poll(&descriptor, 1, 10000), 1);
+		catalog.process_events();
+	}
+
+	std::vector<std::string> names_of(std::vector<DocumentCatalog::Entry> const &entries)
+	{
+		std::vector<std::string> names;
+
+		for (auto const &entry: entries)
+		{
+			names.push_back(entry.name);
+		}
+
+		return names;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(listing_and_changes)
+{
+	using namespace document_errors;
+
+	auto const database = std::make_shared<SQLiteDatabase>(SQLiteDatabase::temporary());
+	std::int32_t alpha_id;
+
+	::mkdir(g_directory.c_str(), 0755);
+	write_file("alpha", "hello");
+	write_file("beta", "");
+	write_file(".hidden", "not a document");
+	write_file("gamma.tmp", "left behind by a save");
+
+	{
+		DocumentCatalog catalog(database, g_directory);
+		DocumentCatalog::Entry const alpha = catalog.lookup("alpha");
+
+		alpha_id = alpha.id;
+		BOOST_CHECK_EQUAL(catalog.size(), 2);
+		BOOST_CHECK_EQUAL(alpha.size, 5);
+		BOOST_CHECK(alpha.hash == Document::open(path_of("alpha")).hash());
+		BOOST_CHECK_EQUAL(catalog.id_of("alpha"), alpha_id);
+		BOOST_CHECK_THROW(catalog.lookup("missing"), DocumentDoesntExistError);
+
+		// pages continue after the last name of the previous one
+		BOOST_CHECK(names_of(catalog.list("", 1)) == std::vector<std::string>({ "alpha" }));
+		BOOST_CHECK(names_of(catalog.list("alpha", 10)) == std::vector<std::string>({ "beta" }));
+
+		write_file("alpha", "hello world");
+		write_file("delta", "new");
+		remove_file("beta");
+		process_events(catalog);
+
+		BOOST_CHECK(names_of(catalog.list("", 10))
+			== std::vector<std::string>({ "alpha", "delta" }));
+		BOOST_CHECK_EQUAL(catalog.lookup("alpha").size, 11);
+		BOOST_CHECK_EQUAL(catalog.lookup("alpha").id, alpha_id);
+	}
+
+	// changes made while the catalog was closed are found on startup
+	write_file("alpha", "hi");
+
+	{
+		DocumentCatalog catalog(database, g_directory);
+		DocumentCatalog::Entry const alpha = catalog.lookup("alpha");
+
+		BOOST_CHECK_EQUAL(alpha.id, alpha_id);
+		BOOST_CHECK_EQUAL(alpha.size, 2);
+		BOOST_CHECK_EQUAL(catalog.size(), 2);
+	}
+
+	for (auto const &name: { "alpha", "delta", ".hidden", "gamma.tmp" })
+	{
+		remove_file(name);
+	}
+
+	::rmdir(g_directory.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
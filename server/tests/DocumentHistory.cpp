@@ -0,0 +1,105 @@
+#include "DocumentHistory.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+BOOST_AUTO_TEST_SUITE(DocumentHistorySuite)
+
+namespace
+{
+	std::string to_string(Rope const &rope)
+	{
+		std::vector<char> const bytes = rope.flatten();
+
+		return std::string(bytes.begin(), bytes.end());
+	}
+
+	/**
+	 * Apply an edit to the rope and the history and return the contents after it.
+	 */
+	std::string edit(Rope &rope, DocumentHistory &history, unsigned int &seed)
+	{
+		seed = seed * 1103515245 + 12345;
+
+		std::size_t const offset = (seed >> 8) % (rope.size() + 1);
+
+		if (seed % 3 == 0 && offset < rope.size())
+		{
+			std::size_t const length = std::min<std::size_t>((seed >> 4) % 5 + 1,
+			                                                 rope.size() - offset);
+
+			rope.erase(offset, length);
+			history.erased(offset, length, rope);
+		}
+		else
+		{
+			std::vector<char> const bytes(1 + (seed >> 4) % 3, 'a' + (seed >> 12) % 26);
+
+			rope.insert(offset, bytes);
+			history.inserted(offset, bytes.data(), bytes.size(), rope);
+		}
+
+		return to_string(rope);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(materialising)
+{
+	std::string const text = "the first version";
+	Rope rope(Rope::make_buffer(std::vector<char>(text.begin(), text.end())));
+	DocumentHistory history(rope, 7);
+	std::vector<std::string> versions(1, text);
+	unsigned int seed = 3;
+
+	for (std::size_t i = 0; i < 3 * DocumentHistory::checkpoint_interval + 10; i++)
+	{
+		versions.push_back(edit(rope, history, seed));
+	}
+
+	BOOST_CHECK_EQUAL(history.first(), 7u);
+	BOOST_REQUIRE_EQUAL(history.last(), 7 + versions.size() - 1);
+
+	for (std::size_t i = 0; i < versions.size(); i++)
+	{
+		BOOST_REQUIRE_EQUAL(to_string(history.at(7 + i)), versions[i]);
+	}
+
+	BOOST_CHECK_THROW(history.at(6), rope_errors::OutOfRangeError);
+	BOOST_CHECK_THROW(history.at(history.last() + 1), rope_errors::OutOfRangeError);
+
+	// every version was current from its own time on
+	for (std::uint64_t version = history.first(); version <= history.last(); version++)
+	{
+		std::uint64_t const found = history.version_at(history.time_of(version));
+
+		BOOST_REQUIRE(found >= version);
+		BOOST_REQUIRE_EQUAL(history.time_of(found), history.time_of(version));
+	}
+
+	BOOST_CHECK_THROW(history.version_at(history.time_of(7) - 1), rope_errors::OutOfRangeError);
+}
+
+BOOST_AUTO_TEST_CASE(retention)
+{
+	std::size_t const interval = DocumentHistory::checkpoint_interval;
+	Rope rope;
+	DocumentHistory history(rope, 0, interval);
+	std::vector<std::string> versions(1);
+	unsigned int seed = 11;
+
+	for (std::size_t i = 0; i < 4 * interval; i++)
+	{
+		versions.push_back(edit(rope, history, seed));
+	}
+
+	// old checkpoints are dropped, at least the retained operations stay
+	BOOST_CHECK(history.first() > 0);
+	BOOST_CHECK(history.last() - history.first() >= interval);
+	BOOST_CHECK_EQUAL(history.first() % interval, 0u);
+	BOOST_CHECK_THROW(history.at(history.first() - 1), rope_errors::OutOfRangeError);
+	BOOST_CHECK_EQUAL(to_string(history.at(history.first())), versions[history.first()]);
+	BOOST_CHECK_EQUAL(to_string(history.at(history.last())), versions.back());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
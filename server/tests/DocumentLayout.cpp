@@ -0,0 +1,78 @@
+#include "DocumentLayout.h"
+#include "Document.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+BOOST_AUTO_TEST_SUITE(DocumentLayoutSuite)
+
+namespace
+{
+	std::string const g_directory = "./layout_test/";
+
+	void write_file(std::string const &path)
+	{
+		std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(shards)
+{
+	std::string const shard = DocumentLayout::shard_of("notes");
+
+	// one hexadecimal digit and a slash per level
+	BOOST_CHECK_EQUAL(shard.size(), 2 * DocumentLayout::levels);
+	BOOST_CHECK_EQUAL(DocumentLayout::shard_of("notes"), shard);
+	BOOST_CHECK_EQUAL(DocumentLayout::path_of(g_directory, "notes"), g_directory + shard + "notes");
+	BOOST_CHECK(DocumentLayout::is_shard(shard.substr(0, 1)));
+	BOOST_CHECK(!DocumentLayout::is_shard("notes"));
+	BOOST_CHECK_EQUAL(DocumentLayout::root_of(DocumentLayout::path_of(g_directory, "notes")),
+	                  g_directory);
+	BOOST_CHECK_EQUAL(DocumentLayout::root_of(g_directory + "notes"), g_directory);
+}
+
+BOOST_AUTO_TEST_CASE(listing)
+{
+	std::vector<std::string> const names { "alpha", "beta", "gamma" };
+
+	::mkdir(g_directory.c_str(), 0755);
+
+	for (auto const &name: names)
+	{
+		std::string const path = DocumentLayout::path_of(g_directory, name);
+
+		DocumentLayout::make_shard(path);
+		write_file(path);
+	}
+
+	// storage files and files outside of shards aren't documents
+	write_file(DocumentLayout::path_of(g_directory, "alpha") + ".tmp");
+	write_file(g_directory + "flat");
+
+	std::vector<std::string> listed = Document::list_documents(g_directory);
+
+	std::sort(listed.begin(), listed.end());
+	BOOST_CHECK(listed == names);
+
+	std::remove((DocumentLayout::path_of(g_directory, "alpha") + ".tmp").c_str());
+	std::remove((g_directory + "flat").c_str());
+
+	for (auto const &name: names)
+	{
+		std::string const path = DocumentLayout::path_of(g_directory, name);
+
+		std::remove(path.c_str());
+		DocumentLayout::prune_shard(path);
+	}
+
+	// pruning removed all shards
+	BOOST_CHECK_EQUAL(::rmdir(g_directory.c_str()), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
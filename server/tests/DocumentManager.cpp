@@ -0,0 +1,108 @@
+#include "DocumentManager.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+
+BOOST_AUTO_TEST_SUITE(DocumentManagerSuite)
+
+namespace
+{
+	std::string const g_directory = "./manager_test/";
+
+	void dispatch(SaveQueue &queue)
+	{
+		::pollfd descriptor = { queue.get_fd(), POLLIN, 0 };
+
+		BOOST_REQUIRE_EQUAL(::poll(&descriptor, 1, 10000), 1);
+		queue.dispatch();
+	}
+}
+
+BOOST_AUTO_TEST_CASE(shared_instances)
+{
+	using namespace document_errors;
+
+	SaveQueue queue;
+	::mkdir(g_directory.c_str(), 0755);
+
+	{
+		DocumentManager documents(queue, std::chrono::seconds(60), g_directory);
+		DocumentManager::document_ptr const created = documents.create("shared");
+
+		BOOST_CHECK(documents.open("shared") == created);
+		BOOST_CHECK(documents.find(created->get_id()) == created);
+		BOOST_CHECK(!documents.find(created->get_id() + 1));
+		BOOST_CHECK_THROW(documents.create("shared"), DocumentAlreadyExistsError);
+		BOOST_CHECK_THROW(documents.open("../shared"), DocumentNameError);
+		BOOST_CHECK_THROW(documents.open("shared.journal"), DocumentNameError);
+		BOOST_CHECK_THROW(documents.create("shared.tmp"), DocumentNameError);
+		BOOST_CHECK_THROW(documents.create("notes.compact"), DocumentNameError);
+		BOOST_CHECK_THROW(documents.clone(*created, "clone.journal"), DocumentNameError);
+		BOOST_CHECK_THROW(documents.open("missing"), DocumentDoesntExistError);
+
+		DocumentManager::document_ptr const clone = documents.clone(*created, "clone");
+
+		BOOST_CHECK(documents.open("clone") == clone);
+		BOOST_CHECK(clone->get_id() != created->get_id());
+		BOOST_CHECK_THROW(documents.clone(*created, "shared"), DocumentAlreadyExistsError);
+
+		documents.remove("clone");
+		documents.remove("shared");
+		BOOST_CHECK(!documents.find(created->get_id()));
+		BOOST_CHECK_THROW(documents.open("shared"), DocumentDoesntExistError);
+	}
+
+	::rmdir(g_directory.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(hibernation)
+{
+	SaveQueue queue;
+	::mkdir(g_directory.c_str(), 0755);
+
+	{
+		DocumentManager documents(queue, std::chrono::seconds(60), g_directory);
+		auto const later = DocumentManager::clock::now() + std::chrono::seconds(120);
+		std::int32_t const active = documents.create("active")->get_id();
+		std::int32_t idle;
+
+		{
+			DocumentManager::document_ptr const document = documents.create("idle");
+
+			document->insert(0, std::vector<char> { 'h', 'i' });
+			idle = document->get_id();
+		}
+
+		documents.acquire(active);
+
+		// nothing is idle long enough yet
+		BOOST_CHECK_EQUAL(documents.hibernate(), 0);
+		BOOST_CHECK_EQUAL(documents.hibernate(later), 1);
+		BOOST_CHECK_EQUAL(documents.resident(), 2);
+
+		dispatch(queue);
+		BOOST_CHECK_EQUAL(documents.resident(), 1);
+
+		// coming back keeps id and saved contents
+		DocumentManager::document_ptr const document = documents.find(idle);
+
+		BOOST_REQUIRE(document);
+		BOOST_CHECK_EQUAL(document->get_id(), idle);
+		BOOST_CHECK(document->get_contents().flatten() == std::vector<char>({ 'h', 'i' }));
+
+		documents.release(active);
+		BOOST_CHECK_EQUAL(documents.hibernate(later), 2);
+
+		documents.remove("active");
+		documents.remove("idle");
+	}
+
+	::rmdir(g_directory.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
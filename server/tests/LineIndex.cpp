@@ -0,0 +1,106 @@
+#include "LineIndex.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <string>
+
+BOOST_AUTO_TEST_SUITE(LineIndexSuite)
+
+namespace
+{
+	std::vector<char> random_text(std::size_t size, unsigned int &seed)
+	{
+		std::vector<char> bytes(size);
+
+		for (auto &byte: bytes)
+		{
+			seed = seed * 1103515245 + 12345;
+			byte = (seed >> 16) % 16 ? 'x' : '\n';
+		}
+
+		return bytes;
+	}
+
+	void check_lines(LineIndex const &index, Rope const &rope)
+	{
+		std::vector<char> const bytes = rope.flatten();
+		std::size_t line = 0;
+
+		BOOST_REQUIRE_EQUAL(index.size(), bytes.size());
+		BOOST_REQUIRE_EQUAL(index.lines(), std::count(bytes.begin(), bytes.end(), '\n') + 1u);
+
+		for (std::size_t offset = 0; offset <= bytes.size(); offset++)
+		{
+			BOOST_REQUIRE_EQUAL(index.line_of(rope, offset), line);
+
+			if (offset == 0 || bytes[offset - 1] == '\n')
+			{
+				BOOST_REQUIRE_EQUAL(index.offset_of(rope, line), offset);
+			}
+
+			if (offset < bytes.size() && bytes[offset] == '\n')
+			{
+				line++;
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(translations)
+{
+	std::string const text = "first\nsecond\n\nlast";
+	Rope const rope(Rope::make_buffer(std::vector<char>(text.begin(), text.end())));
+	LineIndex const index(rope);
+
+	BOOST_CHECK_EQUAL(LineIndex().lines(), 1u);
+	BOOST_CHECK_EQUAL(index.lines(), 4u);
+	BOOST_CHECK_EQUAL(index.offset_of(rope, 1), 6u);
+	BOOST_CHECK_EQUAL(index.offset_of(rope, 3), 14u);
+	BOOST_CHECK_EQUAL(index.line_of(rope, 5), 0u);
+	BOOST_CHECK_EQUAL(index.line_of(rope, 6), 1u);
+	BOOST_CHECK_EQUAL(index.line_of(rope, text.size()), 3u);
+	BOOST_CHECK_THROW(index.offset_of(rope, 4), rope_errors::OutOfRangeError);
+	BOOST_CHECK_THROW(index.line_of(rope, text.size() + 1), rope_errors::OutOfRangeError);
+}
+
+BOOST_AUTO_TEST_CASE(incremental_updates)
+{
+	unsigned int seed = 7;
+	Rope rope(Rope::make_buffer(random_text(3 * LineIndex::run_size + 100, seed)));
+	LineIndex index(rope);
+
+	check_lines(index, rope);
+
+	for (int edit = 0; edit < 200; edit++)
+	{
+		seed = seed * 1103515245 + 12345;
+
+		std::size_t const offset = (seed >> 8) % (rope.size() + 1);
+		std::size_t const length = (seed >> 4) % 700;
+
+		if (edit % 3 == 0)
+		{
+			std::size_t const erased = std::min(length, rope.size() - offset);
+
+			rope.erase(offset, erased);
+			index.update(rope, offset, erased, 0);
+		}
+		else
+		{
+			rope.insert(offset, random_text(length, seed));
+			index.update(rope, offset, 0, length);
+		}
+	}
+
+	check_lines(index, rope);
+
+	// erasing everything leaves a single empty line
+	std::size_t const erased = rope.size();
+
+	rope.erase(0, erased);
+	index.update(rope, 0, erased, 0);
+	check_lines(index, rope);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,98 @@
+#ifndef LOOPBACK_H_INCLUDED
+#define LOOPBACK_H_INCLUDED
+
+#include "Client.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+
+/**
+ * @file Loopback.h
+ *
+ * A Client connected over the loopback interface to a peer socket the
+ * tests play the remote end with.
+ */
+class Loopback
+{
+public:
+	/**
+	 * Connect a peer and accept it as a Client.
+	 *
+	 * @param receive_buffer The receive buffer size of the peer, 0 for the
+	 *                       default. Small ones let the Client's socket fill up.
+	 */
+	explicit Loopback(int receive_buffer = 0)
+		: listener(::socket(AF_INET, SOCK_STREAM, 0)),
+		  peer(::socket(AF_INET, SOCK_STREAM, 0))
+	{
+		BOOST_REQUIRE(listener != -1 && peer != -1);
+
+		::sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		::socklen_t size = sizeof(address);
+		BOOST_REQUIRE_EQUAL(::bind(listener, reinterpret_cast<::sockaddr *>(&address), size), 0);
+		BOOST_REQUIRE_EQUAL(::listen(listener, 1), 0);
+		BOOST_REQUIRE_EQUAL(::getsockname(listener, reinterpret_cast<::sockaddr *>(&address),
+		                                  &size), 0);
+
+		if (receive_buffer)
+		{
+			::setsockopt(peer, SOL_SOCKET, SO_RCVBUF, &receive_buffer, sizeof(receive_buffer));
+		}
+		BOOST_REQUIRE_EQUAL(::connect(peer, reinterpret_cast<::sockaddr *>(&address), size), 0);
+
+		client = std::make_shared<Client>(listener);
+	}
+
+	~Loopback()
+	{
+		::close(peer);
+		::close(listener);
+	}
+
+	Loopback(Loopback const &) = delete;
+	Loopback &operator=(Loopback const &) = delete;
+
+	/**
+	 * Send bytes from the peer to the Client and wait for them to arrive.
+	 */
+	void send(std::string const &bytes)
+	{
+		BOOST_REQUIRE_EQUAL(::send(peer, bytes.data(), bytes.size(), 0),
+		                    static_cast<ssize_t>(bytes.size()));
+
+		::pollfd descriptor = { client->socket, POLLIN, 0 };
+		BOOST_REQUIRE_EQUAL(::poll(&descriptor, 1, 10000), 1);
+	}
+
+	/**
+	 * Receive everything the Client sent so far without blocking.
+	 */
+	std::string receive()
+	{
+		std::string received;
+		char bytes[65536];
+		ssize_t size;
+		while ((size = ::recv(peer, bytes, sizeof(bytes), MSG_DONTWAIT)) > 0)
+		{
+			received.append(bytes, size);
+		}
+
+		return received;
+	}
+
+	int const listener;
+	int const peer;
+	ClientSptr client;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include "MessageView.h"
+#include "exceptions.h"
+#include "Loopback.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <arpa/inet.h>
+
+#include <string>
+
+BOOST_AUTO_TEST_SUITE(MessageViewSuite)
+
+namespace
+{
+	std::string type_field(Message::MessageType type)
+	{
+		return std::string(1, static_cast<char>(type));
+	}
+
+	std::string size_field(uint32_t value)
+	{
+		value = htonl(value);
+		return std::string(reinterpret_cast<char const *>(&value), sizeof(value));
+	}
+
+	std::string to_string(ByteSpan const &span)
+	{
+		return std::string(span.begin(), span.end());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(decoding_in_place)
+{
+	Loopback loopback;
+	std::string const frame = type_field(Message::TYPE_SYNC_MULTIBYTE) + size_field(3) + "abc";
+
+	MessageView message;
+	size_t needed = 0;
+	BOOST_REQUIRE_EQUAL(message.parse(loopback.client, frame.data(), frame.size(), needed),
+	                    frame.size());
+	BOOST_CHECK(message.type == Message::TYPE_SYNC_MULTIBYTE);
+	BOOST_CHECK_EQUAL(message.length, 3);
+	BOOST_CHECK_EQUAL(to_string(message.bytes), "abc");
+	BOOST_CHECK(message.source == loopback.client);
+
+	// the fields are spans over the received bytes, not copies
+	BOOST_CHECK(message.bytes.data == frame.data() + 5);
+	BOOST_CHECK(message.raw.data == frame.data());
+	BOOST_CHECK_EQUAL(message.raw.size, frame.size());
+
+	std::string const cursor = type_field(Message::TYPE_SYNC_CURSOR_LINE) + size_field(7)
+		+ size_field(2);
+	MessageView line;
+	BOOST_REQUIRE_EQUAL(line.parse(loopback.client, cursor.data(), cursor.size(), needed),
+	                    cursor.size());
+	BOOST_CHECK_EQUAL(line.line, 7);
+	BOOST_CHECK_EQUAL(line.column, 2);
+}
+
+BOOST_AUTO_TEST_CASE(incomplete_frames)
+{
+	Loopback loopback;
+	std::string const frame = type_field(Message::TYPE_SYNC_MULTIBYTE) + size_field(3) + "abc";
+
+	// the header is missing, the fixed fields are needed at least
+	MessageView message;
+	size_t needed = 0;
+	BOOST_CHECK_EQUAL(message.parse(loopback.client, frame.data(), 2, needed), 0u);
+	BOOST_CHECK_EQUAL(needed, 5u);
+
+	// the payload is missing, its length is known
+	BOOST_CHECK_EQUAL(message.parse(loopback.client, frame.data(), 6, needed), 0u);
+	BOOST_CHECK_EQUAL(needed, frame.size());
+}
+
+BOOST_AUTO_TEST_CASE(malformed_frames)
+{
+	using namespace Exception;
+
+	Loopback loopback;
+	size_t needed = 0;
+
+	std::string const invalid(1, '\x7f');
+	MessageView type;
+	BOOST_CHECK_THROW(type.parse(loopback.client, invalid.data(), invalid.size(), needed),
+	                  InvalidMessageType);
+
+	// oversize payloads are refused before they arrive
+	std::string const oversize = type_field(Message::TYPE_SYNC_MULTIBYTE)
+		+ size_field(MessageView::MAX_PAYLOAD_SIZE + 1);
+	MessageView length;
+	BOOST_CHECK_THROW(length.parse(loopback.client, oversize.data(), oversize.size(), needed),
+	                  InvalidMessageLength);
+
+	std::string const negative = type_field(Message::TYPE_SYNC_MULTIBYTE) + size_field(-1);
+	MessageView sign;
+	BOOST_CHECK_THROW(sign.parse(loopback.client, negative.data(), negative.size(), needed),
+	                  InvalidMessageLength);
+
+	std::string const signatures = type_field(Message::TYPE_SYNC_SIGNATURES) + size_field(1)
+		+ size_field(INT32_MAX);
+	MessageView count;
+	BOOST_CHECK_THROW(count.parse(loopback.client, signatures.data(), signatures.size(), needed),
+	                  InvalidMessageLength);
+}
+
+BOOST_AUTO_TEST_CASE(malformed_frames_leave_no_view)
+{
+	using namespace Exception;
+
+	Loopback loopback;
+	loopback.send(type_field(Message::TYPE_SYNC_BYTE) + "x" + "\x7f");
+
+	MessageList messages;
+	MessageList::iterator tail = messages.before_begin();
+	BOOST_CHECK_THROW(loopback.client->receive(messages, tail), InvalidMessageType);
+
+	// the frame in front of the malformed one is kept, nothing stands for the malformed one
+	BOOST_REQUIRE_EQUAL(std::distance(messages.begin(), messages.end()), 1);
+	BOOST_CHECK(messages.front().type == Message::TYPE_SYNC_BYTE);
+	BOOST_CHECK(messages.front().source == loopback.client);
+	BOOST_CHECK(tail == messages.begin());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,118 @@
+#include "NetworkPool.h"
+#include "Loopback.h"
+#include "MessageView.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+BOOST_AUTO_TEST_SUITE(NetworkPoolSuite)
+
+namespace
+{
+	typedef std::pair<size_t, std::string> Handled;
+
+	std::mutex handled_mutex;
+	std::condition_variable handled_changed;
+	std::vector<Handled> handled;
+
+	// the first NetworkInterface sends everyone to the second one
+	void handle(NetworkInterface &interface, MessageView const &message)
+	{
+		{
+			std::lock_guard<std::mutex> lock(handled_mutex);
+			handled.push_back(Handled(interface.get_index(),
+				std::string(message.bytes.begin(), message.bytes.end())));
+		}
+		handled_changed.notify_all();
+
+		if (interface.get_index() == 0)
+		{
+			interface.hand_over(message, 1);
+		}
+	}
+
+	std::string multibyte(std::string const &bytes)
+	{
+		std::uint32_t const length = htonl(bytes.size());
+
+		return std::string(1, static_cast<char>(Message::TYPE_SYNC_MULTIBYTE))
+			+ std::string(reinterpret_cast<char const *>(&length), sizeof(length)) + bytes;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(owners)
+{
+	NetworkPool pool(0, 2);
+	size_t owner;
+
+	BOOST_CHECK_EQUAL(pool.size(), 2u);
+
+	// the first claim wins, later ones learn the owner
+	BOOST_CHECK(pool.claim("a.txt", 1, owner));
+	BOOST_CHECK_EQUAL(owner, 1u);
+	BOOST_CHECK(!pool.claim("a.txt", 0, owner));
+	BOOST_CHECK_EQUAL(owner, 1u);
+
+	// unknown ids stay with whoever asks
+	BOOST_CHECK_EQUAL(pool.owner_of(7, 0), 0u);
+	pool.assign(7, 1);
+	BOOST_CHECK_EQUAL(pool.owner_of(7, 0), 1u);
+
+	pool.forget("a.txt");
+	BOOST_CHECK(pool.claim("a.txt", 0, owner));
+	BOOST_CHECK_EQUAL(owner, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(hand_over)
+{
+	NetworkPool pool(0, 2);
+	pool.add_message_handler(handle);
+	handled.clear();
+
+	// the messages wait in the receive buffer until the first NetworkInterface runs
+	Loopback loopback;
+	loopback.send(multibyte("one") + multibyte("two"));
+	pool.get_interface(0).admit(loopback.client);
+
+	int ipc[2];
+	BOOST_REQUIRE_EQUAL(::socketpair(AF_UNIX, SOCK_STREAM, 0, ipc), 0);
+	std::thread running([&pool, &ipc]()
+		{
+			pool.run(ipc[0]);
+		});
+
+	bool finished;
+	{
+		std::unique_lock<std::mutex> lock(handled_mutex);
+		finished = handled_changed.wait_for(lock, std::chrono::seconds(10),
+			[]()
+			{
+				return handled.size() >= 3;
+			});
+	}
+
+	BOOST_REQUIRE_EQUAL(::write(ipc[1], "q", 1), 1);
+	running.join();
+	::close(ipc[0]);
+	::close(ipc[1]);
+
+	// the message that asked for the other one is decoded anew, the ones behind it only there
+	BOOST_REQUIRE(finished);
+	std::vector<Handled> const expected = { Handled(0, "one"), Handled(1, "one"),
+		Handled(1, "two") };
+	BOOST_CHECK(handled == expected);
+	BOOST_CHECK(!pool.get_interface(0).get_clients().contains(*loopback.client));
+	BOOST_CHECK(pool.get_interface(1).get_clients().contains(*loopback.client));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
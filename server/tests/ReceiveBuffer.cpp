@@ -0,0 +1,103 @@
+#include "ReceiveBuffer.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+BOOST_AUTO_TEST_SUITE(ReceiveBufferSuite)
+
+namespace
+{
+	struct SocketPair
+	{
+		SocketPair()
+		{
+			BOOST_REQUIRE_EQUAL(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+		}
+
+		~SocketPair()
+		{
+			::close(fds[0]);
+			::close(fds[1]);
+		}
+
+		int fds[2];
+	};
+
+	std::string unparsed(ReceiveBuffer const &buffer)
+	{
+		return std::string(buffer.data(), buffer.size());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(filling_and_consuming)
+{
+	SocketPair sockets;
+	ReceiveBuffer buffer;
+
+	BOOST_CHECK_EQUAL(buffer.size(), 0u);
+
+	// nothing available doesn't block
+	BOOST_CHECK(buffer.fill(sockets.fds[0]));
+	BOOST_CHECK_EQUAL(buffer.size(), 0u);
+
+	BOOST_REQUIRE_EQUAL(::write(sockets.fds[1], "hello", 5), 5);
+	BOOST_CHECK(buffer.fill(sockets.fds[0]));
+	BOOST_CHECK_EQUAL(unparsed(buffer), "hello");
+
+	// unconsumed bytes stay in front of the ones received later
+	buffer.consume(2);
+	BOOST_REQUIRE_EQUAL(::write(sockets.fds[1], " world", 6), 6);
+	BOOST_CHECK(buffer.fill(sockets.fds[0]));
+	BOOST_CHECK_EQUAL(unparsed(buffer), "llo world");
+
+	buffer.consume(buffer.size());
+	BOOST_CHECK_EQUAL(buffer.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(more_than_a_chunk)
+{
+	SocketPair sockets;
+	ReceiveBuffer buffer;
+
+	::fcntl(sockets.fds[1], F_SETFL, O_NONBLOCK);
+
+	// as much as the socket takes, at least a few chunks
+	std::string const chunk(ReceiveBuffer::RECEIVE_CHUNK_SIZE / 2, 'x');
+	std::string sent;
+	ssize_t written;
+
+	while ((written = ::write(sockets.fds[1], chunk.data(), chunk.size())) > 0)
+	{
+		sent.append(chunk, 0, written);
+	}
+
+	BOOST_REQUIRE_GT(sent.size(), ReceiveBuffer::RECEIVE_CHUNK_SIZE);
+
+	// a part was parsed meanwhile, the buffer moves or grows
+	BOOST_CHECK(buffer.fill(sockets.fds[0]));
+	buffer.consume(10);
+	BOOST_CHECK(buffer.fill(sockets.fds[0]));
+	BOOST_CHECK_EQUAL(buffer.size(), sent.size() - 10);
+}
+
+BOOST_AUTO_TEST_CASE(closed_connections)
+{
+	SocketPair sockets;
+	ReceiveBuffer buffer;
+
+	BOOST_REQUIRE_EQUAL(::write(sockets.fds[1], "bye", 3), 3);
+	::close(sockets.fds[1]);
+	sockets.fds[1] = ::open("/dev/null", O_RDONLY);
+
+	// a short read spares the call reporting the end, the next one makes it
+	BOOST_CHECK(buffer.fill(sockets.fds[0]));
+	BOOST_CHECK(!buffer.fill(sockets.fds[0]));
+	BOOST_CHECK_EQUAL(unparsed(buffer), "bye");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
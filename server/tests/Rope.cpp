@@ -0,0 +1,146 @@
+#include "Rope.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+BOOST_AUTO_TEST_SUITE(RopeSuite)
+
+namespace
+{
+	std::string to_string(Rope const &rope)
+	{
+		std::vector<char> const bytes = rope.flatten();
+
+		return std::string(bytes.begin(), bytes.end());
+	}
+
+	void insert(Rope &rope, std::size_t offset, std::string const &text)
+	{
+		rope.insert(offset, text.data(), text.size());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(construction)
+{
+	Rope const empty;
+
+	BOOST_CHECK(empty.empty());
+	BOOST_CHECK_EQUAL(empty.size(), 0u);
+
+	Rope const rope(Rope::make_buffer(std::vector<char> { 'f', 'o', 'o' }));
+
+	BOOST_CHECK_EQUAL(rope.size(), 3u);
+	BOOST_CHECK_EQUAL(to_string(rope), "foo");
+
+	Rope::buffer_ptr const bar = Rope::make_buffer(std::vector<char> { 'b', 'a', 'r' });
+	Rope const joined(std::vector<Rope::buffer_ptr> {
+		Rope::make_buffer(std::vector<char> { 'f', 'o', 'o' }),
+		Rope::make_buffer(std::vector<char>()), bar });
+
+	BOOST_CHECK_EQUAL(to_string(joined), "foobar");
+
+	// the pieces still refer to the buffers they were made of
+	std::vector<Rope::buffer_ptr> buffers;
+
+	joined.for_each_piece(
+		[&buffers](Rope::buffer_ptr const &buffer, std::size_t offset, std::size_t length)
+		{
+			BOOST_CHECK_EQUAL(offset, 0u);
+			BOOST_CHECK_EQUAL(length, 3u);
+			buffers.push_back(buffer);
+		});
+	BOOST_REQUIRE_EQUAL(buffers.size(), 2u);
+	BOOST_CHECK(buffers[1] == bar);
+}
+
+BOOST_AUTO_TEST_CASE(insert_and_erase)
+{
+	Rope rope;
+
+	insert(rope, 0, "world");
+	insert(rope, 0, "hello ");
+	insert(rope, 11, "!");
+	insert(rope, 5, ",");
+	BOOST_CHECK_EQUAL(to_string(rope), "hello, world!");
+
+	rope.erase(5, 1);
+	rope.erase(0, 6);
+	BOOST_CHECK_EQUAL(to_string(rope), "world!");
+
+	rope.erase(0, rope.size());
+	BOOST_CHECK(rope.empty());
+
+	// typing at the end of the last insertion
+	for (char const c: std::string("typed"))
+	{
+		rope.insert(rope.size(), &c, 1);
+	}
+
+	BOOST_CHECK_EQUAL(to_string(rope), "typed");
+}
+
+BOOST_AUTO_TEST_CASE(against_string)
+{
+	Rope rope;
+	std::string expected;
+	unsigned int seed = 42;
+
+	for (int i = 0; i < 2000; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+
+		std::size_t const offset = seed % (expected.size() + 1);
+
+		if (seed & 0x10000 || expected.empty())
+		{
+			std::string const text(1 + seed % 7, 'a' + i % 26);
+
+			insert(rope, offset, text);
+			expected.insert(offset, text);
+		}
+		else
+		{
+			std::size_t const length = std::min<std::size_t>(
+				seed % 5, expected.size() - offset);
+
+			rope.erase(offset, length);
+			expected.erase(offset, length);
+		}
+	}
+
+	BOOST_CHECK_EQUAL(rope.size(), expected.size());
+	BOOST_CHECK_EQUAL(to_string(rope), expected);
+
+	std::vector<char> const part = rope.read(3, 10);
+
+	BOOST_CHECK_EQUAL(std::string(part.begin(), part.end()), expected.substr(3, 10));
+}
+
+BOOST_AUTO_TEST_CASE(copies_are_independent)
+{
+	Rope rope;
+
+	insert(rope, 0, "abc");
+
+	Rope copy(rope);
+
+	insert(rope, 3, "def");
+	insert(copy, 3, "xyz");
+	BOOST_CHECK_EQUAL(to_string(rope), "abcdef");
+	BOOST_CHECK_EQUAL(to_string(copy), "abcxyz");
+}
+
+BOOST_AUTO_TEST_CASE(out_of_range)
+{
+	using rope_errors::OutOfRangeError;
+
+	Rope rope;
+
+	insert(rope, 0, "abc");
+	BOOST_CHECK_THROW(insert(rope, 4, "d"), OutOfRangeError);
+	BOOST_CHECK_THROW(rope.erase(2, 2), OutOfRangeError);
+	BOOST_CHECK_THROW(rope.read(0, 4), OutOfRangeError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
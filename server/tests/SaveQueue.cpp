@@ -0,0 +1,58 @@
+#include "SaveQueue.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <poll.h>
+
+#include <stdexcept>
+
+BOOST_AUTO_TEST_SUITE(SaveQueueSuite)
+
+namespace
+{
+	void wait_readable(int fd)
+	{
+		::pollfd descriptor = { fd, POLLIN, 0 };
+
+		BOOST_REQUIRE_EQUAL(::poll(&descriptor, 1, 10000), 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(completions)
+{
+	SaveQueue queue;
+	std::vector<int> order;
+	int failures = 0;
+
+	queue.enqueue(
+		[&order]()
+		{
+			order.push_back(1);
+		},
+		[&failures](std::exception_ptr error)
+		{
+			failures += error ? 1 : 0;
+		});
+
+	std::shared_future<void> const done = queue.enqueue(
+		[]()
+		{
+			throw std::runtime_error("failed");
+		},
+		[&failures](std::exception_ptr error)
+		{
+			failures += error ? 1 : 0;
+		});
+
+	done.wait();
+	BOOST_CHECK_THROW(done.get(), std::runtime_error);
+	BOOST_REQUIRE_EQUAL(order.size(), 1);
+
+	// completions only run on dispatch
+	BOOST_CHECK_EQUAL(failures, 0);
+	wait_readable(queue.get_fd());
+	queue.dispatch();
+	BOOST_CHECK_EQUAL(failures, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,177 @@
+#include "SendQueue.h"
+#include "Message.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+BOOST_AUTO_TEST_SUITE(SendQueueSuite)
+
+namespace
+{
+	struct SocketPair
+	{
+		SocketPair()
+		{
+			BOOST_REQUIRE_EQUAL(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+		}
+
+		~SocketPair()
+		{
+			::close(fds[0]);
+			::close(fds[1]);
+		}
+
+		int fds[2];
+	};
+
+	std::string field(std::uint32_t value)
+	{
+		value = htonl(value);
+		return std::string(reinterpret_cast<char const *>(&value), sizeof(value));
+	}
+
+	std::string byte(std::uint32_t position, char byte)
+	{
+		return std::string(1, static_cast<char>(Message::TYPE_SYNC_BYTE)) + field(position) + byte;
+	}
+
+	std::string multibyte(std::uint32_t position, std::string const &bytes)
+	{
+		return std::string(1, static_cast<char>(Message::TYPE_SYNC_MULTIBYTE)) + field(position)
+			+ field(bytes.size()) + bytes;
+	}
+
+	std::string deletion(std::uint32_t position, std::uint32_t length)
+	{
+		return std::string(1, static_cast<char>(Message::TYPE_SYNC_DELETION)) + field(position)
+			+ field(length);
+	}
+
+	std::string shift(std::uint32_t position, std::uint32_t length)
+	{
+		return std::string(1, static_cast<char>(Message::TYPE_SYNC_VIEWPORT_SHIFT))
+			+ field(position) + field(length);
+	}
+
+	/**
+	 * Queues the frames behind a frame the socket doesn't take at once and
+	 * returns what arrives behind that one once the queue is flushed.
+	 */
+	class Lagging
+	{
+	public:
+		Lagging()
+			: filler(1024 * 1024, 'f')
+		{
+			queue.write(sockets.fds[0], filler.data(), filler.size(), false);
+			BOOST_REQUIRE(!queue.empty());
+		}
+
+		void write(std::string const &frame)
+		{
+			queue.write(sockets.fds[0], frame.data(), frame.size(), true);
+		}
+
+		std::string flush()
+		{
+			std::string received;
+			char bytes[65536];
+			while (!queue.flush(sockets.fds[0]))
+			{
+				ssize_t const size = ::recv(sockets.fds[1], bytes, sizeof(bytes), 0);
+				BOOST_REQUIRE_GT(size, 0);
+				received.append(bytes, size);
+			}
+
+			ssize_t size;
+			while ((size = ::recv(sockets.fds[1], bytes, sizeof(bytes), MSG_DONTWAIT)) > 0)
+			{
+				received.append(bytes, size);
+			}
+
+			BOOST_REQUIRE_GE(received.size(), filler.size());
+			BOOST_CHECK(received.compare(0, filler.size(), filler) == 0);
+			return received.substr(filler.size());
+		}
+
+		SocketPair sockets;
+		SendQueue queue;
+		std::string const filler;
+	};
+}
+
+BOOST_AUTO_TEST_CASE(coalescing_insertions)
+{
+	Lagging lagging;
+	size_t const queued = lagging.queue.size();
+
+	// typing, then inserting in front of and within what was typed
+	lagging.write(byte(10, 'b'));
+	lagging.write(byte(11, 'c'));
+	lagging.write(multibyte(12, "de"));
+	lagging.write(byte(10, 'a'));
+	lagging.write(multibyte(13, "xy"));
+	BOOST_CHECK_EQUAL(lagging.queue.size() - queued, multibyte(10, "abcxyde").size());
+
+	// a gap ends the frame
+	lagging.write(byte(20, 'z'));
+	lagging.write(byte(9, 'z'));
+
+	BOOST_CHECK_EQUAL(lagging.flush(),
+		multibyte(10, "abcxyde") + byte(20, 'z') + byte(9, 'z'));
+}
+
+BOOST_AUTO_TEST_CASE(coalescing_deletions)
+{
+	Lagging lagging;
+
+	// deleting forwards, then backwards
+	lagging.write(deletion(20, 1));
+	lagging.write(deletion(20, 2));
+	lagging.write(deletion(19, 1));
+	lagging.write(deletion(15, 4));
+
+	// neither continues the deletion
+	lagging.write(deletion(30, 1));
+	lagging.write(byte(30, 'a'));
+	lagging.write(deletion(30, 1));
+
+	BOOST_CHECK_EQUAL(lagging.flush(),
+		deletion(15, 8) + deletion(30, 1) + byte(30, 'a') + deletion(30, 1));
+}
+
+BOOST_AUTO_TEST_CASE(coalescing_shifts)
+{
+	Lagging lagging;
+
+	lagging.write(shift(5, 1));
+	lagging.write(shift(3, 2));
+	lagging.write(deletion(0, 1));
+	lagging.write(shift(8, 1));
+
+	BOOST_CHECK_EQUAL(lagging.flush(), shift(3, 3) + deletion(0, 1) + shift(8, 1));
+}
+
+BOOST_AUTO_TEST_CASE(dropping_edits)
+{
+	Lagging lagging;
+	size_t const queued = lagging.queue.size();
+
+	// frames other than edits are kept, they don't coalesce either
+	std::string const other(5, static_cast<char>(Message::TYPE_STATUS));
+	lagging.write(multibyte(0, "abc"));
+	lagging.queue.write(lagging.sockets.fds[0], other.data(), other.size(), false);
+	lagging.write(deletion(0, 1));
+	lagging.queue.drop_edits();
+
+	BOOST_CHECK_EQUAL(lagging.queue.size(), queued + other.size());
+	BOOST_CHECK_EQUAL(lagging.flush(), other);
+	BOOST_CHECK(lagging.queue.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
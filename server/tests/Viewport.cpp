@@ -0,0 +1,65 @@
+#include "Viewport.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(ViewportSuite)
+
+BOOST_AUTO_TEST_CASE(effects)
+{
+	typedef Viewport::Effect Effect;
+
+	Viewport viewport(10, 20);
+
+	// behind the window, including insertions right at its end
+	BOOST_CHECK(viewport.apply(20, 0, 5) == Effect::none);
+	BOOST_CHECK(viewport.apply(25, 3, 0) == Effect::none);
+	BOOST_CHECK_EQUAL(viewport.begin(), 10u);
+	BOOST_CHECK_EQUAL(viewport.end(), 20u);
+
+	// in front of the window
+	BOOST_CHECK(viewport.apply(0, 0, 4) == Effect::shift);
+	BOOST_CHECK_EQUAL(viewport.begin(), 14u);
+	BOOST_CHECK_EQUAL(viewport.end(), 24u);
+	BOOST_CHECK(viewport.apply(2, 2, 0) == Effect::shift);
+	BOOST_CHECK_EQUAL(viewport.begin(), 12u);
+
+	// replacing bytes in front of it by as many doesn't move it
+	BOOST_CHECK(viewport.apply(0, 3, 3) == Effect::none);
+
+	// within the window, including insertions right at its beginning
+	BOOST_CHECK(viewport.apply(12, 0, 1) == Effect::overlap);
+	BOOST_CHECK_EQUAL(viewport.begin(), 12u);
+	BOOST_CHECK_EQUAL(viewport.end(), 23u);
+
+	// erasing across the beginning pulls it to the edit
+	BOOST_CHECK(viewport.apply(10, 5, 0) == Effect::overlap);
+	BOOST_CHECK_EQUAL(viewport.begin(), 10u);
+	BOOST_CHECK_EQUAL(viewport.end(), 18u);
+
+	// erasing everything leaves an empty window
+	BOOST_CHECK(viewport.apply(0, 30, 0) == Effect::overlap);
+	BOOST_CHECK_EQUAL(viewport.begin(), 0u);
+	BOOST_CHECK_EQUAL(viewport.end(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(whole_document)
+{
+	Viewport viewport;
+
+	BOOST_CHECK(viewport.is_whole());
+	BOOST_CHECK(viewport.apply(0, 0, 1) == Viewport::Effect::overlap);
+	BOOST_CHECK(viewport.apply(1000, 10, 0) == Viewport::Effect::overlap);
+	BOOST_CHECK(viewport.is_whole());
+	BOOST_CHECK(!Viewport(0, 10).is_whole());
+
+	// open towards the end, it keeps receiving what is appended
+	Viewport tail(100, std::numeric_limits<std::size_t>::max());
+
+	BOOST_CHECK(tail.apply(500, 0, 10) == Viewport::Effect::overlap);
+	BOOST_CHECK(tail.apply(0, 0, 10) == Viewport::Effect::shift);
+	BOOST_CHECK(tail.apply(1000, 50, 0) == Viewport::Effect::overlap);
+	BOOST_CHECK_EQUAL(tail.begin(), 110u);
+	BOOST_CHECK_EQUAL(tail.end(), std::numeric_limits<std::size_t>::max());
+}
+
+BOOST_AUTO_TEST_SUITE_END()